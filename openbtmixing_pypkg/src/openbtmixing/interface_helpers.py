@@ -200,21 +200,13 @@ def write_data_to_txt(data, tc, fpath, root, fmt):
     if (tc - int(tc) != 0):
         sys.exit('Fit: Invalid tc input - exiting process')
 
-    # Writing data for predictions (if true) or training (if false)
-    if root in ["xp", "fp", "xw"]:
-        nh = tc
-        int_added = 0
-    else:
-        nh = tc - 1
-        int_added = 1
-    
-    # Check splitted data
-    splitted_data = np.array_split(data, nh)
+    # Split the data over all tc processes, rank 0 included: it holds a shard
+    # of the training data as well as of the prediction grid
+    splitted_data = np.array_split(data, tc)
     
-    # save to text (accounting for thread number when needed with int_added)
-    # Use int_added = 0 when writing prediction grid
+    # save to text, one file per process
     for i, ch in enumerate(splitted_data):
-        np.savetxt(str(fpath / Path(root + str(i + int_added))),ch, fmt=fmt)
+        np.savetxt(str(fpath / Path(root + str(i))),ch, fmt=fmt)
 
 
 
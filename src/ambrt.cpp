@@ -24,6 +24,7 @@
 
 #include "ambrt.h" 
 #include "brtfuns.h"
+#include "flatforest.h"
 #include <iostream>
 #include <map>
 #include <vector>
@@ -34,26 +35,25 @@ using std::endl;
 
 //--------------------------------------------------
 //a single iteration of the MCMC for brt model
+//yhat is kept as a running sum: tree j is taken out before its draw and its
+//new fit added back after, so a sweep is O(n*m) rather than O(n*m^2).
 void ambrt::draw(rn& gen)
 {
   for(size_t j=0;j<m;j++) {
-    //update this row of notjmus
-    // for(size_t i=0;i<di->n;i++) {
-    //   notjmus[j][i]=di->y[i]-f(i)+mb[j].f(i);  //res_j=y-sum_{k!=j}tree_j
-    // }
-   *divec[j]= *di;
-   *divec[j]-= *getf();
-   *divec[j]+= *mb[j].getf();
+    //set notjmu to res_j=y-sum_{k!=j}tree_k
+    dropfit(j);
 
     // do the draw for jth component
     mb[j].draw(gen);
-   
+
     // Update the in-sample predicted vector
-    setf();
-   
-    // Update the in-sample residual vector
-    setr();
+    addfit(j);
   }
+  // Recompute the fit from all m trees so rounding in the running sum
+  // does not build up, then the in-sample residual vector
+  setf();
+  setr();
+
   // overall statistics from the subtrees.  Need to divide by m*N to get
   // useful numbers after the MCMC is done.
   if(mi.dostats) {
@@ -67,29 +67,37 @@ void ambrt::draw(rn& gen)
 void ambrt::draw_mpislave(rn& gen)
 {
   for(size_t j=0;j<m;j++) {
-    *divec[j]= *di;
-    /*
-    cout << "here slave 1" << endl;
-    cout << "yhat.size() = "<< yhat.size() << endl;
-    cout << "di->n = " << (*di).n << endl;
-    cout << "di->x = " << (*di).x << endl;
-    cout << "di->y = " << (*di).y << endl;
-    cout << "di->p = " << (*di).p << endl;
-    */
-    *divec[j]-= *getf();
-    //cout << "here slave 2" << endl;
-    *divec[j]+= *mb[j].getf();
-    //cout << "here slave 3" << endl;
+    dropfit(j);
+
     // do the draw for jth component
     mb[j].draw_mpislave(gen);
-    //cout << "here slave 4" << endl;
+
     // Update the in-sample predicted vector
-    setf();
-    //cout << "here slave 5" << endl;
-    // Update the in-sample residual vector
-    setr();
-    //cout << "here slave 6" << endl;  
+    addfit(j);
   }
+  setf();
+  setr();
+}
+//--------------------------------------------------
+//take tree j out of the running fit, what is left of y is the jth residual
+void ambrt::dropfit(size_t j)
+{
+  double* yh=yhat.data();
+  double* r=notjmu.data();
+  const double* fj=mb[j].getf()->data();
+  for(size_t i=0;i<di->n;i++) {
+    yh[i]-=fj[i];
+    r[i]=di->y[i]-yh[i];
+  }
+}
+//--------------------------------------------------
+//add tree j's fit back into the running fit after its draw
+void ambrt::addfit(size_t j)
+{
+  double* yh=yhat.data();
+  const double* fj=mb[j].getf()->data();
+  for(size_t i=0;i<di->n;i++)
+    yh[i]+=fj[i];
 }
 //--------------------------------------------------
 //adapt the proposal widths for perturb proposals,
@@ -104,23 +112,35 @@ void ambrt::adapt()
   }
 }
 //--------------------------------------------------
+//save/load the state of the chain for checkpoints
+void ambrt::savestate(std::ostream& os)
+{
+  brt::savestate(os);
+  for(size_t j=0;j<m;j++)
+    mb[j].savestate(os);
+}
+void ambrt::loadstate(std::istream& is)
+{
+  brt::loadstate(is);
+  for(size_t j=0;j<m;j++)
+    mb[j].loadstate(is);
+}
+//--------------------------------------------------
 //setdata for ambrt
 void ambrt::setdata(dinfo *di) {
   this->di=di;
 
-  // initialize notjsigmavs.
-  for(size_t j=0;j<m;j++)
-      notjmus[j].resize(this->di->n,0.0);
-  for(size_t j=0;j<m;j++)
-    for(size_t i=0;i<di->n;i++)
-      notjmus[j][i]=this->di->y[i]/((double)m);
-  
-  for(size_t j=0;j<m;j++)
-    divec[j]=new dinfo(this->di->p,this->di->n,this->di->x,&notjmus[j][0],this->di->tc);  
-  
-  // each mb[j]'s data is the appropriate row in notjmus
+  // initialize notjmu.  Only one tree is drawn at a time, so one residual
+  // buffer serves all m trees; draw refills it before each tree.
+  notjmu.resize(this->di->n);
+  dinotj.y=notjmu.data(); dinotj.tc=this->di->tc;
+  dinotj=*di;  //copies x (and the binned x, if any) and y into notjmu
+  for(size_t i=0;i<di->n;i++)
+    notjmu[i]=this->di->y[i]/((double)m);
+
+  // each mb[j]'s data is the residual in notjmu
   for(size_t j=0;j<m;j++)
-    mb[j].setdata(divec[j]);
+    mb[j].setdata(&dinotj);
   resid.resize(di->n);
   yhat.resize(di->n);
   setf();
@@ -151,17 +171,12 @@ void ambrt::local_setr(diterator& diter)
 //Note: the result appears in *dipred.y.
 void ambrt::local_predict(diterator& diter)
 {
-  tree::tree_p bn;
-  double temp;
-
-  for(;diter<diter.until();diter++) {
-    temp=0.0;
-    for(size_t j=0;j<m;j++) {
-      bn = mb[j].t.bn(diter.getxp(),*xi);
-      temp+=bn->gettheta();
-    }
-    diter.sety(temp);
-  }
+  tree::cnpv tv(m);
+  for(size_t j=0;j<m;j++) tv[j]=&mb[j].t;
+  flatforest ff;
+  ff.set(tv,*xi);
+  dinfo& d=diter.getdi();
+  ff.predictsum(diter.getpos(),diter.until(),d.p,d.x,d.y);
 }
 void ambrt::local_savetree(size_t iter, int beg, int end, std::vector<int>& nn, std::vector<std::vector<int> >& id, 
      std::vector<std::vector<int> >& v, std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta)
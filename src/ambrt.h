@@ -40,14 +40,9 @@ public:
    // cinfo same as in mbrt
    //--------------------
    //constructors/destructors
-   ambrt(): mbrt(),st(0),m(200),mb(m),notjmus(m),divec(m) {}
-   ambrt(size_t im): mbrt(),st(0),m(im),mb(m),notjmus(m),divec(m) {}
+   ambrt(): mbrt(),st(0),m(200),mb(m) {}
+   ambrt(size_t im): mbrt(),st(0),m(im),mb(m) {}
    virtual ~ambrt() {
-      if(!notjmus.empty()) {
-         for(size_t j=0;j<m;j++) notjmus[j].clear();
-         notjmus.clear();
-         for(size_t j=0;j<m;j++) delete divec[j];
-      }
       st.tonull();
    }
 
@@ -57,6 +52,8 @@ public:
    void draw_mpislave(rn& gen);
    void adapt();
    void setmpirank(int rank) { this->rank = rank; for(size_t j=0;j<m;j++) mb[j].setmpirank(rank); }  //only needed for MPI
+   void setmpislaves(int nslaves) { this->nslaves = nslaves; for(size_t j=0;j<m;j++) mb[j].setmpislaves(nslaves); }  //only needed for MPI
+   void setmpirep(bool rep) { this->mpirep = rep; for(size_t j=0;j<m;j++) mb[j].setmpirep(rep); }  //only needed for MPI
    void setmpicvrange(int* lwr, int* upr) { this->chv_lwr=lwr; this->chv_upr=upr; for(size_t j=0;j<m;j++) mb[j].setmpicvrange(lwr,upr); } //only needed for MPI
    void setci(double tau, double* sigma) { ci.tau=tau; ci.sigma=sigma; for(size_t j=0;j<m;j++) mb[j].setci(tau,sigma); }
    void settc(int tc) { this->tc = tc; for(size_t j=0;j<m;j++) mb[j].settc(tc); }
@@ -70,6 +67,8 @@ public:
                for(size_t j=0;j<m;j++) mb[j].setmi(pbd,pb,minperbot,dopert,pertalpha,pchgv,chgv); }
    void setstats(bool dostats) { mi.dostats=dostats; for(size_t j=0;j<m;j++) mb[j].setstats(dostats); if(dostats) mi.varcount=new unsigned int[xi->size()]; }
    void pr();
+   void savestate(std::ostream& os);  //checkpoints: all m trees
+   void loadstate(std::istream& is);
    // drawnodetheta, lm, add_observation_to_suff and newsinfo/newsinfovec unused here.
 
    // convert BART ensemble to single supertree
@@ -97,12 +96,14 @@ protected:
    std::vector<mbrt> mb;  // the vector of individual mu trees for sum representation
    //--------------------
    //data
-   std::vector<std::vector<double> > notjmus;
-   std::vector<dinfo*> divec;
+   std::vector<double> notjmu;  //residual of the tree being drawn, one buffer for all m trees
+   dinfo dinotj;  //data of every mb[j]: di with y pointing at notjmu
    //--------------------
    //mcmc info
    //--------------------
    //methods
+   void dropfit(size_t j);  //take tree j out of yhat and set its residual in notjmu
+   void addfit(size_t j);  //put tree j's new fit back into yhat
    virtual void local_setf(diterator& diter);  //set the vector of predicted values
    virtual void local_setr(diterator& diter);  //set the vector of residuals
    virtual void local_predict(diterator& diter); // predict y at the (npred x p) settings *di.x
@@ -1,5 +1,6 @@
 #include "amxbrt.h"
 #include "brtfuns.h"
+#include "flatforest.h"
 #include <iostream>
 #include <map>
 #include <vector>
@@ -9,22 +10,26 @@ using std::endl;
 
 //--------------------------------------------------
 //a single iteration of the MCMC for brt model
+//yhat is kept as a running sum: tree j is taken out before its draw and its
+//new fit added back after, so a sweep is O(n*m) rather than O(n*m^2).
 void amxbrt::drawvec(rn& gen){
+    //sigma was redrawn since the last call, so refresh the weights in the cache
+    fcache.setw(ci.sigma,di->n);
     for(size_t j=0;j<m;j++) {
-        //Uses operators defined in dinfo on y to compute the jth residual Rij
-        *divec[j] = *di;
-        *divec[j]-= *getf(); //Yi - sum_k g(xi, Tk, Mk) 
-        *divec[j]+= *mb[j].getf(); //Computes the jth residual in BART model
+        //Set the jth residual Rij = Yi - sum_{k!=j} g(xi, Tk, Mk)
+        dropfit(j);
 
         //Draw parameter vector in the jth tree
         mb[j].drawvec(gen);
-        
-        // Update the in-sample predicted vector
-        setf_mix();
 
-        // Update the in-sample residual vector
-        setr_mix();
+        // Update the in-sample predicted vector
+        addfit(j);
     }
+    // Recompute the fit from all m trees so rounding in the running sum
+    // does not build up, then the in-sample residual vector
+    setf_mix();
+    setr_mix();
+
     // overall statistics from the subtrees.  Need to divide by m*N to get
     // useful numbers after the MCMC is done.
     if(mi.dostats) {
@@ -38,23 +43,43 @@ void amxbrt::drawvec(rn& gen){
 //--------------------------------------------------
 //slave controller for draw when using MPI
 void amxbrt::drawvec_mpislave(rn& gen){
+    //sigma was redrawn since the last call, so refresh the weights in the cache
+    fcache.setw(ci.sigma,di->n);
     for(size_t j=0;j<m;j++) {
         //Get the jth resiudal
-        *divec[j]= *di;
-        *divec[j]-= *getf();
-        *divec[j]+= *mb[j].getf();
+        dropfit(j);
 
         // do the draw for jth component
         mb[j].drawvec_mpislave(gen);
-        
+
         // Update the in-sample predicted vector
-        setf_mix();
+        addfit(j);
+    }
+    setf_mix();
+    setr_mix();
+}
 
-        // Update the in-sample residual vector
-        setr_mix();
+//--------------------------------------------------
+//take tree j out of the running fit, what is left of y is the jth residual
+void amxbrt::dropfit(size_t j){
+    double* yh=yhat.data();
+    double* r=notjmu.data();
+    const double* fj=mb[j].getf()->data();
+    for(size_t i=0;i<di->n;i++) {
+        yh[i]-=fj[i];
+        r[i]=di->y[i]-yh[i];
     }
 }
 
+//--------------------------------------------------
+//add tree j's fit back into the running fit after its draw
+void amxbrt::addfit(size_t j){
+    double* yh=yhat.data();
+    const double* fj=mb[j].getf()->data();
+    for(size_t i=0;i<di->n;i++)
+        yh[i]+=fj[i];
+}
+
 //--------------------------------------------------
 //adapt the proposal widths for perturb proposals,
 //bd or rot proposals and b or d proposals.
@@ -66,34 +91,35 @@ void amxbrt::adapt(){
     mb[j].adapt();
   }
 }
+//--------------------------------------------------
+//save/load the state of the chain for checkpoints
+void amxbrt::savestate(std::ostream& os)
+{
+  brt::savestate(os);
+  for(size_t j=0;j<m;j++)
+    mb[j].savestate(os);
+}
+void amxbrt::loadstate(std::istream& is)
+{
+  brt::loadstate(is);
+  for(size_t j=0;j<m;j++)
+    mb[j].loadstate(is);
+}
 
 //--------------------------------------------------
 //setdata for amxbrt
 void amxbrt::setdata_mix(dinfo *di) {
     this->di=di;
         
-    // initialize notjsigmavs.
-    for(size_t j=0;j<m;j++){
-        notjmus[j].resize(this->di->n,0.0);
-    }
-    for(size_t j=0;j<m;j++){
-        for(size_t i=0;i<di->n;i++){
-            //notjmus[j][i]=this->di->y[i]/((double)m);
-            notjmus[j][i]=this->di->y[i];
-        }
-    }
-    for(size_t j=0;j<m;j++){
-        divec[j]=new dinfo(this->di->p,this->di->n,this->di->x,&notjmus[j][0],this->di->tc); //constructing a new dinfo with notjmus[j][0] as the y value 
-    }
-    /*
-    diterator diter(divec[0]);
-    for(;diter<diter.until();diter++){
-        cout << diter.getx() << " ------- " << *diter << " ------- " << diter.gety() << endl;
-    }
-    */
-    // each mb[j]'s data is the appropriate row in notjmus
+    // initialize notjmu.  Only one tree is drawn at a time, so one residual
+    // buffer serves all m trees; drawvec refills it before each tree.
+    notjmu.resize(this->di->n);
+    dinotj.y=notjmu.data(); dinotj.tc=this->di->tc;
+    dinotj=*di; //copies x (and the binned x, if any) and y into notjmu
+
+    // each mb[j]'s data is the residual in notjmu
     for(size_t j=0;j<m;j++){
-        mb[j].setdata_mix(divec[j]); //setdata_mix is a method of mb[j] which is a member of mxbrt class. This is different than setdata_mix in mxbrt
+        mb[j].setdata_mix(&dinotj); //setdata_mix is a method of mb[j] which is a member of mxbrt class. This is different than setdata_mix in mxbrt
     }
     resid.resize(di->n);
     yhat.resize(di->n);
@@ -123,39 +149,24 @@ void amxbrt::local_setr_mix(diterator& diter){
 //predict the response at the (npred x p) input matrix *x
 //Note: the result appears in *dipred.y.
 void amxbrt::local_predict_mix(diterator& diter, finfo& fipred){
-    tree::tree_p bn;
-    double temp;
-    vxd thetavec_temp(k); 
-    for(;diter<diter.until();diter++) {
-        //Initialize to zero 
-        temp = 0;
-        thetavec_temp = vxd::Zero(k);
-        
-        for(size_t j=0;j<m;j++) {
-            bn = mb[j].t.bn(diter.getxp(),*xi);
-            thetavec_temp = bn->getthetavec();
-            temp = temp + fipred.row(*diter)*thetavec_temp;
-        }
-        //std::cout << temp << std::endl;
-        diter.sety(temp);
-    }
+    tree::cnpv tv(m);
+    for(size_t j=0;j<m;j++) tv[j]=&mb[j].t;
+    flatforest ff;
+    ff.set(tv,*xi,k);
+    dinfo& d=diter.getdi();
+    ff.predictmix(diter.getpos(),diter.until(),d.p,d.x,fipred,d.y);
 }
 
 //--------------------------------------------------
 //extract model weights
 void amxbrt::local_get_mix_wts(diterator& diter, mxd& wts){
-    tree::tree_p bn;
-    vxd thetavec_temp(k);
-    for(;diter<diter.until();diter++) {
-        //Initialize to zero 
-        thetavec_temp = vxd::Zero(k);
-        //Get sum of trees for the model weights
-        for(size_t j=0;j<m;j++) {
-            bn = mb[j].t.bn(diter.getxp(),*xi);
-            thetavec_temp = thetavec_temp + bn->getthetavec();
-        }
-        wts.col(*diter) = thetavec_temp; //sets the thetavec to be the ith column of the wts eigen matrix. 
-    }
+    //Sum of trees for the model weights, the ith column of wts is the weight vector at row i
+    tree::cnpv tv(m);
+    for(size_t j=0;j<m;j++) tv[j]=&mb[j].t;
+    flatforest ff;
+    ff.set(tv,*xi,k);
+    dinfo& d=diter.getdi();
+    ff.mixwts(diter.getpos(),diter.until(),d.p,d.x,wts);
 }
 
 //--------------------------------------------------
@@ -170,7 +181,7 @@ void amxbrt::local_get_mix_theta(diterator& diter, mxd& wts){
         //Get sum of trees for the model weights
         if(enter){
             for(size_t j=0;j<m;j++) {
-                bn = mb[j].t.bn(diter.getxp(),*xi);
+                bn = getbn(mb[j].t,diter,*xi);
                 thetavec_temp = bn->getthetavec();
                 wts.col(j) = thetavec_temp; //sets the thetavec to be the ith column of the wts eigen matrix.
             }
@@ -15,15 +15,10 @@ public:
    // cinfo same as in mxbrt
    //--------------------
    //constructors/destructors
-   amxbrt(): mxbrt(),st(0),m(200),mb(m),notjmus(m),divec(m) {}
-   amxbrt(size_t im): mxbrt(),st(0),m(im),mb(m),notjmus(m),divec(m) {}
-   //amxbrt(size_t im, size_t ik): mxbrt(ik),st(0),m(im),mb(m),notjmus(m),divec(m) {}
+   amxbrt(): mxbrt(),st(0),m(200),mb(m) {}
+   amxbrt(size_t im): mxbrt(),st(0),m(im),mb(m) {}
+   //amxbrt(size_t im, size_t ik): mxbrt(ik),st(0),m(im),mb(m) {}
    virtual ~amxbrt() {
-      if(!notjmus.empty()) {
-         for(size_t j=0;j<m;j++) notjmus[j].clear();
-         notjmus.clear();
-         for(size_t j=0;j<m;j++) delete divec[j];
-      }
       st.tonull();
    }
 
@@ -33,16 +28,22 @@ public:
    void drawvec_mpislave(rn& gen);
    void adapt();
    void setmpirank(int rank) { this->rank = rank; for(size_t j=0;j<m;j++) mb[j].setmpirank(rank); }  //only needed for MPI
+   void setmpislaves(int nslaves) { this->nslaves = nslaves; for(size_t j=0;j<m;j++) mb[j].setmpislaves(nslaves); }  //only needed for MPI
+   void setmpirep(bool rep) { this->mpirep = rep; for(size_t j=0;j<m;j++) mb[j].setmpirep(rep); }  //only needed for MPI
    void setmpicvrange(int* lwr, int* upr) { this->chv_lwr=lwr; this->chv_upr=upr; for(size_t j=0;j<m;j++) mb[j].setmpicvrange(lwr,upr); } //only needed for MPI
    void setci(double tau, double beta0, double* sigma) { ci.tau=tau; ci.sigma=sigma; ci.beta0=beta0; for(size_t j=0;j<m;j++) mb[j].setci(tau,beta0,sigma); }
    void setci(mxd invtau2_matrix, vxd beta_vec, double* sigma) {ci.invtau2_matrix.resize(invtau2_matrix.rows(),invtau2_matrix.rows()); ci.beta_vec.resize(beta_vec.rows());
       ci.invtau2_matrix=invtau2_matrix; ci.beta_vec=beta_vec; ci.sigma=sigma,ci.diffpriors = true; for(size_t j=0;j<m;j++) mb[j].setci(invtau2_matrix,beta_vec,sigma);} //Set when using prior's that differ by function
    void settc(int tc) { this->tc = tc; for(size_t j=0;j<m;j++) mb[j].settc(tc); }
    void setxi(xinfo *xi) { this->xi=xi; for(size_t j=0;j<m;j++) mb[j].setxi(xi); }
-   void setfi(finfo *fi, size_t k) {this->fi = fi; this->k = k; this-> nsprior = false ;for(size_t j=0;j<m;j++) mb[j].setfi(fi,k); }
+   void setfi(finfo *fi, size_t k) {this->fi = fi; this->k = k; this-> nsprior = false ;for(size_t j=0;j<m;j++) mb[j].setfi(fi,k);
+      fcache.setff(*fi); for(size_t j=0;j<m;j++) mb[j].setfcache(&fcache); }
    void setfsd(finfo *fsd) {
       this->fisd = fsd; this->nsprior= true; 
-      for(size_t j=0;j<m;j++) mb[j].setfsd(fsd);}
+      for(size_t j=0;j<m;j++) mb[j].setfsd(fsd);
+      fcache.setpv(*fsd);}
+   void updatefi() { fcache.setff(*fi); } //call after changing the values in *fi
+
    void setk(size_t k) {this->k = k; for(size_t j=0;j<m;j++) mb[j].setk(k); }
    void setdata_mix(dinfo *di);
    void settp(double alpha, double beta) { tp.alpha=alpha;tp.beta=beta; for(size_t j=0;j<m;j++) mb[j].settp(alpha,beta); }
@@ -53,6 +54,8 @@ public:
                for(size_t j=0;j<m;j++) mb[j].setmi(pbd,pb,minperbot,dopert,pertalpha,pchgv,chgv); }
    void setstats(bool dostats) { mi.dostats=dostats; for(size_t j=0;j<m;j++) mb[j].setstats(dostats); if(dostats) mi.varcount=new unsigned int[xi->size()]; }
    void pr_vec();
+   void savestate(std::ostream& os);  //checkpoints: all m trees
+   void loadstate(std::istream& is);
    // drawnodetheta, lm, add_observation_to_suff and newsinfo/newsinfovec unused here.
 
    // convert BART ensemble to single supertree
@@ -75,12 +78,15 @@ protected:
     std::vector<mxbrt> mb;  // the vector of individual mu trees for sum representation
     //--------------------
     //data
-    std::vector<std::vector<double> > notjmus;
-    std::vector<dinfo*> divec;
+    std::vector<double> notjmu;  //residual of the tree being drawn, one buffer for all m trees
+    dinfo dinotj;  //data of every mb[j]: di with y pointing at notjmu
+    mxfcache fcache;  //per-row f f^t, pv and 1/sigma^2 shared by the mb[j]
     //--------------------
     //mcmc info
     //--------------------
     //methods
+    void dropfit(size_t j);  //take tree j out of yhat and set its residual in notjmu
+    void addfit(size_t j);  //put tree j's new fit back into yhat
     virtual void local_setf_mix(diterator& diter);  //set the vector of predicted values
     virtual void local_setr_mix(diterator& diter);  //set the vector of residuals
     virtual void local_predict_mix(diterator& diter, finfo& fipred); // predict y at the (npred x p) settings *di.x
@@ -29,6 +29,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <algorithm>
 
 using std::cout;
 using std::endl;
@@ -98,7 +99,10 @@ void brt::draw_mpislave(rn& gen)
       getsuff(nx,(size_t)v,(size_t)c,tsil,tsir);
       MPI_Status status2;
       MPI_Recv(buffer,0,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status2);
-      if(status2.MPI_TAG==MPI_TAG_BD_BIRTH_VC_ACCEPT) t.birthp(nx,(size_t)v,(size_t)c,0.0,0.0); //accept birth
+      if(status2.MPI_TAG==MPI_TAG_BD_BIRTH_VC_ACCEPT) { //accept birth
+         t.birthp(nx,(size_t)v,(size_t)c,0.0,0.0);
+         updoidx(nx);
+      }
       //else reject, for which we do nothing.
    }
    else if(status.MPI_TAG==MPI_TAG_BD_DEATH_LR) {
@@ -111,7 +115,11 @@ void brt::draw_mpislave(rn& gen)
       getsuff(nl,nr,tsil,tsir);
       MPI_Status status2;
       MPI_Recv(buffer,0,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status2);
-      if(status2.MPI_TAG==MPI_TAG_BD_DEATH_LR_ACCEPT) t.deathp(nl->getp(),0.0); //accept death
+      if(status2.MPI_TAG==MPI_TAG_BD_DEATH_LR_ACCEPT) { //accept death
+         tree::tree_p nx=nl->getp();
+         t.deathp(nx,0.0);
+         updoidx(nx);
+      }
       //else reject, for which we do nothing.
    }
    else if(status.MPI_TAG==MPI_TAG_ROTATE) {
@@ -149,7 +157,10 @@ void brt::draw_mpislave(rn& gen)
             getpertsuff(pertnode,bnv,oldc,sivold,sivnew);
             MPI_Status status2;
             MPI_Recv(buffer,0,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status2);
-            if(status2.MPI_TAG==MPI_TAG_PERTCV_ACCEPT) pertnode->setc(propc); //accept new cutpoint
+            if(status2.MPI_TAG==MPI_TAG_PERTCV_ACCEPT) { //accept new cutpoint
+               pertnode->setc(propc);
+               updoidx(pertnode);
+            }
             //else reject, for which we do nothing.
          }
          else if(status.MPI_TAG==MPI_TAG_PERTCHGV)
@@ -160,7 +171,7 @@ void brt::draw_mpislave(rn& gen)
             unsigned int propcint;
             unsigned int propvint;
             position=0;
-            mpi_update_norm_cormat(rank,tc,pertnode,*xi,(*mi.corv)[oldv],chv_lwr,chv_upr);
+            mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,(*mi.corv)[oldv],chv_lwr,chv_upr);
             MPI_Recv(buffer,SIZE_UINT3,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             MPI_Unpack(buffer,SIZE_UINT3,&position,&propcint,1,MPI_UNSIGNED,MPI_COMM_WORLD);
             MPI_Unpack(buffer,SIZE_UINT3,&position,&propvint,1,MPI_UNSIGNED,MPI_COMM_WORLD);
@@ -171,7 +182,7 @@ void brt::draw_mpislave(rn& gen)
             pertnode->setv(propv);
             if(didswap)
                pertnode->swaplr();
-            mpi_update_norm_cormat(rank,tc,pertnode,*xi,(*mi.corv)[propv],chv_lwr,chv_upr);
+            mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,(*mi.corv)[propv],chv_lwr,chv_upr);
             tree::npv bnv;
             getchgvsuff(pertnode,bnv,oldc,oldv,didswap,sivold,sivnew);
             MPI_Status status2;
@@ -181,6 +192,7 @@ void brt::draw_mpislave(rn& gen)
                pertnode->setv(propv);
                if(didswap)
                   pertnode->swaplr();
+               updoidx(pertnode);
             }
             // else reject, for which we do nothing.
          }
@@ -322,39 +334,40 @@ double brt::lm(sinfo& si)
 }
 //--------------------------------------------------
 //getsuff used for birth.
+//diter only visits the rows in bottom node nx (see getsuff), so we don't have to
+//drop every observation down the tree.
 void brt::local_getsuff(diterator& diter, tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir)    
 {
-   double *xx;//current x
    sil.n=0; sir.n=0;
 
    for(;diter<diter.until();diter++)
    {
-      xx = diter.getxp();
-      if(nx==t.bn(diter.getxp(),*xi)) { //does the bottom node = xx's bottom node
-         if(xx[v] < (*xi)[v][c]) {
-               //sil.n +=1;
-               add_observation_to_suff(diter,sil);
-          } else {
-               //sir.n +=1;
-               add_observation_to_suff(diter,sir);
-          }
-      }
+      if(goesleft(diter,v,c,*xi)) {
+            //sil.n +=1;
+            add_observation_to_suff(diter,sil);
+       } else {
+            //sir.n +=1;
+            add_observation_to_suff(diter,sir);
+       }
    }
 }
 //--------------------------------------------------
 //getsuff used for death
+//diter only visits the rows in the parent of l,r which are stored as the rows of l
+//followed by the rows of r in the observation index.
 void brt::local_getsuff(diterator& diter, tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir)
 {
+   size_t lbeg,lend;
    sil.n=0; sir.n=0;
 
+   getoidxrng(l,lbeg,lend);
    for(;diter<diter.until();diter++)
    {
-      tree::tree_cp bn = t.bn(diter.getxp(),*xi);
-      if(bn==l) {
+      if(diter<lend) {
          //sil.n +=1;
          add_observation_to_suff(diter,sil);
       }
-      if(bn==r) {
+      else {
          //sir.n +=1;
          add_observation_to_suff(diter,sir);
       }
@@ -371,17 +384,96 @@ void brt::add_observation_to_suff(diterator& diter, sinfo& si)
    si.n+=1; //in add_observation_to_suff
 }
 //--------------------------------------------------
+//(re)build the observation index for all of t.  The index keeps the rows of
+//the data ordered so that the rows falling in any node of t are contiguous,
+//so the suff stats for a node only need to visit that node's rows.
+void brt::setoidx()
+{
+   oidx.resize(di->n);
+   for(size_t i=0;i<di->n;i++) oidx[i]=(unsigned int)i;
+   oirng.clear();
+   partoidx(&t,0,di->n);
+}
+//--------------------------------------------------
+//update the observation index below nx once a move that changed the subtree
+//at nx has been accepted.  The rows of nx are sorted first so each bottom node
+//lists its rows in increasing order, which is the order a pass over all the data
+//would add them into the suff stats.
+void brt::updoidx(tree::tree_cp nx)
+{
+   size_t beg,end;
+
+   getoidxrng(nx,beg,end);
+   std::sort(oidx.begin()+beg,oidx.begin()+end);
+   partoidx(nx,beg,end);
+}
+//--------------------------------------------------
+//recursively split the rows oidx[beg..end-1] of node nx between its children.
+void brt::partoidx(tree::tree_cp nx, size_t beg, size_t end)
+{
+   oirng[nx->nid()]=std::make_pair(beg,end);
+   if(nx->l) {
+      size_t p=di->p, v=nx->v, c=nx->c;
+      std::vector<unsigned int>::iterator mid;
+      if(di->xb8) {
+         unsigned char *xb=di->xb8;
+         mid=std::stable_partition(oidx.begin()+beg,oidx.begin()+end,
+                                   [xb,p,v,c](unsigned int i) { return xb[i*p+v] <= c; });
+      }
+      else if(di->xb16) {
+         unsigned short *xb=di->xb16;
+         mid=std::stable_partition(oidx.begin()+beg,oidx.begin()+end,
+                                   [xb,p,v,c](unsigned int i) { return xb[i*p+v] <= c; });
+      }
+      else {
+         double *x=di->x;
+         double cut=(*xi)[v][c];
+         mid=std::stable_partition(oidx.begin()+beg,oidx.begin()+end,
+                                   [x,p,v,cut](unsigned int i) { return x[i*p+v] < cut; });
+      }
+      partoidx(nx->l,beg,mid-oidx.begin());
+      partoidx(nx->r,mid-oidx.begin(),end);
+   }
+}
+//--------------------------------------------------
+//get the range [beg,end) of positions in oidx holding the rows of node nx.
+//nx need not be in t, only the path from the root down to nx has to match t.
+void brt::getoidxrng(tree::tree_cp nx, size_t& beg, size_t& end)
+{
+   std::map<size_t,std::pair<size_t,size_t> >::const_iterator it=oirng.find(nx->nid());
+   if(it==oirng.end()) {
+      cout << "Error: node " << nx->nid() << " is not in the observation index!" << endl;
+      beg=0; end=0;
+      return;
+   }
+   beg=it->second.first;
+   end=it->second.second;
+}
+//--------------------------------------------------
 //getsuff wrapper used for birth.  Calls serial or parallel code depending on how
-//the code is compiled.
+//the code is compiled.  With MPI the suff stats of each rank's rows are reduced
+//across the ranks, each rank using its OpenMP team if it has one.
 void brt::getsuff(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir)
+{
+   #ifdef _OPENMPI
+      local_mpigetsuff(nx,v,c,sil,sir);
+   #else
+      rankgetsuff(nx,v,c,sil,sir);
+   #endif
+}
+//--------------------------------------------------
+//getsuff for birth over the rows held by this process
+void brt::rankgetsuff(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir)
 {
    #ifdef _OPENMP
+      std::vector<sinfo*> tsi(2*std::max(tc,omp_get_max_threads()),(sinfo*)0); //suff stats of each thread (tc=0 runs the default team), see ompaddsuff
 #     pragma omp parallel num_threads(tc)
-      local_ompgetsuff(nx,v,c,*di,sil,sir); //faster if pass dinfo by value.
-   #elif _OPENMPI
-      local_mpigetsuff(nx,v,c,*di,sil,sir);
+      local_ompgetsuff(nx,v,c,*di,tsi); //faster if pass dinfo by value.
+      ompaddsuff(tsi,sil,sir);
    #else
-      diterator diter(di);
+      size_t beg,end;
+      getoidxrng(nx,beg,end);
+      diterator diter(di,oidx.data(),beg,end);
       local_getsuff(diter,nx,v,c,sil,sir);
    #endif
 }
@@ -393,30 +485,37 @@ void brt::allsuff(tree::npv& bnv,std::vector<sinfo*>& siv)
    bnv.clear();
    t.getbots(bnv);
 
+   #ifdef _OPENMPI
+      local_mpiallsuff(bnv,siv);
+   #else
+      rankallsuff(bnv,siv);
+   #endif
+}
+//--------------------------------------------------
+//allsuff over the rows held by this process, bnv are the bots of t
+void brt::rankallsuff(tree::npv& bnv,std::vector<sinfo*>& siv)
+{
    #ifdef _OPENMP
       typedef tree::npv::size_type bvsz;
       siv.clear(); //need to setup space threads will add into
       siv.resize(bnv.size());
       for(bvsz i=0;i!=bnv.size();i++) siv[i]=newsinfo();
+      std::vector<std::vector<sinfo*>*> tsiv(std::max(tc,omp_get_max_threads())); //suff stats of each thread (tc=0 runs the default team), see local_ompaddsuff
 #     pragma omp parallel num_threads(tc)
-      local_ompallsuff(*di,bnv,siv); //faster if pass di and bnv by value.
-   #elif _OPENMPI
-      diterator diter(di);
-      local_mpiallsuff(diter,bnv,siv);
+      local_ompallsuff(*di,bnv,siv,tsiv); //faster if pass di and bnv by value.
    #else
-      diterator diter(di);
+      diterator diter(di,oidx.data(),0,di->n);
       local_allsuff(diter,bnv,siv); //will resize siv
    #endif
 }
 //--------------------------------------------------
 //local_subsuff
-void brt::local_subsuff(diterator& diter, tree::tree_p nx, tree::npv& path, tree::npv& bnv, std::vector<sinfo*>& siv)
+//diter only visits the rows that reach nx, so each one just has to be dropped down
+//the subtree below nx.
+void brt::local_subsuff(diterator& diter, tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv)
 {
    tree::tree_cp tbn; //the pointer to the bottom node for the current observation
    size_t ni;         //the  index into vector of the current bottom node
-   size_t index;      //the index into the path vector.
-   double *x;
-   tree::tree_p root=path[path.size()-1];
 
    typedef tree::npv::size_type bvsz;
    bvsz nb = bnv.size();
@@ -427,59 +526,45 @@ void brt::local_subsuff(diterator& diter, tree::tree_p nx, tree::npv& path, tree
    for(bvsz i=0;i!=bnv.size();i++) { bnmap[bnv[i]]=i; siv[i]=newsinfo(); }
 
    for(;diter<diter.until();diter++) {
-      index=path.size()-1;
-      x=diter.getxp();
-      if(root->xonpath(path,index,x,*xi)) { //x is on the subtree, 
-         tbn = nx->bn(x,*xi);              //so get the right bn below interior node n.
-         ni = bnmap[tbn];
-         //siv[ni].n +=1;
-         add_observation_to_suff(diter, *(siv[ni]));
-      }
-      //else this x doesn't map to the subtree so it's not added into suff stats.
+      tbn = getbn(*nx,diter,*xi);  //get the right bn below interior node n.
+      ni = bnmap[tbn];
+      //siv[ni].n +=1;
+      add_observation_to_suff(diter, *(siv[ni]));
    }
 }
 //-------------------------------------------------- 
 //local_ompsubsuff
-void brt::local_ompsubsuff(dinfo di, tree::tree_p nx, tree::npv& path, tree::npv bnv,std::vector<sinfo*>& siv)
+void brt::local_ompsubsuff(dinfo di, tree::tree_p nx, tree::npv bnv,std::vector<sinfo*>& siv, std::vector<std::vector<sinfo*>*>& tsiv)
 {
 #ifdef _OPENMP
    int my_rank = omp_get_thread_num();
    int thread_count = omp_get_num_threads();
-   int n = di.n;
+   size_t nbeg,nend;
+   getoidxrng(nx,nbeg,nend);
+   int n = nend-nbeg;
    int beg=0;
    int end=0;
    calcbegend(n,my_rank,thread_count,&beg,&end);
 
-   std::vector<sinfo*>& tsiv = newsinfovec(); //will be sized in local_subsuff
-   diterator diter(&di,beg,end);
-   local_subsuff(diter,nx,path,bnv,tsiv);
-
-#  pragma omp critical
-   {
-      for(size_t i=0;i<siv.size();i++) *(siv[i]) += *(tsiv[i]);
-   }
+   tsiv[my_rank] = &newsinfovec(); //will be sized in local_subsuff
+   diterator diter(&di,oidx.data(),nbeg+beg,nbeg+end);
+   local_subsuff(diter,nx,bnv,*tsiv[my_rank]);
 
-   for(size_t i=0;i<tsiv.size();i++) delete tsiv[i];
-   delete &tsiv;
+   local_ompaddsuff(tsiv,siv);
 #endif
 }
 //--------------------------------------------------
 //local_mpisubsuff
-void brt::local_mpisubsuff(diterator& diter, tree::tree_p nx, tree::npv& path, tree::npv& bnv, std::vector<sinfo*>& siv)
+void brt::local_mpisubsuff(tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv)
 {
 #ifdef _OPENMPI
-   if(rank==0) {
-      siv.clear(); //need to setup space threads will add into
-      siv.resize(bnv.size());
-      typedef tree::npv::size_type bvsz;
-      for(bvsz i=0;i!=bnv.size();i++) siv[i]=newsinfo();
- 
-      // reduce all the sinfo's across the nodes, which is model-specific.
-      local_mpi_reduce_allsuff(siv);
+   if(mpirep) {
+      ranksubsuff(nx,bnv,siv);
+      mpi_allreduce_suffs(siv);
    }
    else
    {
-      local_subsuff(diter,nx,path,bnv,siv);
+      ranksubsuff(nx,bnv,siv);  //on rank 0 as well, its rows start the sums
 
       // reduce all the sinfo's across the nodes, which is model-specific.
       local_mpi_reduce_allsuff(siv);
@@ -491,39 +576,47 @@ void brt::local_mpisubsuff(diterator& diter, tree::tree_p nx, tree::npv& path, t
 //get suff stats for bots that are only below node n.
 //NOTE!  subsuff is the only method for computing suff stats that does not
 //       assume the root of the tree you're interested is brt.t.  Instead,
-//       it takes the root of the tree to be the last entry in the path
-//       vector.  In other words, for MCMC proposals that physically
-//       construct a new proposed tree, t', suff stats must be computed
-//       on t' using subsuff.  Using getsuff or allsuff is WRONG and will
-//       result in undefined behaviour since getsuff/allsuff *assume* the 
-//       the root of the tree is brt.t.
+//       it only assumes the path from the root down to nx is the same as in
+//       brt.t, so the rows reaching nx are the ones the observation index
+//       holds for the node with the same id in brt.t.  In other words, for
+//       MCMC proposals that physically construct a new proposed tree, t',
+//       suff stats must be computed on t' using subsuff.  Using getsuff or
+//       allsuff is WRONG and will result in undefined behaviour since
+//       getsuff/allsuff *assume* the the root of the tree is brt.t.
 void brt::subsuff(tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv)
 {
-   tree::npv path;
-
    bnv.clear();
-   nx->getpathtoroot(path);  //path from n back to root
    nx->getbots(bnv);  //all bots ONLY BELOW node n!!
 
+   #ifdef _OPENMPI
+      local_mpisubsuff(nx,bnv,siv);
+   #else
+      ranksubsuff(nx,bnv,siv);
+   #endif
+}
+//--------------------------------------------------
+//subsuff over the rows held by this process, bnv are the bots below nx
+void brt::ranksubsuff(tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv)
+{
    #ifdef _OPENMP
       typedef tree::npv::size_type bvsz;
       siv.clear(); //need to setup space threads will add into
       siv.resize(bnv.size());
       for(bvsz i=0;i!=bnv.size();i++) siv[i]=newsinfo();
+      std::vector<std::vector<sinfo*>*> tsiv(std::max(tc,omp_get_max_threads())); //suff stats of each thread (tc=0 runs the default team), see local_ompaddsuff
 #     pragma omp parallel num_threads(tc)
-      local_ompsubsuff(*di,nx,path,bnv,siv); //faster if pass di and bnv by value.
-   #elif _OPENMPI
-      diterator diter(di);
-      local_mpisubsuff(diter,nx,path,bnv,siv);
+      local_ompsubsuff(*di,nx,bnv,siv,tsiv); //faster if pass di and bnv by value.
    #else
-      diterator diter(di);
-      local_subsuff(diter,nx,path,bnv,siv);
+      size_t beg,end;
+      getoidxrng(nx,beg,end);
+      diterator diter(di,oidx.data(),beg,end);
+      local_subsuff(diter,nx,bnv,siv);
    #endif
 }
 
 //--------------------------------------------------
 //allsuff (2)
-void brt::local_ompallsuff(dinfo di, tree::npv bnv,std::vector<sinfo*>& siv)
+void brt::local_ompallsuff(dinfo di, tree::npv bnv,std::vector<sinfo*>& siv, std::vector<std::vector<sinfo*>*>& tsiv)
 {
 #ifdef _OPENMP
    int my_rank = omp_get_thread_num();
@@ -533,18 +626,37 @@ void brt::local_ompallsuff(dinfo di, tree::npv bnv,std::vector<sinfo*>& siv)
    int end=0;
    calcbegend(n,my_rank,thread_count,&beg,&end);
 
-   std::vector<sinfo*>& tsiv = newsinfovec(); //will be sized in local_allsuff
+   tsiv[my_rank] = &newsinfovec(); //will be sized in local_allsuff
 
-   diterator diter(&di,beg,end);
-   local_allsuff(diter,bnv,tsiv);
+   diterator diter(&di,oidx.data(),beg,end);
+   local_allsuff(diter,bnv,*tsiv[my_rank]);
 
-#  pragma omp critical
-   {
-      for(size_t i=0;i<siv.size();i++) *(siv[i]) += *(tsiv[i]);
-   }
-   
-   for(size_t i=0;i<tsiv.size();i++) delete tsiv[i];
-   delete &tsiv;
+   local_ompaddsuff(tsiv,siv);
+#endif
+}
+
+//--------------------------------------------------
+//called by all the threads of the team once each has its suff stats for the
+//bottom nodes in tsiv[my_rank].  After a barrier each thread adds up a share of
+//the bottom nodes over all the threads, in thread order, so there is no critical
+//section and the sums don't depend on how the threads were scheduled.
+void brt::local_ompaddsuff(std::vector<std::vector<sinfo*>*>& tsiv, std::vector<sinfo*>& siv)
+{
+#ifdef _OPENMP
+   int my_rank = omp_get_thread_num();
+   int thread_count = omp_get_num_threads();
+   int beg=0;
+   int end=0;
+   calcbegend(siv.size(),my_rank,thread_count,&beg,&end);
+
+#  pragma omp barrier
+   for(int i=beg;i<end;i++)
+      for(int j=0;j<thread_count;j++) *(siv[i]) += *((*tsiv[j])[i]);
+#  pragma omp barrier
+
+   std::vector<sinfo*>& mysiv = *tsiv[my_rank];
+   for(size_t i=0;i<mysiv.size();i++) delete mysiv[i];
+   delete &mysiv;
 #endif
 }
 
@@ -553,6 +665,7 @@ void brt::local_ompallsuff(dinfo di, tree::npv bnv,std::vector<sinfo*>& siv)
 void brt::mpi_resetrn(rn& gen)
 {
 #ifdef _OPENMPI
+   if(mpirep) return;  //the generators were seeded alike and never diverge
    if(rank==0) {
       // reset the rn generator so they are the same on all nodes
       // so that we can draw random numbers in parallel on each node w/o communication.
@@ -564,11 +677,11 @@ void brt::mpi_resetrn(rn& gen)
 
 //      cout << "state is " << state.str() << " and ul is " << ulstate << endl;
 
-      MPI_Request *request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&ulstate,1,MPI_UNSIGNED_LONG,i,MPI_TAG_RESET_RNG,MPI_COMM_WORLD,&request[i-1]);
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
    }
    else
@@ -588,7 +701,7 @@ void brt::mpi_resetrn(rn& gen)
       tempgen.set_engine_state(state);
      }
 /*   if(rank==0) {
-      MPI_Request *request=new MPI_Request[tc];
+      MPI_Request *request=new MPI_Request[nslaves];
       // reset the rn generator so they are the same on all nodes
       // so that we can draw random numbers in parallel on each node w/o communication.
       time_t timer;
@@ -600,13 +713,13 @@ void brt::mpi_resetrn(rn& gen)
       time(&timer);  // get current time
       seconds=(int)difftime(timer,mktime(&y2k));
 
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&seconds,1,MPI_INT,i,MPI_TAG_RESET_RNG,MPI_COMM_WORLD,&request[i-1]);
       }
 
       crn& tempgen=static_cast<crn&>(gen);
       tempgen.set_seed(seconds);
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 // cout << "0) Reset seconds: " << seconds << " gen.unif:" << gen.uniform() << " gen.unif:" << gen.uniform() << endl;
    }
@@ -623,21 +736,16 @@ void brt::mpi_resetrn(rn& gen)
 }
 //--------------------------------------------------
 //allsuff (2) -- MPI version
-void brt::local_mpiallsuff(diterator& diter, tree::npv& bnv,std::vector<sinfo*>& siv)
+void brt::local_mpiallsuff(tree::npv& bnv,std::vector<sinfo*>& siv)
 {
 #ifdef _OPENMPI
-   if(rank==0) {
-      siv.clear(); //need to setup space threads will add into
-      siv.resize(bnv.size());
-      typedef tree::npv::size_type bvsz;
-      for(bvsz i=0;i!=bnv.size();i++) siv[i]=newsinfo();
- 
-      // reduce all the sinfo's across the nodes, which is model-specific.
-      local_mpi_reduce_allsuff(siv);
+   if(mpirep) {
+      rankallsuff(bnv,siv);
+      mpi_allreduce_suffs(siv);
    }
    else
    {
-      local_allsuff(diter,bnv,siv);
+      rankallsuff(bnv,siv);  //on rank 0 as well, its rows start the sums
 
       // reduce all the sinfo's across the nodes, which is model-specific.
       local_mpi_reduce_allsuff(siv);
@@ -653,21 +761,21 @@ void brt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
 
    // cast to int
    for(size_t i=0;i<siv.size();i++)
-      nvec[i]=(unsigned int)siv[i]->n;  // on root node, this should be 0 because of newsinfo().
+      nvec[i]=(unsigned int)siv[i]->n;  // on root node, the suff stats of its own rows (0 if it holds none).
 // cout << "pre:" << siv[0]->n << " " << siv[1]->n << endl;
    // MPI sum
 //   MPI_Allreduce(MPI_IN_PLACE,&nvec,siv.size(),MPI_UNSIGNED,MPI_SUM,MPI_COMM_WORLD);
    if(rank==0) {
       MPI_Status status;
       unsigned int tempvec[siv.size()];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempvec,siv.size(),MPI_UNSIGNED,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             nvec[j]+=tempvec[j];
       }
 
-      MPI_Request *request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&nvec,siv.size(),MPI_UNSIGNED,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
 
@@ -675,7 +783,7 @@ void brt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
       for(size_t i=0;i<siv.size();i++)
          siv[i]->n=(size_t)nvec[i];
 
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
    }
    else {
@@ -698,25 +806,42 @@ void brt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
 #endif
 }
 //--------------------------------------------------
+//replicated mode: add up the suff stats in siv over all the ranks.  Each sinfo is
+//packed into mpi_suffsize() doubles so a single MPI_Allreduce does the lot.  Open MPI
+//and MPICH hand every rank the same bits for an MPI_SUM allreduce, so all the ranks
+//make the same accept/reject decision.
+void brt::mpi_allreduce_suffs(std::vector<sinfo*>& siv)
+{
+#ifdef _OPENMPI
+   size_t ns=mpi_suffsize();
+   std::vector<double> buf(ns*siv.size());
+   for(size_t i=0;i<siv.size();i++)
+      local_mpi_packsuff(*siv[i],&buf[i*ns]);
+   MPI_Allreduce(MPI_IN_PLACE,buf.data(),(int)buf.size(),MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+   for(size_t i=0;i<siv.size();i++)
+      local_mpi_unpacksuff(&buf[i*ns],*siv[i]);
+#endif
+}
+//--------------------------------------------------
 //allsuff (3)
+//diter runs over positions in the observation index, so the rows of each bottom node
+//are the part of that node's range that falls within diter.
 void brt::local_allsuff(diterator& diter, tree::npv& bnv,std::vector<sinfo*>& siv)
 {
-   tree::tree_cp tbn; //the pointer to the bottom node for the current observations
-   size_t ni;         //the  index into vector of the current bottom node
+   size_t beg,end;
 
    typedef tree::npv::size_type bvsz;
    bvsz nb = bnv.size();
    siv.clear();
    siv.resize(nb);
 
-   std::map<tree::tree_cp,size_t> bnmap;
-   for(bvsz i=0;i!=bnv.size();i++) { bnmap[bnv[i]]=i; siv[i]=newsinfo(); }
-
-   for(;diter<diter.until();diter++) {
-      tbn = t.bn(diter.getxp(),*xi);
-      ni = bnmap[tbn];
-      //siv[ni].n +=1; 
-      add_observation_to_suff(diter, *(siv[ni]));
+   for(bvsz i=0;i!=nb;i++) {
+      siv[i]=newsinfo();
+      getoidxrng(bnv[i],beg,end);
+      beg=std::max(beg,diter.getpos());
+      end=std::min(end,diter.until());
+      for(diterator biter(diter,beg,end);biter<biter.until();biter++)
+         add_observation_to_suff(biter, *(siv[i]));
    }
 }
 /*
@@ -748,14 +873,26 @@ void brt::getpertsuff(tree::tree_p pertnode, tree::npv& bnv, size_t oldc,
 //getsuff wrapper used for death.  Calls serial or parallel code depending on how
 //the code is compiled.
 void brt::getsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir)
+{
+   #ifdef _OPENMPI
+      local_mpigetsuff(l,r,sil,sir);
+   #else
+      rankgetsuff(l,r,sil,sir);
+   #endif
+}
+//--------------------------------------------------
+//getsuff for death over the rows held by this process
+void brt::rankgetsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir)
 {
    #ifdef _OPENMP
+      std::vector<sinfo*> tsi(2*std::max(tc,omp_get_max_threads()),(sinfo*)0); //suff stats of each thread (tc=0 runs the default team), see ompaddsuff
 #     pragma omp parallel num_threads(tc)
-      local_ompgetsuff(l,r,*di,sil,sir); //faster if pass dinfo by value.
-   #elif _OPENMPI
-      local_mpigetsuff(l,r,*di,sil,sir);
+      local_ompgetsuff(l,r,*di,tsi); //faster if pass dinfo by value.
+      ompaddsuff(tsi,sil,sir);
    #else
-         diterator diter(di);
+         size_t beg,end;
+         getoidxrng(l->getp(),beg,end);
+         diterator diter(di,oidx.data(),beg,end);
          local_getsuff(diter,l,r,sil,sir);
    #endif
 }
@@ -765,59 +902,58 @@ void brt::getsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir)
 //#ifdef _OPENMP
 //--------------------------------------------------
 //openmp version of getsuff for birth
-void brt::local_ompgetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo& sil, sinfo& sir)
+void brt::local_ompgetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, std::vector<sinfo*>& tsi)
 {
 #ifdef _OPENMP
    int my_rank = omp_get_thread_num();
    int thread_count = omp_get_num_threads();
-   int n = di.n;
+   size_t nbeg,nend;
+   getoidxrng(nx,nbeg,nend);
+   int n = nend-nbeg;
    int beg=0;
    int end=0;
    calcbegend(n,my_rank,thread_count,&beg,&end);
 
-   sinfo& tsil = *newsinfo();
-   sinfo& tsir = *newsinfo();
+   sinfo& tsil = *(tsi[2*my_rank] = newsinfo());
+   sinfo& tsir = *(tsi[2*my_rank+1] = newsinfo());
 
-   diterator diter(&di,beg,end);
+   diterator diter(&di,oidx.data(),nbeg+beg,nbeg+end);
    local_getsuff(diter,nx,v,c,tsil,tsir);
-
-#  pragma omp critical
-   {
-      sil+=tsil; sir+=tsir;
-   }
-
-   delete &tsil;
-   delete &tsir;
 #endif
 }
 //--------------------------------------------------
 //opemmp version of getsuff for death
-void brt::local_ompgetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil, sinfo& sir)
+void brt::local_ompgetsuff(tree::tree_p l, tree::tree_p r, dinfo di, std::vector<sinfo*>& tsi)
 {
 #ifdef _OPENMP
    int my_rank = omp_get_thread_num();
    int thread_count = omp_get_num_threads();
-   int n = di.n;
+   size_t nbeg,nend;
+   getoidxrng(l->getp(),nbeg,nend);
+   int n = nend-nbeg;
    int beg=0;
    int end=0;
    calcbegend(n,my_rank,thread_count,&beg,&end);
 
-//   sinfo tsil, tsir;
-   sinfo& tsil = *newsinfo();
-   sinfo& tsir = *newsinfo();
+   sinfo& tsil = *(tsi[2*my_rank] = newsinfo());
+   sinfo& tsir = *(tsi[2*my_rank+1] = newsinfo());
 
-   diterator diter(&di,beg,end);
+   diterator diter(&di,oidx.data(),nbeg+beg,nbeg+end);
    local_getsuff(diter,l,r,tsil,tsir);
-
-#  pragma omp critical
-   {
-      sil+=tsil; sir+=tsir;
-   }
-
-   delete &tsil;
-   delete &tsir;
 #endif
 }
+//--------------------------------------------------
+//add up the left and right suff stats the threads left in tsi[2t] and tsi[2t+1]
+//in thread order, so the sums don't depend on how the threads were scheduled.
+void brt::ompaddsuff(std::vector<sinfo*>& tsi, sinfo& sil, sinfo& sir)
+{
+   for(size_t i=0;i<tsi.size();i+=2) {
+      if(!tsi[i]) continue;  //fewer threads than tc
+      sil+=*tsi[i]; sir+=*tsi[i+1];
+      delete tsi[i];
+      delete tsi[i+1];
+   }
+}
 //#endif
 
 //--------------------------------------------------
@@ -825,13 +961,18 @@ void brt::local_ompgetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil,
 //#ifdef _OPENMPI
 //--------------------------------------------------
 // MPI version of getsuff for birth
-void brt::local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo& sil, sinfo& sir)
+void brt::local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir)
 {
 #ifdef _OPENMPI
-   if(rank==0) {
+   if(mpirep) {
+      rankgetsuff(nx,v,c,sil,sir);
+      std::vector<sinfo*> siv={&sil,&sir};
+      mpi_allreduce_suffs(siv);
+   }
+   else if(rank==0) {
       char buffer[SIZE_UINT3];
       int position=0;
-      MPI_Request *request=new MPI_Request[tc];
+      MPI_Request *request=new MPI_Request[nslaves];
       const int tag=MPI_TAG_BD_BIRTH_VC;
       unsigned int vv,cc,nxid;
 
@@ -843,10 +984,11 @@ void brt::local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo&
       MPI_Pack(&nxid,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&vv,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&cc,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(buffer,SIZE_UINT3,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      rankgetsuff(nx,v,c,sil,sir);  //rank 0's own rows, if it holds any
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
 
       // MPI receive all the answers from the slaves
       local_mpi_sr_suffs(sil,sir);
@@ -854,8 +996,7 @@ void brt::local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo&
    }
    else
    {
-      diterator diter(&di);
-      local_getsuff(diter,nx,v,c,sil,sir);
+      rankgetsuff(nx,v,c,sil,sir);
 
       // MPI send all the answers to root
       local_mpi_sr_suffs(sil,sir);
@@ -864,13 +1005,18 @@ void brt::local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo&
 }
 //--------------------------------------------------
 // MPI version of getsuff for death
-void brt::local_mpigetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil, sinfo& sir)
+void brt::local_mpigetsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir)
 {
 #ifdef _OPENMPI
-   if(rank==0) {
+   if(mpirep) {
+      rankgetsuff(l,r,sil,sir);
+      std::vector<sinfo*> siv={&sil,&sir};
+      mpi_allreduce_suffs(siv);
+   }
+   else if(rank==0) {
       char buffer[SIZE_UINT3];
       int position=0;  
-      MPI_Request *request=new MPI_Request[tc];
+      MPI_Request *request=new MPI_Request[nslaves];
       const int tag=MPI_TAG_BD_DEATH_LR;
       unsigned int nlid,nrid;
 
@@ -880,10 +1026,11 @@ void brt::local_mpigetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil,
       // Pack and send info to the slaves
       MPI_Pack(&nlid,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&nrid,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
-      for(size_t i=1; i<=(size_t)tc; i++) {   
+      for(size_t i=1; i<=(size_t)nslaves; i++) {   
          MPI_Isend(buffer,SIZE_UINT3,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      rankgetsuff(l,r,sil,sir);  //rank 0's own rows, if it holds any
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
 
       // MPI receive all the answers from the slaves
       local_mpi_sr_suffs(sil,sir);
@@ -891,8 +1038,7 @@ void brt::local_mpigetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil,
       delete[] request;
    }
    else {
-      diterator diter(&di);
-      local_getsuff(diter,l,r,sil,sir);
+      rankgetsuff(l,r,sil,sir);
 
       // MPI send all the answers to root
       local_mpi_sr_suffs(sil,sir);
@@ -912,7 +1058,7 @@ void brt::local_mpi_sr_suffs(sinfo& sil, sinfo& sir)
       char buffer[SIZE_UINT2];
       int position=0;
       unsigned int ln,rn;      
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          position=0;
          MPI_Recv(buffer,SIZE_UINT2,MPI_PACKED,MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&status);
          MPI_Unpack(buffer,SIZE_UINT2,&position,&ln,1,MPI_UNSIGNED,MPI_COMM_WORLD);
@@ -970,7 +1116,7 @@ void brt::local_setf(diterator& diter)
    tree::tree_p bn;
 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       yhat[*diter] = bn->gettheta();
    }
 }
@@ -1004,7 +1150,7 @@ void brt::local_setr(diterator& diter)
    tree::tree_p bn;
 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       resid[*diter] = 0.0 - bn->gettheta();
 //      resid[*diter] = di->y[*diter] - bn->gettheta();
    }
@@ -1040,7 +1186,7 @@ void brt::local_predict(diterator& diter)
    tree::tree_p bn;
 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       diter.sety(bn->gettheta());
    }
 }
@@ -1122,6 +1268,76 @@ void brt::local_loadtree(size_t iter, int beg, int end, std::vector<int>& nn, st
    //beg,end are not used in the single-tree models.
    t.vectotree(nn[iter],&id[iter][0],&v[iter][0],&c[iter][0],&theta[iter][0]);
 }
+//--------------------------------------------------
+//save/load the state of the chain for checkpoints (binary).
+//theta and thetavec are both kept for every node so the same code serves the
+//scalar and the vector parameter models.
+void brt::savestate(std::ostream& os)
+{
+   tree::cnpv nds;
+   t.getnodes(nds);
+   size_t nn=nds.size();
+   std::vector<int> id(nn),v(nn),c(nn);
+   std::vector<double> theta(nn);
+   t.treetovec(&id[0],&v[0],&c[0],&theta[0]);
+   writebinvec(os,id); writebinvec(os,v); writebinvec(os,c); writebinvec(os,theta);
+   for(size_t i=0;i<nn;i++) {
+      vxd tv=nds[i]->getthetavec();
+      std::vector<double> tvv(tv.data(),tv.data()+tv.size());
+      writebinvec(os,tvv);
+   }
+
+   writebin(os,mi.pbd); writebin(os,mi.pb); writebin(os,mi.pertalpha);
+   writebin(os,mi.pertproposal); writebin(os,mi.pertaccept);
+   writebin(os,mi.rotproposal); writebin(os,mi.rotaccept);
+   writebin(os,mi.bproposal); writebin(os,mi.baccept);
+   writebin(os,mi.dproposal); writebin(os,mi.daccept);
+   writebin(os,mi.chgvproposal); writebin(os,mi.chgvaccept);
+   writebin(os,mi.dostats);
+   if(mi.dostats) {
+      writebin(os,mi.tavgd); writebin(os,mi.tmaxd); writebin(os,mi.tmind);
+      os.write((const char*)mi.varcount,xi->size()*sizeof(unsigned int));
+   }
+
+   writebinvec(os,yhat);
+   writebinvec(os,resid);
+}
+void brt::loadstate(std::istream& is)
+{
+   std::vector<int> id,v,c;
+   std::vector<double> theta,tvv;
+   readbinvec(is,id); readbinvec(is,v); readbinvec(is,c); readbinvec(is,theta);
+   if(!is || id.empty()) { is.setstate(std::ios::failbit); return; }
+   t.vectotree(id.size(),&id[0],&v[0],&c[0],&theta[0]);
+   tree::npv nds;
+   t.getnodes(nds);
+   for(size_t i=0;i<nds.size();i++) {
+      readbinvec(is,tvv);
+      vxd tv(tvv.size());
+      for(size_t j=0;j<tvv.size();j++) tv(j)=tvv[j];
+      nds[i]->setthetavec(tv);
+   }
+
+   bool dostats=false;
+   readbin(is,mi.pbd); readbin(is,mi.pb); readbin(is,mi.pertalpha);
+   readbin(is,mi.pertproposal); readbin(is,mi.pertaccept);
+   readbin(is,mi.rotproposal); readbin(is,mi.rotaccept);
+   readbin(is,mi.bproposal); readbin(is,mi.baccept);
+   readbin(is,mi.dproposal); readbin(is,mi.daccept);
+   readbin(is,mi.chgvproposal); readbin(is,mi.chgvaccept);
+   readbin(is,dostats);
+   if(dostats) {
+      if(!mi.dostats) setstats(true);
+      readbin(is,mi.tavgd); readbin(is,mi.tmaxd); readbin(is,mi.tmind);
+      is.read((char*)mi.varcount,xi->size()*sizeof(unsigned int));
+   }
+
+   readbinvec(is,yhat);
+   readbinvec(is,resid);
+   //the index is canonical (rows in increasing order within each node), so rebuilding
+   //it gives the same order the chain had.  Ensemble objects don't keep one.
+   if(!oidx.empty()) setoidx();
+}
 
 //--------------------------------------------------
 //--------------------------------------------------
@@ -1168,24 +1384,25 @@ void brt::bd(rn& gen)
       double thetal,thetar; //parameters for new bottom nodes, left and right
       double uu = gen.uniform();
 #ifdef _OPENMPI
-      MPI_Request *request = new MPI_Request[tc];
+      MPI_Request *request = new MPI_Request[nslaves];
 #endif
       if( !hardreject && (log(uu) < lalpha) ) {
          thetal = 0.0;//drawnodetheta(sil,gen);
          thetar = 0.0;//drawnodetheta(sir,gen);
          t.birthp(nx,v,c,thetal,thetar);
+         updoidx(nx);
          mi.baccept++;
 #ifdef _OPENMPI
 //        cout << "accept birth " << lalpha << endl;
          const int tag=MPI_TAG_BD_BIRTH_VC_ACCEPT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
 //        cout << "reject birth " << lalpha << endl;
          const int tag=MPI_TAG_BD_BIRTH_VC_REJECT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -1196,7 +1413,7 @@ void brt::bd(rn& gen)
       delete &sir;
       delete &sit;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    } else {
@@ -1229,23 +1446,24 @@ void brt::bd(rn& gen)
       //try metrop
       double theta;
 #ifdef _OPENMPI
-      MPI_Request *request = new MPI_Request[tc];
+      MPI_Request *request = new MPI_Request[nslaves];
 #endif
       if(log(gen.uniform()) < lalpha) {
          theta = 0.0;//drawnodetheta(sit,gen);
          t.deathp(nx,theta);
+         updoidx(nx);
          mi.daccept++;
 #ifdef _OPENMPI
 //        cout << "accept death " << lalpha << endl;
          const int tag=MPI_TAG_BD_DEATH_LR_ACCEPT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
 //        cout << "reject death " << lalpha << endl;
          const int tag=MPI_TAG_BD_DEATH_LR_REJECT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -1256,7 +1474,7 @@ void brt::bd(rn& gen)
       delete &sir;
       delete &sit;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    }
@@ -1377,7 +1595,10 @@ void brt::drawvec_mpislave(rn& gen)
       getsuff(nx,(size_t)v,(size_t)c,tsil,tsir);
       MPI_Status status2;
       MPI_Recv(buffer,0,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status2);
-      if(status2.MPI_TAG==MPI_TAG_BD_BIRTH_VC_ACCEPT) t.birthp(nx,(size_t)v,(size_t)c,theta0,theta0); //accept birth
+      if(status2.MPI_TAG==MPI_TAG_BD_BIRTH_VC_ACCEPT) { //accept birth
+         t.birthp(nx,(size_t)v,(size_t)c,theta0,theta0);
+         updoidx(nx);
+      }
       //else reject, for which we do nothing.
    }
    else if(status.MPI_TAG==MPI_TAG_BD_DEATH_LR) {
@@ -1390,7 +1611,11 @@ void brt::drawvec_mpislave(rn& gen)
       getsuff(nl,nr,tsil,tsir);
       MPI_Status status2;
       MPI_Recv(buffer,0,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status2);
-      if(status2.MPI_TAG==MPI_TAG_BD_DEATH_LR_ACCEPT) t.deathp(nl->getp(),theta0); //accept death
+      if(status2.MPI_TAG==MPI_TAG_BD_DEATH_LR_ACCEPT) { //accept death
+         tree::tree_p nx=nl->getp();
+         t.deathp(nx,theta0);
+         updoidx(nx);
+      }
       //else reject, for which we do nothing.
    }
    else if(status.MPI_TAG==MPI_TAG_ROTATE) {
@@ -1428,7 +1653,10 @@ void brt::drawvec_mpislave(rn& gen)
             getpertsuff(pertnode,bnv,oldc,sivold,sivnew);
             MPI_Status status2;
             MPI_Recv(buffer,0,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status2);
-            if(status2.MPI_TAG==MPI_TAG_PERTCV_ACCEPT) pertnode->setc(propc); //accept new cutpoint
+            if(status2.MPI_TAG==MPI_TAG_PERTCV_ACCEPT) { //accept new cutpoint
+               pertnode->setc(propc);
+               updoidx(pertnode);
+            }
             //else reject, for which we do nothing.
          }
          else if(status.MPI_TAG==MPI_TAG_PERTCHGV)
@@ -1439,7 +1667,7 @@ void brt::drawvec_mpislave(rn& gen)
             unsigned int propcint;
             unsigned int propvint;
             position=0;
-            mpi_update_norm_cormat(rank,tc,pertnode,*xi,(*mi.corv)[oldv],chv_lwr,chv_upr);
+            mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,(*mi.corv)[oldv],chv_lwr,chv_upr);
             MPI_Recv(buffer,SIZE_UINT3,MPI_PACKED,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             MPI_Unpack(buffer,SIZE_UINT3,&position,&propcint,1,MPI_UNSIGNED,MPI_COMM_WORLD);
             MPI_Unpack(buffer,SIZE_UINT3,&position,&propvint,1,MPI_UNSIGNED,MPI_COMM_WORLD);
@@ -1450,7 +1678,7 @@ void brt::drawvec_mpislave(rn& gen)
             pertnode->setv(propv);
             if(didswap)
                pertnode->swaplr();
-            mpi_update_norm_cormat(rank,tc,pertnode,*xi,(*mi.corv)[propv],chv_lwr,chv_upr);
+            mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,(*mi.corv)[propv],chv_lwr,chv_upr);
             tree::npv bnv;
             getchgvsuff(pertnode,bnv,oldc,oldv,didswap,sivold,sivnew);
             MPI_Status status2;
@@ -1460,6 +1688,7 @@ void brt::drawvec_mpislave(rn& gen)
                pertnode->setv(propv);
                if(didswap)
                   pertnode->swaplr();
+               updoidx(pertnode);
             }
             // else reject, for which we do nothing.
          }
@@ -1516,7 +1745,7 @@ void brt::bd_vec(rn& gen)
       double lalpha=0.0;
       double lml, lmr, lmt;  // lm is the log marginal left,right,total
       if((sil.n>=mi.minperbot) && (sir.n>=mi.minperbot)) { 
-         lml=lm(sil); lmr=lm(sir); lmt=lm(sit);
+         lmbirth(nx,v,c,sil,sir,sit,lml,lmr,lmt);
          hardreject=false;
          lalpha = log(pr) + (lml+lmr-lmt);
          //std::cout << "lml" << lml << std::endl;
@@ -1531,24 +1760,25 @@ void brt::bd_vec(rn& gen)
       double uu = gen.uniform();
       //std::cout << "lu" << log(uu) << std::endl;
 #ifdef _OPENMPI
-      MPI_Request *request = new MPI_Request[tc];
+      MPI_Request *request = new MPI_Request[nslaves];
 #endif
       if( !hardreject && (log(uu) < lalpha) ) {
          thetavecl = Eigen::VectorXd:: Zero(k); 
          thetavecr = Eigen::VectorXd:: Zero(k); 
          t.birthp(nx,v,c,thetavecl,thetavecr);
+         updoidx(nx);
          mi.baccept++;
 #ifdef _OPENMPI
 //        cout << "accept birth " << lalpha << endl;
          const int tag=MPI_TAG_BD_BIRTH_VC_ACCEPT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
 //        cout << "reject birth " << lalpha << endl;
          const int tag=MPI_TAG_BD_BIRTH_VC_REJECT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -1559,7 +1789,7 @@ void brt::bd_vec(rn& gen)
       delete &sir;
       delete &sit;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    } else {
@@ -1585,7 +1815,7 @@ void brt::bd_vec(rn& gen)
       //--------------------------------------------------
       //compute alpha
       double lml, lmr, lmt;  // lm is the log marginal left,right,total
-      lml=lm(sil); lmr=lm(sir); lmt=lm(sit);
+      lmdeath(nx->getl(),nx->getr(),sil,sir,sit,lml,lmr,lmt);
       double lalpha = log(pr) + (lmt - lml - lmr);
       lalpha = std::min(0.0,lalpha);
 
@@ -1593,23 +1823,24 @@ void brt::bd_vec(rn& gen)
       //try metrop
       Eigen::VectorXd thetavec(k);
 #ifdef _OPENMPI
-      MPI_Request *request = new MPI_Request[tc];
+      MPI_Request *request = new MPI_Request[nslaves];
 #endif
       if(log(gen.uniform()) < lalpha) {
          thetavec = Eigen::VectorXd::Zero(k); 
          t.deathp(nx,thetavec);
+         updoidx(nx);
          mi.daccept++;
 #ifdef _OPENMPI
 //        cout << "accept death " << lalpha << endl;
          const int tag=MPI_TAG_BD_DEATH_LR_ACCEPT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
 //        cout << "reject death " << lalpha << endl;
          const int tag=MPI_TAG_BD_DEATH_LR_REJECT;
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -1620,7 +1851,7 @@ void brt::bd_vec(rn& gen)
       delete &sir;
       delete &sit;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    }
@@ -1658,7 +1889,7 @@ void brt::local_setf_mix(diterator& diter)
    tree::tree_p bn;
    vxd thetavec_temp(k); //Initialize a temp vector to facilitate the fitting
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       thetavec_temp = bn->getthetavec(); 
       yhat[*diter] = (*fi).row(*diter)*thetavec_temp;
    }
@@ -1695,8 +1926,8 @@ void brt::local_setr_mix(diterator& diter)
    vxd thetavec_temp(k); //Initialize a temp vector to facilitate the fitting
 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
+      bn = getbn(t,diter,*xi);
       thetavec_temp = bn->getthetavec();
       resid[*diter] = di->y[*diter] - (*fi).row(*diter)*thetavec_temp;
    }
@@ -1715,7 +1946,7 @@ void brt::predict_mix(dinfo* dipred, finfo* fipred) {
 }
 
 //Local predictions for model mixing over omp
-void brt::local_omppredict_mix(dinfo dipred, finfo fipred)
+void brt::local_omppredict_mix(dinfo dipred, finfo& fipred)
 {
 #ifdef _OPENMP
    int my_rank = omp_get_thread_num();
@@ -1735,7 +1966,7 @@ void brt::local_predict_mix(diterator& diter, finfo& fipred){
    tree::tree_p bn;
    vxd thetavec_temp(k); 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       thetavec_temp = bn->getthetavec();
       diter.sety(fipred.row(*diter)*thetavec_temp);
    }
@@ -1780,13 +2011,13 @@ void brt::local_get_mix_wts(diterator &diter, mxd &wts){
    tree::tree_p bn;
    vxd thetavec_temp(k); 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       thetavec_temp = bn->getthetavec();
       wts.col(*diter) = thetavec_temp; //sets the thetavec to be the ith column of the wts eigen matrix. 
    }
 }
 
-void brt::local_ompget_mix_wts(dinfo dipred, mxd wts){
+void brt::local_ompget_mix_wts(dinfo dipred, mxd& wts){
 #ifdef _OPENMP
    int my_rank = omp_get_thread_num();
    int thread_count = omp_get_num_threads();
@@ -1817,7 +2048,7 @@ void brt::local_get_mix_theta(diterator &diter, mxd &wts){
    vxd thetavec_temp(k);
    bool enter = true; 
    for(;diter<diter.until();diter++) {
-      bn = t.bn(diter.getxp(),*xi);
+      bn = getbn(t,diter,*xi);
       thetavec_temp = bn->getthetavec();
       if(enter){
          wts.col(0) = thetavec_temp; //sets the thetavec to be the 1st column of the wts eigen matrix.
@@ -1977,16 +2208,16 @@ void brt::pertcv(rn& gen)
       size_t oldv=pertnode->getv();
       size_t newv;
 #ifdef _OPENMPI 
-      MPI_Request *request = new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request = new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCHGV,MPI_COMM_WORLD,&request[i-1]);
       }
       std::vector<double> chgvrow;
       chgvrow=(*mi.corv)[oldv]; 
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 
-      mpi_update_norm_cormat(rank,tc,pertnode,*xi,chgvrow,chv_lwr,chv_upr);
+      mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,chgvrow,chv_lwr,chv_upr);
       newv=getchgvfromrow(oldv,chgvrow,gen);
 #else
       std::vector<std::vector<double> > chgv;
@@ -2012,22 +2243,22 @@ void brt::pertcv(rn& gen)
 #ifdef _OPENMPI
       unsigned int propcint=(unsigned int)newc;
       unsigned int propvint=(unsigned int)newv;
-      request = new MPI_Request[tc];
+      request = new MPI_Request[nslaves];
       char buffer[SIZE_UINT3];
       int position=0;
       MPI_Pack(&propcint,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&propvint,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&didswap,1,MPI_CXX_BOOL,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(buffer,SIZE_UINT3,MPI_PACKED,i,MPI_TAG_PERTCHGV,MPI_COMM_WORLD,&request[i-1]);
       }
       std::vector<double> chgvrownew;
       chgvrownew=(*mi.corv)[newv];
  
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 
-      mpi_update_norm_cormat(rank,tc,pertnode,*xi,chgvrownew,chv_lwr,chv_upr);
+      mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,chgvrownew,chv_lwr,chv_upr);
       if(chgvrownew[oldv]==0.0)
          cout << "Proposal newv cannot return to oldv!  This is not possible!" << endl;
 
@@ -2069,7 +2300,7 @@ void brt::pertcv(rn& gen)
       double alpha = std::min(1.0,alpha2);
       if(hardreject) alpha=0.0;  //change of variable led to an bottom node with <minperbot observations in it, we reject this.
 #ifdef _OPENMPI
-      request = new MPI_Request[tc];
+      request = new MPI_Request[nslaves];
 #endif
 
       if(gen.uniform()<alpha) {
@@ -2078,12 +2309,12 @@ void brt::pertcv(rn& gen)
          pertnode->setv(newv); //because the call to getchgvsuff changes it back to oldv to calc the old lil
          pertnode->setc(newc); //because the call to getchgvsuff changes it back to oldc to calc the old lil
 #ifdef _OPENMPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCHGV_ACCEPT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCHGV_REJECT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -2097,7 +2328,7 @@ void brt::pertcv(rn& gen)
       delete &sivold;
       delete &sivnew;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    }
@@ -2119,11 +2350,11 @@ void brt::pertcv(rn& gen)
       pertnode->setc(propc);
 #ifdef _OPENMPI
          unsigned int propcint=(unsigned int)propc;
-         MPI_Request *request = new MPI_Request[tc];
+         MPI_Request *request = new MPI_Request[nslaves];
          char buffer[SIZE_UINT1];
          int position=0;
          MPI_Pack(&propcint,1,MPI_UNSIGNED,buffer,SIZE_UINT1,&position,MPI_COMM_WORLD);
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(buffer,SIZE_UINT1,MPI_PACKED,i,MPI_TAG_PERTCV,MPI_COMM_WORLD,&request[i-1]);
          }
 #endif
@@ -2137,7 +2368,7 @@ void brt::pertcv(rn& gen)
 
       tree::npv bnv;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
       getpertsuff(pertnode,bnv,oldc,sivold,sivnew);
@@ -2161,7 +2392,7 @@ void brt::pertcv(rn& gen)
       double alpha2=alpha1*exp(lmnew-lmold);
       double alpha = std::min(1.0,alpha2);
 #ifdef _OPENMPI
-      request = new MPI_Request[tc];
+      request = new MPI_Request[nslaves];
 #endif
       if(hardreject) alpha=0.0;  //perturb led to an bottom node with <minperbot observations in it, we reject this.
 
@@ -2169,12 +2400,12 @@ void brt::pertcv(rn& gen)
          mi.pertaccept++;
          pertnode->setc(propc); //because the call to getpertsuff changes it back to oldc to calc the old lil.
 #ifdef _OPENMPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCV_ACCEPT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCV_REJECT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -2187,7 +2418,7 @@ void brt::pertcv(rn& gen)
       delete &sivold;
       delete &sivnew;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    }
@@ -2199,10 +2430,10 @@ bool brt::rot(tree::tree_p tnew, tree& x, rn& gen)
 {
 //   cout << "--------------->>into rot" << endl;
    #ifdef _OPENMPI
-   MPI_Request *request = new MPI_Request[tc];
+   MPI_Request *request = new MPI_Request[nslaves];
    if(rank==0) {
       const int tag=MPI_TAG_ROTATE;
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
       }
    }
@@ -2226,7 +2457,7 @@ bool brt::rot(tree::tree_p tnew, tree& x, rn& gen)
    tnew->getrotnodes(rnodes);
    #ifdef _OPENMPI
    if(rank==0) {
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       mpi_resetrn(gen);
    }
    delete[] request;
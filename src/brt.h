@@ -28,6 +28,7 @@
 #include "tree.h"
 #include "treefuns.h"
 #include "dinfo.h"
+#include <map>
 
 #ifdef _OPENMP
 #   include <omp.h>
@@ -134,26 +135,28 @@ public:
    };
    //--------------------
    //constructors/destructors
-   brt():t(0.0),tp(),xi(0),ci(),di(0),mi(),tc(1),rank(0) {}
+   brt():t(0.0),tp(),xi(0),ci(),di(0),mi(),tc(1),rank(0),nslaves(0),mpirep(false) {}
    //brt(size_t ik):t(vxd::Zero(ik)),tp(),xi(0),ci(),di(0),mi(),tc(1),rank(0) {}
    virtual ~brt() { if(mi.varcount) delete[] mi.varcount; }
    //--------------------
    //methods
-   void settc(int tc) {this->tc = tc;}  // this is numslaves for MPI, or numthreads for OPEN_MP
+   void settc(int tc) {this->tc = tc;}  // numthreads for OPEN_MP, per rank when also using MPI
    void setmpirank(int rank) {this->rank = rank;}  //only needed for MPI
+   void setmpislaves(int nslaves) {this->nslaves = nslaves;}  //only needed for MPI
+   void setmpirep(bool rep) {this->mpirep = rep;}  //MPI: every rank runs draw() and makes the same moves, see mpirep
    void setmpicvrange(int* lwr, int* upr) {this->chv_lwr=lwr; this->chv_upr=upr;} //only needed for MPI
    void setxi(xinfo *xi) {this->xi=xi; this->ncp1=2.0;
                           for(size_t i=0;i<(*xi).size();i++) 
                             if(this->ncp1<(double)((*xi)[i].size()+1.0))
                               this->ncp1=(double)((*xi)[i].size()+1.0);
                          }
-   void setdata(dinfo *di) {this->di=di;resid.resize(di->n);yhat.resize(di->n);setf();setr();}
+   void setdata(dinfo *di) {this->di=di;resid.resize(di->n);yhat.resize(di->n);setoidx();setf();setr();}
    void pr();
    void settp(double alpha, double beta) {tp.alpha=alpha;tp.beta=beta;}
    void setmi(double pbd, double pb, size_t minperbot, bool dopert, double pertalpha, double pchgv, std::vector<std::vector<double> >* chgv)
              {mi.pbd=pbd; mi.pb=pb; mi.minperbot=minperbot; mi.dopert=dopert;
               mi.pertalpha=pertalpha; mi.pchgv=pchgv; mi.corv=chgv; }
-   void setstats(bool dostats) { mi.dostats=dostats; if(dostats) mi.varcount=new unsigned int[xi->size()]; }
+   void setstats(bool dostats) { mi.dostats=dostats; if(dostats) mi.varcount=new unsigned int[xi->size()](); }
    void getstats(unsigned int* vc, double* tad, unsigned int* tmd, unsigned int* tid) { *tad=mi.tavgd; *tmd=mi.tmaxd; *tid=mi.tmind; for(size_t i=0;i<xi->size();i++) vc[i]=mi.varcount[i]; }
    void addstats(unsigned int* vc, double* tad, unsigned int* tmd, unsigned int* tid) { *tad+=mi.tavgd; *tmd=std::max(*tmd,mi.tmaxd); *tid=std::min(*tid,mi.tmind); for(size_t i=0;i<xi->size();i++) vc[i]+=mi.varcount[i]; }
    void resetstats() { mi.tavgd=0.0; mi.tmaxd=0; mi.tmind=0; for(size_t i=0;i<xi->size();i++) mi.varcount[i]=0; }
@@ -177,6 +180,11 @@ public:
 //   void loadtree(size_t nn, int* id, int* v, int* c, double* theta);  //load tree from vector input format
    void loadtree(size_t iter, size_t m, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
                   std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta);
+   void setoidx();  //rebuild the observation index for all of t, needed if t is changed outside of the MCMC moves.
+   //checkpoints: write/read everything the MCMC needs to carry on exactly where it left off
+   //(tree, mcmcinfo counters and step widths, fitted values, residuals and the observation index).
+   virtual void savestate(std::ostream& os);
+   virtual void loadstate(std::istream& is);
    //--------------------
    //data
    tree t;
@@ -187,7 +195,7 @@ public:
    void drawtheta(rn& gen);
    void allsuff(tree::npv& bnv,std::vector<sinfo*>& siv);  //assumes brt.t is the root node
    void subsuff(tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv); //does NOT assume brt.t is the root node.
-                                                                           //Instead, uses the path from nx that it constructs.
+                                                                           //Instead, assumes the path down to nx matches brt.t.
    bool rot(tree::tree_p tnew, tree& x, rn& gen);  //uses subsuff
    void adapt();
 
@@ -203,7 +211,7 @@ public:
    void bd_vec(rn& gen);
 
    //Set the data, the vector of predicted values, and residuals
-   void setdata_mix(dinfo *di) {this->di=di; resid.resize(di->n); yhat.resize(di->n); setf_mix(); setr_mix();}
+   void setdata_mix(dinfo *di) {this->di=di; resid.resize(di->n); yhat.resize(di->n); setoidx(); setf_mix(); setr_mix();}
    void setfi(finfo *fi, size_t k){this->fi = fi; this->k = k; this->t.thetavec.resize(k); this->t.thetavec=vxd::Zero(k);this->nsprior = false;} //sets the pointer for the f matrix and k as members of brt 
    void setk(size_t k){this->k = k; this->t.thetavec.resize(k); this->t.thetavec=vxd::Zero(k);} //sets the number of models for mixing--used in programs that do not need to read in function data (ex: mixingwts.cpp))
    void setfsd(finfo *fsd){this->fisd = fsd; this->nsprior = true;} //sets the function discrepancies 
@@ -236,14 +244,22 @@ protected:
    dinfo *di; //n,p,x,y
    std::vector<double> yhat; //the predicted vector
    std::vector<double> resid; //the actual residual vector
+   std::vector<unsigned int> oidx; //observation index: rows of *di ordered so the rows in any node of t are contiguous
+   std::map<size_t,std::pair<size_t,size_t> > oirng; //node id -> [begin,end) of that node's rows in oidx
    //--------------------
    //mcmc info
    mcmcinfo mi;
-   //thread count
+   //thread count (of each rank when using MPI)
    int tc;
    //slave rank for MPI
    int rank;
-   //vectors of length #slave nodes (tc) describing which variables each node handles when
+   //number of slave ranks for MPI
+   int nslaves;
+   //replicated MPI mode: every rank holds the same tree and an identically seeded generator,
+   //so all ranks draw the same proposals and only the suff stats are exchanged, with one
+   //MPI_Allreduce per proposal.  Rank 0 sends no proposals or accept/reject messages.
+   bool mpirep;
+   //vectors of length #slave nodes (nslaves) describing which variables each node handles when
    //updating mi.corv during an MPI change-of-variable proposal.
    int* chv_lwr;
    int* chv_upr;
@@ -253,6 +269,21 @@ protected:
    //--------------------
    //methods
    virtual void add_observation_to_suff(diterator& diter, sinfo& si); //add in observation i (from di) into si (possibly using ci)
+   //bottom node of t for the current row of diter, and whether that row goes left at the split (v,c).
+   //Both use the binned x (dinfo::xb8/xb16) if the data has one.
+   static tree::tree_p getbn(tree& t, diterator& diter, xinfo& xi) {
+      if(unsigned char* xb=diter.getxb8p()) return t.bn(xb);
+      if(unsigned short* xb=diter.getxb16p()) return t.bn(xb);
+      return t.bn(diter.getxp(),xi);
+   }
+   static bool goesleft(diterator& diter, size_t v, size_t c, xinfo& xi) {
+      if(unsigned char* xb=diter.getxb8p()) return xb[v]<=c;
+      if(unsigned short* xb=diter.getxb16p()) return xb[v]<=c;
+      return diter.getxp()[v] < xi[v][c];
+   }
+   void updoidx(tree::tree_cp nx);  //re-partition the rows of nx over its (changed) subtree, called when a move is accepted
+   void partoidx(tree::tree_cp nx, size_t beg, size_t end);
+   void getoidxrng(tree::tree_cp nx, size_t& beg, size_t& end);
    void getsuff(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir);  //assumes brt.t is the root node
    void getsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir);       //assumes brt.t is the root node
    void getchgvsuff(tree::tree_p pertnode, tree::npv& bnv, size_t oldc, size_t oldv, bool didswap, 
@@ -262,17 +293,29 @@ protected:
    void local_getsuff(diterator& diter, tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir); 
    void local_getsuff(diterator& diter, tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir);
    virtual double lm(sinfo& si); //uses pi. 
+   //lm of the children and parent for a birth at nx on (v,c) or the death of l,r
+   virtual void lmbirth(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir, sinfo& sit, double& lml, double& lmr, double& lmt)
+      { lml=lm(sil); lmr=lm(sir); lmt=lm(sit); }
+   virtual void lmdeath(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir, sinfo& sit, double& lml, double& lmr, double& lmt)
+      { lml=lm(sil); lmr=lm(sir); lmt=lm(sit); }
    virtual double drawnodetheta(sinfo& si, rn& gen);
    void local_allsuff(diterator& diter, tree::npv& bnv,std::vector<sinfo*>& siv);
-   void local_subsuff(diterator& diter, tree::tree_p nx, tree::npv& path, tree::npv& bnv, std::vector<sinfo*>& siv);
+   void local_subsuff(diterator& diter, tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv);
    virtual void local_setf(diterator& diter);
    virtual void local_setr(diterator& diter);
    virtual void local_predict(diterator& diter);
 //#  ifdef _OPENMP
-   void local_ompgetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo& sil, sinfo& sir);
-   void local_ompgetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil, sinfo& sir);
-   void local_ompallsuff(dinfo di, tree::npv bnv,std::vector<sinfo*>& siv);
-   void local_ompsubsuff(dinfo di, tree::tree_p nx, tree::npv& path, tree::npv bnv,std::vector<sinfo*>& siv);
+   void local_ompgetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, std::vector<sinfo*>& tsi);
+   void local_ompgetsuff(tree::tree_p l, tree::tree_p r, dinfo di, std::vector<sinfo*>& tsi);
+   void ompaddsuff(std::vector<sinfo*>& tsi, sinfo& sil, sinfo& sir);
+   void local_ompallsuff(dinfo di, tree::npv bnv,std::vector<sinfo*>& siv, std::vector<std::vector<sinfo*>*>& tsiv);
+   void local_ompsubsuff(dinfo di, tree::tree_p nx, tree::npv bnv,std::vector<sinfo*>& siv, std::vector<std::vector<sinfo*>*>& tsiv);
+   void local_ompaddsuff(std::vector<std::vector<sinfo*>*>& tsiv, std::vector<sinfo*>& siv);
+   //suff stats over the rows this process holds, across the OpenMP team if there is one
+   void rankgetsuff(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir);
+   void rankgetsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir);
+   void rankallsuff(tree::npv& bnv,std::vector<sinfo*>& siv);
+   void ranksubsuff(tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv);
    void local_ompsetf(dinfo di);
    void local_ompsetr(dinfo di);
    void local_omppredict(dinfo dipred);
@@ -287,13 +330,18 @@ protected:
                   std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta);
 //#  endif
 //# ifdef _OPENMPI
-   void local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, dinfo di, sinfo& sil, sinfo& sir);
-   void local_mpigetsuff(tree::tree_p l, tree::tree_p r, dinfo di, sinfo& sil, sinfo& sir);
-   void local_mpiallsuff(diterator& diter, tree::npv& bnv,std::vector<sinfo*>& siv);
+   void local_mpigetsuff(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir);
+   void local_mpigetsuff(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir);
+   void local_mpiallsuff(tree::npv& bnv,std::vector<sinfo*>& siv);
    virtual void local_mpi_reduce_allsuff(std::vector<sinfo*>& siv);
    virtual void local_mpi_sr_suffs(sinfo& sil, sinfo& sir);
    void mpi_resetrn(rn& gen);
-   void local_mpisubsuff(diterator& diter, tree::tree_p nx, tree::npv& path, tree::npv& bnv, std::vector<sinfo*>& siv);
+   void mpi_allreduce_suffs(std::vector<sinfo*>& siv);  //replicated mode: sum siv over all ranks
+   virtual size_t mpi_suffsize() { return 1; }  //number of doubles a packed sinfo takes
+   virtual void local_mpi_packsuff(sinfo& si, double* buf) { buf[0]=(double)si.n; }
+   virtual void local_mpi_unpacksuff(double* buf, sinfo& si) { si.n=(size_t)buf[0]; }
+   int mpislaves() const { return mpirep ? 0 : nslaves; }  //ranks rank 0 sends proposals to
+   void local_mpisubsuff(tree::tree_p nx, tree::npv& bnv, std::vector<sinfo*>& siv);
 
 
    //-------------------------------------------
@@ -318,8 +366,8 @@ protected:
    //void local_ompsubsuff_mix(dinfo di, tree::tree_p nx, tree::npv& path, tree::npv bnv,std::vector<sinfo*>& siv);
    void local_ompsetf_mix(dinfo di);
    void local_ompsetr_mix(dinfo di);
-   void local_omppredict_mix(dinfo dipred, finfo fipred);
-   void local_ompget_mix_wts(dinfo dipred, mxd wts);
+   void local_omppredict_mix(dinfo dipred, finfo& fipred);
+   void local_ompget_mix_wts(dinfo dipred, mxd& wts);
    void local_ompget_mix_theta(dinfo dipred, mxd wts);
 
    //Save and Load tree with vector parameters
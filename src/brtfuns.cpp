@@ -23,6 +23,12 @@
 
 
 #include "brtfuns.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 
 //--------------------------------------------------
 //make xinfo = cutpoints
@@ -38,7 +44,6 @@ void makexinfo(size_t p, size_t n, double *x, xinfo& xi, size_t nc)
    #ifdef _OPENMPI
    int mpirank=0;
    MPI_Comm_rank(MPI_COMM_WORLD,&mpirank);
-   if(mpirank>0) {
    #endif
    for(size_t i=0;i<p;i++) {
       for(size_t j=0;j<n;j++) {
@@ -48,9 +53,8 @@ void makexinfo(size_t p, size_t n, double *x, xinfo& xi, size_t nc)
       }
    }
 
-   //if MPI codepath, aggregate the min/max values across slaves.
+   //if MPI codepath, aggregate the min/max values across the ranks.
    #ifdef _OPENMPI
-   }
    for(size_t i=0;i<p;i++) {
       MPI_Allreduce(MPI_IN_PLACE,&minx[i],1,MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
       MPI_Allreduce(MPI_IN_PLACE,&maxx[i],1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
@@ -66,6 +70,33 @@ void makexinfo(size_t p, size_t n, double *x, xinfo& xi, size_t nc)
       for(size_t j=0;j<nc;j++) xi[i][j] = minx[i] + (j+1)*xinc;
    }
 }
+//--------------------------------------------------
+//make the binned x for di from the cutpoints xi and point di at it.  The ranks go in xb8
+//if every variable has fewer than 256 cutpoints, else in xb16; di is left unbinned if a
+//variable has too many cutpoints or they aren't sorted.
+void makexbin(dinfo& di, xinfo& xi, std::vector<unsigned char>& xb8, std::vector<unsigned short>& xb16)
+{
+   size_t maxnc=0;
+   di.xb8=0; di.xb16=0;
+   if(xi.size()!=di.p) return;
+   for(size_t j=0;j<di.p;j++) {
+      if(!std::is_sorted(xi[j].begin(),xi[j].end())) return;
+      maxnc=std::max(maxnc,xi[j].size());
+   }
+   if(maxnc>USHRT_MAX) return;
+
+   std::vector<double>::iterator u;
+   if(maxnc<=UCHAR_MAX) xb8.resize(di.n*di.p); else xb16.resize(di.n*di.p);
+   for(size_t i=0;i<di.n;i++)
+      for(size_t j=0;j<di.p;j++) {
+         u=std::upper_bound(xi[j].begin(),xi[j].end(),di.x[i*di.p+j]);
+         if(maxnc<=UCHAR_MAX) xb8[i*di.p+j]=(unsigned char)(u-xi[j].begin());
+         else xb16[i*di.p+j]=(unsigned short)(u-xi[j].begin());
+      }
+   if(di.n) {
+      if(maxnc<=UCHAR_MAX) di.xb8=&xb8[0]; else di.xb16=&xb16[0];
+   }
+}
 
 //--------------------------------------------------
 //compute prob of a birth, goodbots will contain all the good bottom nodes
@@ -249,6 +280,28 @@ void updatecormat(tree::tree_p pertnode, xinfo& xi, std::vector<std::vector<doub
    }
 }
 
+void update_norm_cormat(tree::tree_p pertnode, xinfo& xi, std::vector<double>& chgvrow)
+{
+   int Ln,Un; //L,U for the ``new'' variable
+   size_t oldv=pertnode->getv();
+   size_t p=chgvrow.size();
+   double cumsum=0.0;
+
+   for(size_t i=0;i<p;i++) {
+      if(i!=oldv && std::abs(chgvrow[i])>0.0) {
+         if(chgvrow[i]<0.0)  //swap left,right branches
+            pertnode->swaplr();
+         getvarLU(pertnode,i,xi,&Ln,&Un);
+         if(chgvrow[i]<0.0)  //undo the swap
+            pertnode->swaplr();
+         if(Un<Ln) //we can't transition to variable i here according to the tree structure
+            chgvrow[i]=0.0;
+      }
+      cumsum+=std::abs(chgvrow[i]);
+   }
+   for(size_t i=0;i<p;i++)
+      chgvrow[i]/=cumsum;
+}
 void mpi_update_norm_cormat(size_t rank, size_t tc, tree::tree_p pertnode, xinfo& xi, std::vector<double>& chgvrow, int* chv_lwr, int* chv_upr)
 {
 #ifdef _OPENMPI
@@ -1245,4 +1298,60 @@ void array_to_vector(Eigen::VectorXd &V, double *b){
     for(size_t i = 0; i<nrow; i++){
         V(i) = b[i];
     }
-}
\ No newline at end of file
+}
+//--------------------------------------------------
+//checkpoint files
+static const char chkmagic[8]={'O','B','T','C','H','K','0','2'};  //02: ensembles no longer save the m residual vectors
+
+void savechk(const std::string& fname, size_t it, crn& gen, std::vector<brt*>& mods, chkarrays& arrs,
+             std::vector<fitwriter*>& fws)
+{
+   std::ofstream cs(fname + ".tmp",std::ios::binary);
+   std::stringstream gs;
+   gen.get_state(gs);
+   std::string g=gs.str();
+
+   cs.write(chkmagic,8);
+   writebin(cs,(uint64_t)it);
+   writebinvec(cs,std::vector<char>(g.begin(),g.end()));
+   for(size_t j=0;j<mods.size();j++) mods[j]->savestate(cs);
+   for(size_t j=0;j<arrs.size();j++) {
+      writebin(cs,(uint64_t)arrs[j].second);
+      if(arrs[j].second) cs.write((const char*)arrs[j].first,arrs[j].second*sizeof(double));
+   }
+   writebin(cs,(uint64_t)fws.size());
+   for(size_t j=0;j<fws.size();j++) fws[j]->savestate(cs);
+   cs.close();
+
+   if(!cs || std::rename((fname + ".tmp").c_str(),fname.c_str())!=0)
+      cout << "Error: could not write checkpoint " << fname << endl;
+}
+bool loadchk(const std::string& fname, size_t& it, crn& gen, std::vector<brt*>& mods, chkarrays& arrs,
+             std::vector<fitwriter*>& fws, std::vector<std::ofstream*>& ofs, std::vector<std::string>& fitnames)
+{
+   std::ifstream cs(fname,std::ios::binary);
+   char magic[8]={0};
+   uint64_t uit=0,n=0;
+   std::vector<char> g;
+
+   cs.read(magic,8);
+   if(!cs || std::memcmp(magic,chkmagic,8)!=0) return false;
+   readbin(cs,uit);
+   readbinvec(cs,g);
+   std::stringstream gs(std::string(g.begin(),g.end()));
+   gen.set_state(gs);
+   if(!gs) return false;
+   for(size_t j=0;j<mods.size();j++) mods[j]->loadstate(cs);
+   if(!cs) return false;
+   for(size_t j=0;j<arrs.size();j++) {
+      readbin(cs,n);
+      if(!cs || n!=arrs[j].second) return false;
+      if(n) cs.read((char*)arrs[j].first,n*sizeof(double));
+   }
+   readbin(cs,n);
+   if(!cs || n!=fws.size()) return false;
+   for(size_t j=0;j<fws.size();j++)
+      if(!fws[j]->resume(*ofs[j],fitnames[j],cs)) return false;
+   it=(size_t)uit;
+   return true;
+}
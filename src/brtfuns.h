@@ -25,11 +25,14 @@
 #ifndef GUARD_brtfuns_h
 #define GUARD_brtfuns_h
 
+#include <cstdint>
 #include <iostream>
 #include <list>
 #include "tree.h"
 #include "treefuns.h"
 #include "brt.h"
+#include "crn.h"
+#include "fitio.h"
 
 using std::cout;
 using std::endl;
@@ -38,6 +41,9 @@ using std::endl;
 //make xinfo = cutpoints
 void makexinfo(size_t p, size_t n, double *x, xinfo& xi, size_t nc);
 //--------------------------------------------------
+//make the binned x (dinfo::xb8 or xb16) for di from the cutpoints xi, stored in xb8 or xb16
+void makexbin(dinfo& di, xinfo& xi, std::vector<unsigned char>& xb8, std::vector<unsigned short>& xb16);
+//--------------------------------------------------
 //compute prob of a birth, goodbots will contain all the good bottom nodes
 double getpb(tree& t, xinfo& xi, double pipb, tree::npv& goodbots);
 //--------------------------------------------------
@@ -63,6 +69,9 @@ void updatecormat(tree::tree_p pertnode, xinfo& xi, std::vector<std::vector<doub
 // renormalize the correlation matrix so that the probability of row sums to 1.
 void normchgvrow(size_t row, std::vector<std::vector<double> >& chgv);
 //--------------------------------------------------
+// the above 2 combined into 1 call on a copy of row pertnode->getv().
+void update_norm_cormat(tree::tree_p pertnode, xinfo& xi, std::vector<double>& chgvrow);
+//--------------------------------------------------
 // MPI version of the above 2 combined into 1 call.
 void mpi_update_norm_cormat(size_t rank, size_t tc, tree::tree_p pertnode, xinfo& xi, std::vector<double>& chgvrow, int* chv_lwr, int* chv_upr);
 
@@ -143,6 +152,40 @@ void vector_to_array(Eigen::VectorXd &V, double *b);
 void array_to_matrix(Eigen::MatrixXd &M, double *b);
 void array_to_vector(Eigen::VectorXd &V, double *b);
 
+//--------------------------------------------------
+// Functions to support checkpoint files (binary, native byte order)
+//--------------------------------------------------
+template<class T> void writebin(std::ostream& os, const T& x) { os.write((const char*)&x,sizeof(T)); }
+template<class T> void readbin(std::istream& is, T& x) { is.read((char*)&x,sizeof(T)); }
+//vectors are written as their size followed by the elements
+template<class T> void writebinvec(std::ostream& os, const std::vector<T>& v)
+{
+   uint64_t n=v.size();
+   writebin(os,n);
+   if(n) os.write((const char*)&v[0],n*sizeof(T));
+}
+template<class T> void readbinvec(std::istream& is, std::vector<T>& v)
+{
+   uint64_t n=0;
+   readbin(is,n);
+   if(!is) return;
+   v.resize(n);  //no reallocation when the size is unchanged, so pointers into v stay valid
+   if(n) is.read((char*)&v[0],n*sizeof(T));
+}
+//--------------------------------------------------
+//checkpoint files.  Each process writes its own file with the state of its copy of
+//the chain after iteration it: the random number generator, the models (brt::savestate),
+//arrays the driver program keeps (data, residuals, sigmas, ...) and the .fit writers, if
+//the process has any.  The file is written under a temporary name and then renamed, so
+//a crash while writing leaves the previous checkpoint in place.
+typedef std::vector<std::pair<double*,size_t> > chkarrays;
+void savechk(const std::string& fname, size_t it, crn& gen, std::vector<brt*>& mods, chkarrays& arrs,
+             std::vector<fitwriter*>& fws);
+//returns false if the file can't be read or was made for different data.  The writers
+//carry on in the files fitnames, reopened in ofs and cut back to the checkpointed length.
+bool loadchk(const std::string& fname, size_t& it, crn& gen, std::vector<brt*>& mods, chkarrays& arrs,
+             std::vector<fitwriter*>& fws, std::vector<std::ofstream*>& ofs, std::vector<std::string>& fitnames);
+
 //--------------------------------------------------
 //Helper Functions for tree models with vector parameters & model mixing 
 //--------------------------------------------------
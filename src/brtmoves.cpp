@@ -84,16 +84,19 @@ void brt::pertcv(rn& gen)
       size_t oldv=pertnode->getv();
       size_t newv;
 #ifdef _OPENMPI 
-      MPI_Request *request = new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request = new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)mpislaves(); i++) {
          MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCHGV,MPI_COMM_WORLD,&request[i-1]);
       }
       std::vector<double> chgvrow;
       chgvrow=(*mi.corv)[oldv]; 
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 
-      mpi_update_norm_cormat(rank,tc,pertnode,*xi,chgvrow,chv_lwr,chv_upr);
+      if(mpirep)
+         update_norm_cormat(pertnode,*xi,chgvrow);
+      else
+         mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,chgvrow,chv_lwr,chv_upr);
       newv=getchgvfromrow(oldv,chgvrow,gen);
 #else
       std::vector<std::vector<double> > chgv;
@@ -119,22 +122,25 @@ void brt::pertcv(rn& gen)
 #ifdef _OPENMPI
       unsigned int propcint=(unsigned int)newc;
       unsigned int propvint=(unsigned int)newv;
-      request = new MPI_Request[tc];
+      request = new MPI_Request[nslaves];
       char buffer[SIZE_UINT3];
       int position=0;
       MPI_Pack(&propcint,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&propvint,1,MPI_UNSIGNED,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
       MPI_Pack(&didswap,1,MPI_CXX_BOOL,buffer,SIZE_UINT3,&position,MPI_COMM_WORLD);
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)mpislaves(); i++) {
          MPI_Isend(buffer,SIZE_UINT3,MPI_PACKED,i,MPI_TAG_PERTCHGV,MPI_COMM_WORLD,&request[i-1]);
       }
       std::vector<double> chgvrownew;
       chgvrownew=(*mi.corv)[newv];
  
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 
-      mpi_update_norm_cormat(rank,tc,pertnode,*xi,chgvrownew,chv_lwr,chv_upr);
+      if(mpirep)
+         update_norm_cormat(pertnode,*xi,chgvrownew);
+      else
+         mpi_update_norm_cormat(rank,nslaves,pertnode,*xi,chgvrownew,chv_lwr,chv_upr);
       if(chgvrownew[oldv]==0.0)
          cout << "Proposal newv cannot return to oldv!  This is not possible!" << endl;
 
@@ -176,7 +182,7 @@ void brt::pertcv(rn& gen)
       double alpha = std::min(1.0,alpha2);
       if(hardreject) alpha=0.0;  //change of variable led to an bottom node with <minperbot observations in it, we reject this.
 #ifdef _OPENMPI
-      request = new MPI_Request[tc];
+      request = new MPI_Request[nslaves];
 #endif
 
       if(gen.uniform()<alpha) {
@@ -184,13 +190,14 @@ void brt::pertcv(rn& gen)
          if(didswap) pertnode->swaplr();  //because the call to getchgvsuff unswaped if they were swapped
          pertnode->setv(newv); //because the call to getchgvsuff changes it back to oldv to calc the old lil
          pertnode->setc(newc); //because the call to getchgvsuff changes it back to oldc to calc the old lil
+         updoidx(pertnode);
 #ifdef _OPENMPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCHGV_ACCEPT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCHGV_REJECT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -204,7 +211,7 @@ void brt::pertcv(rn& gen)
       delete &sivold;
       delete &sivnew;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    }
@@ -226,11 +233,11 @@ void brt::pertcv(rn& gen)
       pertnode->setc(propc);
 #ifdef _OPENMPI
          unsigned int propcint=(unsigned int)propc;
-         MPI_Request *request = new MPI_Request[tc];
+         MPI_Request *request = new MPI_Request[nslaves];
          char buffer[SIZE_UINT1];
          int position=0;
          MPI_Pack(&propcint,1,MPI_UNSIGNED,buffer,SIZE_UINT1,&position,MPI_COMM_WORLD);
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(buffer,SIZE_UINT1,MPI_PACKED,i,MPI_TAG_PERTCV,MPI_COMM_WORLD,&request[i-1]);
          }
 #endif
@@ -244,7 +251,7 @@ void brt::pertcv(rn& gen)
 
       tree::npv bnv;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
       getpertsuff(pertnode,bnv,oldc,sivold,sivnew);
@@ -268,20 +275,21 @@ void brt::pertcv(rn& gen)
       double alpha2=alpha1*exp(lmnew-lmold);
       double alpha = std::min(1.0,alpha2);
 #ifdef _OPENMPI
-      request = new MPI_Request[tc];
+      request = new MPI_Request[nslaves];
 #endif
       if(hardreject) alpha=0.0;  //perturb led to an bottom node with <minperbot observations in it, we reject this.
 
       if(gen.uniform()<alpha) {
          mi.pertaccept++;
          pertnode->setc(propc); //because the call to getpertsuff changes it back to oldc to calc the old lil.
+         updoidx(pertnode);
 #ifdef _OPENMPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCV_ACCEPT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
       else { //transmit reject over MPI
-         for(size_t i=1; i<=(size_t)tc; i++) {
+         for(size_t i=1; i<=(size_t)mpislaves(); i++) {
             MPI_Isend(NULL,0,MPI_PACKED,i,MPI_TAG_PERTCV_REJECT,MPI_COMM_WORLD,&request[i-1]);
          }
       }
@@ -294,7 +302,7 @@ void brt::pertcv(rn& gen)
       delete &sivold;
       delete &sivnew;
 #ifdef _OPENMPI
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       delete[] request;
 #endif
    }
@@ -306,10 +314,10 @@ bool brt::rot(tree::tree_p tnew, tree& x, rn& gen)
 {
 //   cout << "--------------->>into rot" << endl;
    #ifdef _OPENMPI
-   MPI_Request *request = new MPI_Request[tc];
+   MPI_Request *request = new MPI_Request[nslaves];
    if(rank==0) {
       const int tag=MPI_TAG_ROTATE;
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)mpislaves(); i++) {
          MPI_Isend(NULL,0,MPI_PACKED,i,tag,MPI_COMM_WORLD,&request[i-1]);
       }
    }
@@ -333,7 +341,7 @@ bool brt::rot(tree::tree_p tnew, tree& x, rn& gen)
    tnew->getrotnodes(rnodes);
    #ifdef _OPENMPI
    if(rank==0) {
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(mpislaves(),request,MPI_STATUSES_IGNORE);
       mpi_resetrn(gen);
    }
    delete[] request;
@@ -586,6 +594,7 @@ bool brt::rot(tree::tree_p tnew, tree& x, rn& gen)
    if(gen.uniform()<alpha) {
       mi.rotaccept++;
       x = *tnew;
+      updoidx(x.getptr(rotid/2));  //rows below the parent of the rotated node get rearranged
       return true;
    }
    else {
@@ -34,6 +34,7 @@
 #include <Eigen/StdVector>
 
 #include "crn.h"
+#include "prn.h"
 #include "tree.h"
 #include "brt.h"
 #include "brtfuns.h"
@@ -44,6 +45,7 @@
 #include "tnorm.h"
 #include "mxbrt.h"
 #include "amxbrt.h"
+#include "fitio.h"
 
 using std::cout;
 using std::endl;
@@ -58,9 +60,32 @@ using std::endl;
 #define MODEL_MERCK_TRUNCATED 8
 #define MODEL_MIXBART 9
 
+//--------------------------------------------------
+//replicated MPI mode: the draws for a rank's own rows (latent z's, truncated y's) can't
+//come from the shared generator, which has to stay in step on all ranks.  Start zgen on
+//a stream of this rank keyed off the shared generator instead; every rank draws the key.
+rn& rankrn(prn& zgen, rn& gen, int rank)
+{
+   uint64_t key=(uint64_t)(gen.uniform()*4294967296.0);
+   key=(key<<32) | (uint64_t)(gen.uniform()*4294967296.0);
+   zgen.set_seed(key);
+   zgen.set_stream((uint32_t)rank);
+   return zgen;
+}
+
 int main(int argc, char* argv[])
 {
    std::string folder("");
+   //optional: --checkpoint N saves the state of the chain every N iterations and
+   //--resume carries on from the last checkpoint.  With MPI, --replicated has every
+   //rank make the same moves itself instead of rank 0 sending them to the others and
+   //--threads N has each rank run N OpenMP threads over its rows (hybrid builds).
+   size_t chkevery=0;
+   bool resume=false;
+   bool mpirep=false;
+#ifdef _OPENMPI
+   int ranktc=1;
+#endif
 
    if(argc>1)
    {
@@ -76,15 +101,27 @@ int main(int argc, char* argv[])
       //otherwise argument on the command line is path to conifg file.
       folder=std::string(argv[1]);
       folder=folder+"/";
+
+      for(int a=2;a<argc;a++) {
+         std::string opt(argv[a]);
+         if(opt=="--resume") resume=true;
+         else if(opt=="--checkpoint" && a+1<argc) chkevery=std::stoul(argv[++a]);
+#ifdef _OPENMPI
+         else if(opt=="--replicated") mpirep=true;
+         else if(opt=="--threads" && a+1<argc) ranktc=std::stoi(argv[++a]);
+#endif
+      }
    }
 
 
    //-----------------------------------------------------------
    //random number generation
    crn gen;
-   gen.set_seed(static_cast<long long>(std::chrono::high_resolution_clock::now()
+   long long seed=static_cast<long long>(std::chrono::high_resolution_clock::now()
                                    .time_since_epoch()
-                                   .count()));
+                                   .count());
+   gen.set_seed(seed);
+   prn zgen;  //replicated MPI mode only, see rankrn
 
    //--------------------------------------------------
    //process args
@@ -208,6 +245,11 @@ int main(int argc, char* argv[])
    std::string summarystats_str;
    conf >> summarystats_str;
    if(summarystats_str=="TRUE"){ summarystats = true; }
+
+   //posterior tree file format, binary unless "text" is given (optional)
+   bool fittext = false;
+   std::string fitformat_str;
+   if(conf >> fitformat_str && fitformat_str=="text") fittext = true;
    conf.close();
 
    //folder
@@ -226,9 +268,19 @@ int main(int argc, char* argv[])
 #endif
    if(tc<=1) return 0; //need at least 2 processes!
    if(tc!=mpitc) return 0; //mismatch between how MPI was started and how the data is prepared according to tc.
+   if(mpirep) { //every rank draws the same proposals, so they all start from rank 0's seed
+      MPI_Bcast(&seed,1,MPI_LONG_LONG,0,MPI_COMM_WORLD);
+      gen.set_seed(seed);
+   }
 // #else
 //    if(tc!=1) return 0; //serial mode should have no slave threads!
 #endif
+   //OpenMP threads of the data objects and of the trees.  With MPI, tc is the number
+   //of processes and each rank runs its own team of --threads over its rows.
+   int ditc=tc, brttc=tc-1;
+#ifdef _OPENMPI
+   ditc=brttc=ranktc;
+#endif
 
 
    //--------------------------------------------------
@@ -245,40 +297,30 @@ int main(int argc, char* argv[])
    std::vector<double> y;
    double ytemp;
    size_t n=0;
-#ifdef _OPENMPI
-   if(mpirank>0) { //only load data on slaves
-#endif
-      std::stringstream yfss;
-      std::string yfs;
-      yfss << folder << ycore << mpirank;
-      yfs=yfss.str();
-      std::ifstream yf(yfs);
-      while(yf >> ytemp)
-         y.push_back(ytemp);
-      n=y.size();
+   //with MPI every rank loads its own shard.  Rank 0's may be missing, in which case
+   //it holds no rows and only coordinates the moves.
+   std::stringstream yfss;
+   std::string yfs;
+   yfss << folder << ycore << mpirank;
+   yfs=yfss.str();
+   std::ifstream yf(yfs);
+   while(yf >> ytemp)
+      y.push_back(ytemp);
+   n=y.size();
 #ifndef SILENT
-      cout << "node " << mpirank << " loaded " << n << " from " << yfs <<endl;
-#endif
-#ifdef _OPENMPI
-   }
+   cout << "node " << mpirank << " loaded " << n << " from " << yfs <<endl;
 #endif
 
    //--------------------------------------------------
    //Initialize latent variable z.  Only used in probit, for example.
    std::vector<double> z;
    if(modeltype==MODEL_PROBIT || modeltype==MODEL_MODIFIEDPROBIT)
-#ifdef _OPENMPI
-      if(mpirank>0) { //only need latent z's on slaves
-#endif
-         for(size_t i=0;i<n;i++) {
-            if(y[i]==1.0)
-               z.push_back(2.0);//gen_right_trunc_normal(off,1.0,0.0,gen);//1.0; //std::max(gen.normal(),0.0+off);
-            else 
-               z.push_back(-2.0);//gen_left_trunc_normal(off,1.0,0.0,gen);//-1.0; //std::min(gen.normal(),0.0-off);
-         }
-#ifdef _OPENMPI
+      for(size_t i=0;i<n;i++) {
+         if(y[i]==1.0)
+            z.push_back(2.0);//gen_right_trunc_normal(off,1.0,0.0,gen);//1.0; //std::max(gen.normal(),0.0+off);
+         else 
+            z.push_back(-2.0);//gen_left_trunc_normal(off,1.0,0.0,gen);//-1.0; //std::min(gen.normal(),0.0-off);
       }
-#endif
 
    //--------------------------------------------------
    //Initialize vector of truncated observations.  Only used in merck_truncated model.
@@ -288,25 +330,23 @@ int main(int argc, char* argv[])
    size_t ntruncs=0;
    if(modeltype==MODEL_MERCK_TRUNCATED) {
 #ifdef _OPENMPI
-      if(mpirank>0) { //only need indices on slaves.
-         std::stringstream trfss;
-         std::string tfs;
-         trfss << folder << "truncs" << mpirank;
-         tfs=trfss.str();
-         std::ifstream tf(tfs);
-         while(tf >> trunctemp)
-            truncs.push_back(trunctemp);
-         ntruncs=truncs.size();
-
-         truncvals.resize(ntruncs);
-         for(size_t j=0;j<ntruncs;j++)
-            truncvals[j]=y[truncs[j]];
+      std::stringstream trfss;
+      std::string tfs;
+      trfss << folder << "truncs" << mpirank;
+      tfs=trfss.str();
+      std::ifstream tf(tfs);
+      while(tf >> trunctemp)
+         truncs.push_back(trunctemp);
+      ntruncs=truncs.size();
+
+      truncvals.resize(ntruncs);
+      for(size_t j=0;j<ntruncs;j++)
+         truncvals[j]=y[truncs[j]];
 #ifndef SILENT
-         cout << "node " << mpirank << " loaded " << ntruncs << " from " << tfs << endl;
-         if(ntruncs>0)
-            cout << "node " << mpirank << " first trunc value is " << truncvals[0] << endl;
+      cout << "node " << mpirank << " loaded " << ntruncs << " from " << tfs << endl;
+      if(ntruncs>0)
+         cout << "node " << mpirank << " first trunc value is " << truncvals[0] << endl;
 #endif
-      }
 #endif
    }
 
@@ -315,25 +355,21 @@ int main(int argc, char* argv[])
    std::vector<double> x;
    double xtemp;
    size_t p=0;
-#ifdef _OPENMPI
-   if(mpirank>0) {
-#endif
-      std::stringstream xfss;
-      std::string xfs;
-      xfss << folder << xcore << mpirank;
-      xfs=xfss.str();
-      std::ifstream xf(xfs);
-      while(xf >> xtemp)
-         x.push_back(xtemp);
-      p = x.size()/n;
+   std::stringstream xfss;
+   std::string xfs;
+   xfss << folder << xcore << mpirank;
+   xfs=xfss.str();
+   std::ifstream xf(xfs);
+   while(xf >> xtemp)
+      x.push_back(xtemp);
+   if(n) p = x.size()/n;
 #ifndef SILENT
-      cout << "node " << mpirank << " loaded " << n << " inputs of dimension " << p << " from " << xfs << endl;
+   cout << "node " << mpirank << " loaded " << n << " inputs of dimension " << p << " from " << xfs << endl;
 #endif
 #ifdef _OPENMPI
-   }
    int tempp = (unsigned int) p;
    MPI_Allreduce(MPI_IN_PLACE,&tempp,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
-   if(mpirank>0 && p != ((size_t) tempp)) { cout << "PROBLEM LOADING DATA" << endl; MPI_Finalize(); return 0;}
+   if(n>0 && p != ((size_t) tempp)) { cout << "PROBLEM LOADING DATA" << endl; MPI_Finalize(); return 0;}
    p=(size_t)tempp;
 #endif
 
@@ -344,9 +380,6 @@ int main(int argc, char* argv[])
    size_t k=0;
    finfo fi;
    if(modeltype==MODEL_MIXBART) {
-#ifdef _OPENMPI
-   if(mpirank>0) {
-#endif
       std::stringstream ffss;
       std::string ffs;
       ffss << folder << fcore << mpirank;
@@ -354,19 +387,18 @@ int main(int argc, char* argv[])
       std::ifstream ff(ffs);
       while(ff >> ftemp)
          f.push_back(ftemp);
-      k = f.size()/n;
+      if(n) k = f.size()/n;
       
-      //Make finfo on the slave node
-      makefinfo(k,n,&f[0],fi);
+      //Make finfo on this node
+      makefinfo(k,n,f.data(),fi);
       cout << "node " << mpirank << " loaded " << n << " mixing inputs of dimension " << k << " from " << ffs << endl;
 #ifndef SILENT
       cout << "node " << mpirank << " loaded " << n << " mixing inputs of dimension " << k << " from " << ffs << endl;
 #endif
 #ifdef _OPENMPI
-   }
    int tempk = (unsigned int) k;
    MPI_Allreduce(MPI_IN_PLACE,&tempk,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
-   if(mpirank>0 && k != ((size_t) tempk)) { cout << "PROBLEM LOADING DATA" << endl; MPI_Finalize(); return 0;}
+   if(n>0 && k != ((size_t) tempk)) { cout << "PROBLEM LOADING DATA" << endl; MPI_Finalize(); return 0;}
    k=(size_t)tempk;
 #endif
    }
@@ -378,45 +410,41 @@ int main(int argc, char* argv[])
    finfo fsd; 
    size_t ksd = 0;
    if(modeltype==MODEL_MIXBART && nsprior){   
-   #ifdef _OPENMPI
-      if(mpirank>0) {
-   #endif      
-         /*
-         // Delta
-         std::stringstream fdmfss;
-         std::string fdmfs;
-         fdmfss << folder << fdmcore << mpirank;
-         fdmfs=fdmfss.str();
-         std::ifstream fdmf(fdmfs);
-         while(fdmf >> fdmtemp)
-            fdm.push_back(fdmtemp);
-         kdm = fdm.size()/n;
-
-         //Make finfo on the slave node
-         makefinfo(k,n,&fdm[0],fdeltamean);
-         */
-         std::stringstream fsdfss;
-         std::string fsdfs;
-         fsdfss << folder << fsdcore << mpirank;
-         fsdfs=fsdfss.str();
-         std::ifstream fsdf(fsdfs);
-         while(fsdf >> fsdtemp)
-            fsdvec.push_back(fsdtemp);
-         ksd = fsdvec.size()/n; 
-
-         //Make finfo on the slave node
-         makefinfo(k,n,&fsdvec[0],fsd);
+      /*
+      // Delta
+      std::stringstream fdmfss;
+      std::string fdmfs;
+      fdmfss << folder << fdmcore << mpirank;
+      fdmfs=fdmfss.str();
+      std::ifstream fdmf(fdmfs);
+      while(fdmf >> fdmtemp)
+         fdm.push_back(fdmtemp);
+      kdm = fdm.size()/n;
+
+      //Make finfo on the slave node
+      makefinfo(k,n,&fdm[0],fdeltamean);
+      */
+      std::stringstream fsdfss;
+      std::string fsdfs;
+      fsdfss << folder << fsdcore << mpirank;
+      fsdfs=fsdfss.str();
+      std::ifstream fsdf(fsdfs);
+      while(fsdf >> fsdtemp)
+         fsdvec.push_back(fsdtemp);
+      if(n) ksd = fsdvec.size()/n; 
+
+      //Make finfo on this node
+      makefinfo(k,n,fsdvec.data(),fsd);
    
    #ifndef SILENT
          //cout << "node " << mpirank << " loaded " << n << " inputs of dimension " << kdm << " from " << fdmfs << endl;
          cout << "node " << mpirank << " loaded " << n << " inputs of dimension " << ksd << " from " << fsdfs << endl;
    #endif
    #ifdef _OPENMPI
-      }
       int tempkd = (unsigned int) k;
       MPI_Allreduce(MPI_IN_PLACE,&tempkd,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
       //if(mpirank>0 && kdm != ((size_t) tempkd)) { cout << "PROBLEM LOADING DISCREPANCY DATA" << endl; MPI_Finalize(); return 0;}
-      if(mpirank>0 && ksd != ((size_t) tempkd)) { cout << "PROBLEM LOADING DISCREPANCY DATA" << endl; MPI_Finalize(); return 0;}
+      if(n>0 && ksd != ((size_t) tempkd)) { cout << "PROBLEM LOADING DISCREPANCY DATA" << endl; MPI_Finalize(); return 0;}
    #endif   
    }   
 
@@ -459,53 +487,41 @@ int main(int argc, char* argv[])
    //--------------------------------------------------
    //dinfo
    dinfo di;
-   di.n=0;di.p=p,di.x = NULL;di.y=NULL;di.tc=tc;
-#ifdef _OPENMPI
-   if(mpirank>0) { 
-#endif
+   di.n=0;di.p=p,di.x = NULL;di.y=NULL;di.tc=ditc;
+   if(n>0) { 
       di.n=n; di.x = &x[0]; di.y = &y[0]; 
       if(modeltype==MODEL_PROBIT || modeltype==MODEL_MODIFIEDPROBIT)
          di.y = &z[0];
-#ifdef _OPENMPI
    }
-#endif
 
    //--------------------------------------------------
    //read in sigmav  -- same as above.
    std::vector<double> sigmav;
    double stemp;
    size_t nsig=0;
-#ifdef _OPENMPI
-   if(mpirank>0) { //only load data on slaves
-#endif
-      std::stringstream sfss;
-      std::string sfs;
-      sfss << folder << score << mpirank;
-      sfs=sfss.str();
-      std::ifstream sf(sfs);
-      while(sf >> stemp)
-         sigmav.push_back(stemp);
-      nsig=sigmav.size();
+   std::stringstream sfss;
+   std::string sfs;
+   sfss << folder << score << mpirank;
+   sfs=sfss.str();
+   std::ifstream sf(sfs);
+   while(sf >> stemp)
+      sigmav.push_back(stemp);
+   nsig=sigmav.size();
 #ifndef SILENT
-      cout << "node " << mpirank << " loaded " << nsig << " from " << sfs <<endl;
+   cout << "node " << mpirank << " loaded " << nsig << " from " << sfs <<endl;
 #endif
 #ifdef _OPENMPI
-      if(n!=nsig) { cout << "PROBLEM LOADING SIGMAV" << endl; MPI_Finalize(); return 0; }
-   }
+   if(n!=nsig) { cout << "PROBLEM LOADING SIGMAV" << endl; MPI_Finalize(); return 0; }
 #else
    if(n!=nsig) { cout << "PROBLEM LOADING SIGMAV" << endl; return 0; }
 #endif
 
    double *sig=&sigmav[0];
    dinfo disig;
-   disig.n=0; disig.p=p; disig.x=NULL; disig.y=NULL; disig.tc=tc;
-#ifdef _OPENMPI
-   if(mpirank>0) { 
-#endif
+   disig.n=0; disig.p=p; disig.x=NULL; disig.y=NULL; disig.tc=ditc;
+   if(n>0) { 
       disig.n=n; disig.x=&x[0]; disig.y=sig; 
-#ifdef _OPENMPI
    }
-#endif
 
    //--------------------------------------------------
    // read in the initial change of variable rank correlation matrix
@@ -556,12 +572,12 @@ int main(int argc, char* argv[])
    cout << "n: " << n << endl;
    cout << "p: " << p << endl;
    if(modeltype==MODEL_MIXBART){cout << "k: " << k << endl; }
-   if(mpirank>0) cout << "first row: " << x[0] << ", " << x[p-1] << endl;
-   if(mpirank>0) cout << "second row: " << x[p] << ", " << x[2*p-1] << endl;
-   if(mpirank>0) cout << "last row: " << x[(n-1)*p] << ", " << x[n*p-1] << endl;
-   if(mpirank>0) cout << "first and last y: " << y[0] << ", " << y[n-1] << endl;
-   if(mpirank>0 && modeltype==MODEL_MIXBART){ cout << "first row: " << f[0] << ", " << f[k-1] << endl;}
-   if(mpirank>0 && modeltype==MODEL_MIXBART){ cout << "last row: " << f[(n-1)*k] << ", " << f[n*k-1] << endl;}
+   if(n>0) cout << "first row: " << x[0] << ", " << x[p-1] << endl;
+   if(n>0) cout << "second row: " << x[p] << ", " << x[2*p-1] << endl;
+   if(n>0) cout << "last row: " << x[(n-1)*p] << ", " << x[n*p-1] << endl;
+   if(n>0) cout << "first and last y: " << y[0] << ", " << y[n-1] << endl;
+   if(n>0 && modeltype==MODEL_MIXBART){ cout << "first row: " << f[0] << ", " << f[k-1] << endl;}
+   if(n>0 && modeltype==MODEL_MIXBART){ cout << "last row: " << f[(n-1)*k] << ", " << f[n*k-1] << endl;}
    cout << "number of trees mean: " << m << endl;
    cout << "number of trees stan dev: " << mh << endl;
    if(modeltype==MODEL_MIXBART){cout << "beta0: " << beta0 << endl; }
@@ -577,7 +593,7 @@ int main(int argc, char* argv[])
    cout << "variance tree prior base: " << alphah << endl;
    cout << "variance tree prior power: " << mybetah << endl;
    cout << "thread count: " << tc << endl;
-   if(mpirank>0) cout << "first and last sigmav: " << sigmav[0] << ", " << sigmav[n-1] << endl;
+   if(n>0) cout << "first and last sigmav: " << sigmav[0] << ", " << sigmav[n-1] << endl;
    cout << "chgv first row: " << chgv[0][0] << ", " << chgv[0][p-1] << endl;
    cout << "chgv last row: " << chgv[p-1][0] << ", " << chgv[p-1][p-1] << endl;
    cout << "mean trees prob birth/death: " << pbd << endl;
@@ -624,6 +640,12 @@ int main(int argc, char* argv[])
    }
 #endif
 
+   //binned x used by the tree moves, shared by the data objects built on x
+   std::vector<unsigned char> xb8;
+   std::vector<unsigned short> xb16;
+   makexbin(di,xi,xb8,xb16);
+   disig.xb8=di.xb8; disig.xb16=di.xb16;
+
 //--------------------------------------------------
 //Set up model objects and MCMC
 //--------------------------------------------------
@@ -638,10 +660,12 @@ if(modeltype!=MODEL_MIXBART){
    //data objects
    ambm.setdata(&di);  //set the data
    //thread count
-   ambm.settc(tc-1);      //set the number of slaves when using MPI.
+   ambm.settc(brttc);      //set the number of threads (per rank when using MPI).
    //mpi rank
 #ifdef _OPENMPI
    ambm.setmpirank(mpirank);  //set the rank when using MPI.
+   ambm.setmpislaves(tc-1);  //set the number of slaves when using MPI.
+   ambm.setmpirep(mpirep);  //every rank makes the moves itself, see --replicated
    ambm.setmpicvrange(lwr,upr); //range of variables each slave node will update in MPI change-of-var proposals.
 #endif
    //tree prior
@@ -667,17 +691,14 @@ if(modeltype!=MODEL_MIXBART){
 
    //make di for psbrt object
    dinfo dips;
-   dips.n=0; dips.p=p; dips.x=NULL; dips.y=NULL; dips.tc=tc;
+   dips.n=0; dips.p=p; dips.x=NULL; dips.y=NULL; dips.tc=ditc;
    double *r=NULL;
-#ifdef _OPENMPI
-   if(mpirank>0) {
-#endif
+   if(n>0) {
       r = new double[n];
       for(size_t i=0;i<n;i++) r[i]=sigmav[i];
       dips.x=&x[0]; dips.y=r; dips.n=n;
-#ifdef _OPENMPI
+      dips.xb8=di.xb8; dips.xb16=di.xb16;
    }
-#endif
 
    double opm=1.0/((double)mh);
    double nu=2.0*pow(overallnu,opm)/(pow(overallnu,opm)-pow(overallnu-2.0,opm));
@@ -688,10 +709,12 @@ if(modeltype!=MODEL_MIXBART){
    //data objects
    psbm.setdata(&dips);  //set the data
    //thread count
-   psbm.settc(tc-1); 
+   psbm.settc(brttc);
    //mpi rank
 #ifdef _OPENMPI
    psbm.setmpirank(mpirank);  //set the rank when using MPI.
+   psbm.setmpislaves(tc-1);  //set the number of slaves when using MPI.
+   psbm.setmpirep(mpirep);  //every rank makes the moves itself, see --replicated
    psbm.setmpicvrange(lwr,upr); //range of variables each slave node will update in MPI change-of-var proposals.
 #endif
    //tree prior
@@ -711,16 +734,54 @@ if(modeltype!=MODEL_MIXBART){
 
    //--------------------------------------------------
    //run mcmc
-   std::vector<int> onn(nd*m,1);
-   std::vector<std::vector<int> > oid(nd*m, std::vector<int>(1));
-   std::vector<std::vector<int> > ovar(nd*m, std::vector<int>(1));
-   std::vector<std::vector<int> > oc(nd*m, std::vector<int>(1));
-   std::vector<std::vector<double> > otheta(nd*m, std::vector<double>(1));
-   std::vector<int> snn(nd*mh,1);
-   std::vector<std::vector<int> > sid(nd*mh, std::vector<int>(1));
-   std::vector<std::vector<int> > svar(nd*mh, std::vector<int>(1));
-   std::vector<std::vector<int> > sc(nd*mh, std::vector<int>(1));
-   std::vector<std::vector<double> > stheta(nd*mh, std::vector<double>(1));
+   //each saved draw is appended to the .fit file as soon as it is made, so only
+   //the trees of one draw are held here.
+   std::vector<int> onn(m,1);
+   std::vector<std::vector<int> > oid(m, std::vector<int>(1));
+   std::vector<std::vector<int> > ovar(m, std::vector<int>(1));
+   std::vector<std::vector<int> > oc(m, std::vector<int>(1));
+   std::vector<std::vector<double> > otheta(m, std::vector<double>(1));
+   std::vector<int> snn(mh,1);
+   std::vector<std::vector<int> > sid(mh, std::vector<int>(1));
+   std::vector<std::vector<int> > svar(mh, std::vector<int>(1));
+   std::vector<std::vector<int> > sc(mh, std::vector<int>(1));
+   std::vector<std::vector<double> > stheta(mh, std::vector<double>(1));
+   std::ofstream omf;
+   fitwriter fw;
+   //checkpoint contents
+   std::string chkfile=folder + modelname + ".chk" + std::to_string(mpirank);
+   std::vector<brt*> chkmods={&ambm,&psbm};
+   chkarrays chkarrs={{di.y,di.n},{dips.y,dips.n},{disig.y,disig.n}};
+   for(size_t i=0;i<chgv.size();i++) chkarrs.push_back({&chgv[i][0],chgv[i].size()});
+   std::vector<fitwriter*> chkfws;
+   std::vector<std::ofstream*> chkofs;
+   std::vector<std::string> chkfits;
+   if(mpirank==0) { chkfws.push_back(&fw); chkofs.push_back(&omf); chkfits.push_back(folder + modelname + ".fit"); }
+   size_t it0=0;  //iterations already done, when resuming
+   if(resume) {
+      bool ok=loadchk(chkfile,it0,gen,chkmods,chkarrs,chkfws,chkofs,chkfits);
+#ifdef _OPENMPI
+      //every process has to be able to resume, and from the same iteration
+      unsigned long chk[3]={ok ? 1UL : 0UL, (unsigned long)it0, ~(unsigned long)it0}, chkmin[3];
+      MPI_Allreduce(chk,chkmin,3,MPI_UNSIGNED_LONG,MPI_MIN,MPI_COMM_WORLD);
+      ok=(chkmin[0]==1 && chkmin[1]==~chkmin[2]);
+#endif
+      if(!ok) {
+         if(mpirank==0) cout << "Error: can't resume from checkpoint " << folder + modelname + ".chk" << endl;
+#ifdef _OPENMPI
+         MPI_Finalize();
+#endif
+         return 1;
+      }
+      if(mpirank==0) cout << "Resuming after iteration " << it0 << endl;
+   }
+   else if(mpirank==0) {
+      omf.open(folder + modelname + ".fit",std::ios::binary);
+      fw.begin(omf,nd,m,mh,1);
+   }
+   size_t adapt0=std::min(it0,nadapt);
+   size_t burn0=std::min(it0-adapt0,burn);
+   size_t draw0=it0-adapt0-burn0;
    brtMethodWrapper fambm(&brt::f,ambm);
    brtMethodWrapper fpsbm(&brt::f,psbm);
 
@@ -732,45 +793,49 @@ if(modeltype!=MODEL_MIXBART){
    cout << "Starting MCMC..." << endl;
 #endif
 
-   for(size_t i=0;i<nadapt;i++) { 
+   for(size_t i=adapt0;i<nadapt;i++) { 
       if((i % printevery) ==0 && mpirank==0) cout << "Adapt iteration " << i << endl;
 #ifdef _OPENMPI
-      if(mpirank==0) ambm.draw(gen); else ambm.draw_mpislave(gen);
+      if(mpirank==0 || mpirep) ambm.draw(gen); else ambm.draw_mpislave(gen);
 #else
       ambm.draw(gen);
 #endif
       dips = di;
       dips -= fambm;
-      if((i+1)%adaptevery==0 && mpirank==0) ambm.adapt();
+      if((i+1)%adaptevery==0 && (mpirank==0 || mpirep)) ambm.adapt();
       if(modeltype!=MODEL_PROBIT) {
 #ifdef _OPENMPI
-         if(mpirank==0) psbm.draw(gen); else psbm.draw_mpislave(gen);
+         if(mpirank==0 || mpirep) psbm.draw(gen); else psbm.draw_mpislave(gen);
 #else
          psbm.draw(gen);
 #endif
          disig = fpsbm;
       }
-      if((i+1)%adaptevery==0 && mpirank==0) psbm.adapt();      
+      if((i+1)%adaptevery==0 && (mpirank==0 || mpirep)) psbm.adapt();      
       if(modeltype==MODEL_PROBIT || modeltype==MODEL_MODIFIEDPROBIT) {
+         rn& zg=mpirep ? rankrn(zgen,gen,mpirank) : gen;
          for(size_t j=0;j<n;j++) {
             if(y[j]==1.0)
-               z[j]=std::max(gen.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
+               z[j]=std::max(zg.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
             else
-               z[j]=std::min(gen.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
+               z[j]=std::min(zg.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
          }
       }
       if(modeltype==MODEL_MERCK_TRUNCATED) {
+         rn& zg=mpirep ? rankrn(zgen,gen,mpirank) : gen;
          for(size_t j=0;j<ntruncs;j++) {
-            double u=gen.uniform();
+            double u=zg.uniform();
             double pv=normal_01_cdf((truncvals[j]-fambm.callMethod(truncs[j]))/fpsbm.callMethod(truncs[j]));
             di.y[truncs[j]]=normal_01_cdf_inv(u*pv)*fpsbm.callMethod(truncs[j])+fambm.callMethod(truncs[j]);
          }
       }
+      if(chkevery && (i+1)%chkevery==0)
+         savechk(chkfile,i+1,gen,chkmods,chkarrs,chkfws);
    }
-   for(size_t i=0;i<burn;i++) {
+   for(size_t i=burn0;i<burn;i++) {
       if((i % printevery) ==0 && mpirank==0) cout << "Burn iteration " << i << endl;
 #ifdef _OPENMPI
-      if(mpirank==0) ambm.draw(gen); else ambm.draw_mpislave(gen);
+      if(mpirank==0 || mpirep) ambm.draw(gen); else ambm.draw_mpislave(gen);
 #else
       ambm.draw(gen);
 #endif
@@ -778,36 +843,40 @@ if(modeltype!=MODEL_MIXBART){
       dips -= fambm;      
       if(modeltype!=MODEL_PROBIT) {
 #ifdef _OPENMPI
-         if(mpirank==0) psbm.draw(gen); else psbm.draw_mpislave(gen);
+         if(mpirank==0 || mpirep) psbm.draw(gen); else psbm.draw_mpislave(gen);
 #else
       psbm.draw(gen);
 #endif
         disig = fpsbm;
       }
       if(modeltype==MODEL_PROBIT || modeltype==MODEL_MODIFIEDPROBIT) {
+         rn& zg=mpirep ? rankrn(zgen,gen,mpirank) : gen;
          for(size_t j=0;j<n;j++) {
             if(y[j]==1.0)
-               z[j]=std::max(gen.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
+               z[j]=std::max(zg.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
             else
-               z[j]=std::min(gen.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
+               z[j]=std::min(zg.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
          }
       }
       if(modeltype==MODEL_MERCK_TRUNCATED) {
+         rn& zg=mpirep ? rankrn(zgen,gen,mpirank) : gen;
          for(size_t j=0;j<ntruncs;j++) {
-            double u=gen.uniform();
+            double u=zg.uniform();
             double pv=normal_01_cdf((truncvals[j]-fambm.callMethod(truncs[j]))/fpsbm.callMethod(truncs[j]));
             di.y[truncs[j]]=normal_01_cdf_inv(u*pv)*fpsbm.callMethod(truncs[j])+fambm.callMethod(truncs[j]);
          }
       }
+      if(chkevery && (nadapt+i+1)%chkevery==0)
+         savechk(chkfile,nadapt+i+1,gen,chkmods,chkarrs,chkfws);
    }
-   if(summarystats) {
+   if(summarystats && it0<=nadapt+burn) {  //else the stats were restored from the checkpoint
       ambm.setstats(true);
       psbm.setstats(true);
    }
-   for(size_t i=0;i<nd;i++) {
+   for(size_t i=draw0;i<nd;i++) {
       if((i % printevery) ==0 && mpirank==0) cout << "Draw iteration " << i << endl;
 #ifdef _OPENMPI
-      if(mpirank==0) ambm.draw(gen); else ambm.draw_mpislave(gen);
+      if(mpirank==0 || mpirep) ambm.draw(gen); else ambm.draw_mpislave(gen);
 #else
       ambm.draw(gen);
 #endif
@@ -815,33 +884,39 @@ if(modeltype!=MODEL_MIXBART){
       dips -= fambm;
       if(modeltype!=MODEL_PROBIT) {
 #ifdef _OPENMPI
-         if(mpirank==0) psbm.draw(gen); else psbm.draw_mpislave(gen);
+         if(mpirank==0 || mpirep) psbm.draw(gen); else psbm.draw_mpislave(gen);
 #else
       psbm.draw(gen);
 #endif
          disig = fpsbm;
       }
       if(modeltype==MODEL_PROBIT || modeltype==MODEL_MODIFIEDPROBIT) {
+         rn& zg=mpirep ? rankrn(zgen,gen,mpirank) : gen;
          for(size_t j=0;j<n;j++) {
             if(y[j]==1.0)
-               z[j]=std::max(gen.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
+               z[j]=std::max(zg.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
             else
-               z[j]=std::min(gen.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
+               z[j]=std::min(zg.normal()*fpsbm.callMethod(j)+fambm.callMethod(j)+off,0.0);
          }
       }
       if(modeltype==MODEL_MERCK_TRUNCATED) {
+         rn& zg=mpirep ? rankrn(zgen,gen,mpirank) : gen;
          for(size_t j=0;j<ntruncs;j++) {
-            double u=gen.uniform();
+            double u=zg.uniform();
             double pv=normal_01_cdf((truncvals[j]-fambm.callMethod(truncs[j]))/fpsbm.callMethod(truncs[j]));
             di.y[truncs[j]]=normal_01_cdf_inv(u*pv)*fpsbm.callMethod(truncs[j])+fambm.callMethod(truncs[j]);
          }
       }
 
-      //save tree to vec format
+      //save tree to vec format and append it to the .fit file
       if(mpirank==0) {
-         ambm.savetree(i,m,onn,oid,ovar,oc,otheta);
-         psbm.savetree(i,mh,snn,sid,svar,sc,stheta);
+         ambm.savetree(0,m,onn,oid,ovar,oc,otheta);
+         psbm.savetree(0,mh,snn,sid,svar,sc,stheta);
+         fw.adddraw(0,oid,ovar,oc,otheta,sid,svar,sc,stheta);
+         omf.flush();
       }
+      if(chkevery && (nadapt+burn+i+1)%chkevery==0)
+         savechk(chkfile,nadapt+burn+i+1,gen,chkmods,chkarrs,chkfws);
    }
 #ifdef _OPENMPI
    if(mpirank==0) {
@@ -850,63 +925,12 @@ if(modeltype!=MODEL_MIXBART){
    }
 #endif
 
-   //Flatten posterior trees to a few (very long) vectors so we can just pass pointers
-   //to these vectors back to R (which is much much faster than copying all the data back).
+   //Finish the .fit file.
    if(mpirank==0) {
       cout << "Returning posterior, please wait...";
-      std::vector<int>* e_ots=new std::vector<int>(nd*m);
-      std::vector<int>* e_oid=new std::vector<int>;
-      std::vector<int>* e_ovar=new std::vector<int>;
-      std::vector<int>* e_oc=new std::vector<int>;
-      std::vector<double>* e_otheta=new std::vector<double>;
-      std::vector<int>* e_sts=new std::vector<int>(nd*mh);
-      std::vector<int>* e_sid=new std::vector<int>;
-      std::vector<int>* e_svar=new std::vector<int>;
-      std::vector<int>* e_sc=new std::vector<int>;
-      std::vector<double>* e_stheta=new std::vector<double>;
-      for(size_t i=0;i<nd;i++)
-         for(size_t j=0;j<m;j++) {
-            e_ots->at(i*m+j)=static_cast<int>(oid[i*m+j].size());
-            e_oid->insert(e_oid->end(),oid[i*m+j].begin(),oid[i*m+j].end());
-            e_ovar->insert(e_ovar->end(),ovar[i*m+j].begin(),ovar[i*m+j].end());
-            e_oc->insert(e_oc->end(),oc[i*m+j].begin(),oc[i*m+j].end());
-            e_otheta->insert(e_otheta->end(),otheta[i*m+j].begin(),otheta[i*m+j].end());
-         }
-      for(size_t i=0;i<nd;i++)
-         for(size_t j=0;j<mh;j++) {
-            e_sts->at(i*mh+j)=static_cast<int>(sid[i*mh+j].size());
-            e_sid->insert(e_sid->end(),sid[i*mh+j].begin(),sid[i*mh+j].end());
-            e_svar->insert(e_svar->end(),svar[i*mh+j].begin(),svar[i*mh+j].end());
-            e_sc->insert(e_sc->end(),sc[i*mh+j].begin(),sc[i*mh+j].end());
-            e_stheta->insert(e_stheta->end(),stheta[i*mh+j].begin(),stheta[i*mh+j].end());
-         }
-
-   //write out to file
-      std::ofstream omf(folder + modelname + ".fit");
-      omf << nd << endl;
-      omf << m << endl;
-      omf << mh << endl;
-      omf << e_ots->size() << endl;
-      for(size_t i=0;i<e_ots->size();i++) omf << e_ots->at(i) << endl;
-      omf << e_oid->size() << endl;
-      for(size_t i=0;i<e_oid->size();i++) omf << e_oid->at(i) << endl;
-      omf << e_ovar->size() << endl;
-      for(size_t i=0;i<e_ovar->size();i++) omf << e_ovar->at(i) << endl;
-      omf << e_oc->size() << endl;
-      for(size_t i=0;i<e_oc->size();i++) omf << e_oc->at(i) << endl;
-      omf << e_otheta->size() << endl;
-      for(size_t i=0;i<e_otheta->size();i++) omf << std::scientific << e_otheta->at(i) << endl;
-      omf << e_sts->size() << endl;
-      for(size_t i=0;i<e_sts->size();i++) omf << e_sts->at(i) << endl;
-      omf << e_sid->size() << endl;
-      for(size_t i=0;i<e_sid->size();i++) omf << e_sid->at(i) << endl;
-      omf << e_svar->size() << endl;
-      for(size_t i=0;i<e_svar->size();i++) omf << e_svar->at(i) << endl;
-      omf << e_sc->size() << endl;
-      for(size_t i=0;i<e_sc->size();i++) omf << e_sc->at(i) << endl;
-      omf << e_stheta->size() << endl;
-      for(size_t i=0;i<e_stheta->size();i++) omf << std::scientific << e_stheta->at(i) << endl;
+      fw.end();
       omf.close();
+      if(fittext) fittotext(folder + modelname + ".fit");
 
       cout << " done." << endl;
    }
@@ -947,7 +971,7 @@ if(modeltype!=MODEL_MIXBART){
 #ifdef _OPENMPI
    delete[] lwr;
    delete[] upr;
-   if(mpirank>0) delete[] r;
+   delete[] r;
    MPI_Finalize();
 #else
    delete[] r;
@@ -966,10 +990,12 @@ return 0;
    //data objects
    axb.setdata_mix(&di);  //set the data
    //thread count
-   axb.settc(tc-1);      //set the number of slaves when using MPI.
+   axb.settc(brttc);      //set the number of threads (per rank when using MPI).
    //mpi rank
 #ifdef _OPENMPI
    axb.setmpirank(mpirank);  //set the rank when using MPI.
+   axb.setmpislaves(tc-1);  //set the number of slaves when using MPI.
+   axb.setmpirep(mpirep);  //every rank makes the moves itself, see --replicated
    axb.setmpicvrange(lwr,upr); //range of variables each slave node will update in MPI change-of-var proposals.
 #endif
    //tree prior
@@ -1013,17 +1039,14 @@ return 0;
 
    //make di for psbrt object
    dinfo dips;
-   dips.n=0; dips.p=p; dips.x=NULL; dips.y=NULL; dips.tc=tc;
+   dips.n=0; dips.p=p; dips.x=NULL; dips.y=NULL; dips.tc=ditc;
    double *r=NULL;
-#ifdef _OPENMPI
-   if(mpirank>0) {
-#endif
+   if(n>0) {
       r = new double[n];
       for(size_t i=0;i<n;i++) r[i]=sigmav[i];
       dips.x=&x[0]; dips.y=r; dips.n=n;
-#ifdef _OPENMPI
+      dips.xb8=di.xb8; dips.xb16=di.xb16;
    }
-#endif
 
    double opm=1.0/((double)mh);
    double nu=2.0*pow(overallnu,opm)/(pow(overallnu,opm)-pow(overallnu-2.0,opm));
@@ -1034,10 +1057,12 @@ return 0;
    //data objects
    psbm.setdata(&dips);  //set the data
    //thread count
-   psbm.settc(tc-1); 
+   psbm.settc(brttc);
    //mpi rank
 #ifdef _OPENMPI
    psbm.setmpirank(mpirank);  //set the rank when using MPI.
+   psbm.setmpislaves(tc-1);  //set the number of slaves when using MPI.
+   psbm.setmpirep(mpirep);  //every rank makes the moves itself, see --replicated
    psbm.setmpicvrange(lwr,upr); //range of variables each slave node will update in MPI change-of-var proposals.
 #endif
    //tree prior
@@ -1058,18 +1083,56 @@ return 0;
 
    //--------------------------------------------------
    //run mcmc
-   std::vector<int> onn(nd*m,1);
-   std::vector<std::vector<int> > oid(nd*m, std::vector<int>(1));
-   std::vector<std::vector<int> > ovar(nd*m, std::vector<int>(1));
-   std::vector<std::vector<int> > oc(nd*m, std::vector<int>(1));
-   std::vector<std::vector<double> > otheta(nd*m, std::vector<double>(1));
+   //each saved draw is appended to the .fit file as soon as it is made, so only
+   //the trees of one draw are held here.
+   std::vector<int> onn(m,1);
+   std::vector<std::vector<int> > oid(m, std::vector<int>(1));
+   std::vector<std::vector<int> > ovar(m, std::vector<int>(1));
+   std::vector<std::vector<int> > oc(m, std::vector<int>(1));
+   std::vector<std::vector<double> > otheta(m, std::vector<double>(1));
    //std::vector<double> osig(nd,1);
 
-   std::vector<int> snn(nd*mh,1);
-   std::vector<std::vector<int> > sid(nd*mh, std::vector<int>(1));
-   std::vector<std::vector<int> > svar(nd*mh, std::vector<int>(1));
-   std::vector<std::vector<int> > sc(nd*mh, std::vector<int>(1));
-   std::vector<std::vector<double> > stheta(nd*mh, std::vector<double>(1));
+   std::vector<int> snn(mh,1);
+   std::vector<std::vector<int> > sid(mh, std::vector<int>(1));
+   std::vector<std::vector<int> > svar(mh, std::vector<int>(1));
+   std::vector<std::vector<int> > sc(mh, std::vector<int>(1));
+   std::vector<std::vector<double> > stheta(mh, std::vector<double>(1));
+   std::ofstream omf;
+   fitwriter fw;
+   //checkpoint contents
+   std::string chkfile=folder + modelname + ".chk" + std::to_string(mpirank);
+   std::vector<brt*> chkmods={&axb,&psbm};
+   chkarrays chkarrs={{di.y,di.n},{dips.y,dips.n},{disig.y,disig.n}};
+   for(size_t i=0;i<chgv.size();i++) chkarrs.push_back({&chgv[i][0],chgv[i].size()});
+   std::vector<fitwriter*> chkfws;
+   std::vector<std::ofstream*> chkofs;
+   std::vector<std::string> chkfits;
+   if(mpirank==0) { chkfws.push_back(&fw); chkofs.push_back(&omf); chkfits.push_back(folder + modelname + ".fit"); }
+   size_t it0=0;  //iterations already done, when resuming
+   if(resume) {
+      bool ok=loadchk(chkfile,it0,gen,chkmods,chkarrs,chkfws,chkofs,chkfits);
+#ifdef _OPENMPI
+      //every process has to be able to resume, and from the same iteration
+      unsigned long chk[3]={ok ? 1UL : 0UL, (unsigned long)it0, ~(unsigned long)it0}, chkmin[3];
+      MPI_Allreduce(chk,chkmin,3,MPI_UNSIGNED_LONG,MPI_MIN,MPI_COMM_WORLD);
+      ok=(chkmin[0]==1 && chkmin[1]==~chkmin[2]);
+#endif
+      if(!ok) {
+         if(mpirank==0) cout << "Error: can't resume from checkpoint " << folder + modelname + ".chk" << endl;
+#ifdef _OPENMPI
+         MPI_Finalize();
+#endif
+         return 1;
+      }
+      if(mpirank==0) cout << "Resuming after iteration " << it0 << endl;
+   }
+   else if(mpirank==0) {
+      omf.open(folder + modelname + ".fit",std::ios::binary);
+      fw.begin(omf,nd,m,mh,k);
+   }
+   size_t adapt0=std::min(it0,nadapt);
+   size_t burn0=std::min(it0-adapt0,burn);
+   size_t draw0=it0-adapt0-burn0;
 
    brtMethodWrapper faxb(&brt::f,axb);
    brtMethodWrapper fpsbm(&brt::f,psbm);
@@ -1082,10 +1145,10 @@ return 0;
    cout << "Starting MCMC..." << endl;
 #endif
 
-   for(size_t i=0;i<nadapt;i++) { 
+   for(size_t i=adapt0;i<nadapt;i++) { 
       if((i % printevery) ==0 && mpirank==0) cout << "Adapt iteration " << i << endl;
 #ifdef _OPENMPI
-      if(mpirank==0){axb.drawvec(gen);} else {axb.drawvec_mpislave(gen);}
+      if(mpirank==0 || mpirep){axb.drawvec(gen);} else {axb.drawvec_mpislave(gen);}
 #else
       axb.drawvec(gen);
 #endif
@@ -1093,14 +1156,16 @@ return 0;
       // Update the which are fed into resiudals the variance model
       dips = di;
       dips -= faxb;
-      if((i+1)%adaptevery==0 && mpirank==0) axb.adapt();
+      if((i+1)%adaptevery==0 && (mpirank==0 || mpirep)) axb.adapt();
 #ifdef _OPENMPI
-      if(mpirank==0) psbm.draw(gen); else psbm.draw_mpislave(gen);
+      if(mpirank==0 || mpirep) psbm.draw(gen); else psbm.draw_mpislave(gen);
 #else
       psbm.draw(gen);
 #endif
       disig = fpsbm;
-      if((i+1)%adaptevery==0 && mpirank==0) psbm.adapt();
+      if((i+1)%adaptevery==0 && (mpirank==0 || mpirep)) psbm.adapt();
+      if(chkevery && (i+1)%chkevery==0)
+         savechk(chkfile,i+1,gen,chkmods,chkarrs,chkfws);
 /*
 #ifdef _OPENMPI
       axb.drawsigma(gen); 
@@ -1112,10 +1177,10 @@ return 0;
    }
 
    // Enter the burn-in stage    
-   for(size_t i=0;i<burn;i++) {
+   for(size_t i=burn0;i<burn;i++) {
       if((i % printevery) ==0 && mpirank==0) cout << "Burn iteration " << i << endl;
 #ifdef _OPENMPI
-      if(mpirank==0){ axb.drawvec(gen);}else {axb.drawvec_mpislave(gen);}
+      if(mpirank==0 || mpirep){ axb.drawvec(gen);}else {axb.drawvec_mpislave(gen);}
 #else
       axb.drawvec(gen);
 #endif
@@ -1125,11 +1190,13 @@ return 0;
 
       // Draw sigma
 #ifdef _OPENMPI
-      if(mpirank==0) psbm.draw(gen); else psbm.draw_mpislave(gen);
+      if(mpirank==0 || mpirep) psbm.draw(gen); else psbm.draw_mpislave(gen);
 #else
       psbm.draw(gen);
 #endif
       disig = fpsbm;
+      if(chkevery && (nadapt+i+1)%chkevery==0)
+         savechk(chkfile,nadapt+i+1,gen,chkmods,chkarrs,chkfws);
        
 /*
 #ifdef _OPENMPI
@@ -1139,21 +1206,21 @@ return 0;
 #endif
 */
    }
-   if(summarystats) {
+   if(summarystats && it0<=nadapt+burn) {  //else the stats were restored from the checkpoint
       axb.setstats(true);
       psbm.setstats(true);
    }
-   for(size_t i=0;i<nd;i++) {
+   for(size_t i=draw0;i<nd;i++) {
       if((i % printevery) ==0 && mpirank==0) cout << "Draw iteration " << i << endl;
 #ifdef _OPENMPI
-      if(mpirank==0){axb.drawvec(gen); }else{ axb.drawvec_mpislave(gen);}
+      if(mpirank==0 || mpirep){axb.drawvec(gen); }else{ axb.drawvec_mpislave(gen);}
 #else
       axb.drawvec(gen);
 #endif
       dips = di;
       dips -= faxb;
 #ifdef _OPENMPI
-      if(mpirank==0) psbm.draw(gen); else psbm.draw_mpislave(gen);
+      if(mpirank==0 || mpirep) psbm.draw(gen); else psbm.draw_mpislave(gen);
 #else
       psbm.draw(gen);
 #endif
@@ -1168,11 +1235,15 @@ return 0;
       axb.drawsigma(gen);
 #endif
 */
-   //save tree to vec format
+   //save tree to vec format and append it to the .fit file
    if(mpirank==0) {
-      axb.savetree_vec(i,m,onn,oid,ovar,oc,otheta); 
-      psbm.savetree(i,mh,snn,sid,svar,sc,stheta); 
+      axb.savetree_vec(0,m,onn,oid,ovar,oc,otheta); 
+      psbm.savetree(0,mh,snn,sid,svar,sc,stheta); 
+      fw.adddraw(0,oid,ovar,oc,otheta,sid,svar,sc,stheta);
+      omf.flush();
    }
+   if(chkevery && (nadapt+burn+i+1)%chkevery==0)
+      savechk(chkfile,nadapt+burn+i+1,gen,chkmods,chkarrs,chkfws);
 
    //save variance to vector form -- remove later
    /*
@@ -1190,64 +1261,12 @@ return 0;
    }
 #endif
 
-   //Flatten posterior trees to a few (very long) vectors so we can just pass pointers
-   //to these vectors back to R (which is much much faster than copying all the data back).
+   //Finish the .fit file.
    if(mpirank==0) {
       cout << "Returning posterior, please wait...";
-      std::vector<int>* e_ots=new std::vector<int>(nd*m);
-      std::vector<int>* e_oid=new std::vector<int>;
-      std::vector<int>* e_ovar=new std::vector<int>;
-      std::vector<int>* e_oc=new std::vector<int>;
-      std::vector<double>* e_otheta=new std::vector<double>;
-      std::vector<int>* e_sts=new std::vector<int>(nd*mh);
-      std::vector<int>* e_sid=new std::vector<int>;
-      std::vector<int>* e_svar=new std::vector<int>;
-      std::vector<int>* e_sc=new std::vector<int>;
-      std::vector<double>* e_stheta=new std::vector<double>;
-      for(size_t i=0;i<nd;i++)
-         for(size_t j=0;j<m;j++) {
-            e_ots->at(i*m+j)=static_cast<int>(oid[i*m+j].size());
-            e_oid->insert(e_oid->end(),oid[i*m+j].begin(),oid[i*m+j].end());
-            e_ovar->insert(e_ovar->end(),ovar[i*m+j].begin(),ovar[i*m+j].end());
-            e_oc->insert(e_oc->end(),oc[i*m+j].begin(),oc[i*m+j].end());
-            e_otheta->insert(e_otheta->end(),otheta[i*m+j].begin(),otheta[i*m+j].end());
-         }
-      for(size_t i=0;i<nd;i++)
-         for(size_t j=0;j<mh;j++) {
-            e_sts->at(i*mh+j)=static_cast<int>(sid[i*mh+j].size());
-            e_sid->insert(e_sid->end(),sid[i*mh+j].begin(),sid[i*mh+j].end());
-            e_svar->insert(e_svar->end(),svar[i*mh+j].begin(),svar[i*mh+j].end());
-            e_sc->insert(e_sc->end(),sc[i*mh+j].begin(),sc[i*mh+j].end());
-            e_stheta->insert(e_stheta->end(),stheta[i*mh+j].begin(),stheta[i*mh+j].end());
-         }
-      //write out to file
-      std::ofstream omf(folder + modelname + ".fit");
-      omf << nd << endl;
-      omf << m << endl;
-      omf << mh << endl;
-      omf << e_ots->size() << endl;
-      for(size_t i=0;i<e_ots->size();i++) omf << e_ots->at(i) << endl;
-      omf << e_oid->size() << endl;
-      for(size_t i=0;i<e_oid->size();i++) omf << e_oid->at(i) << endl;
-      omf << e_ovar->size() << endl;
-      for(size_t i=0;i<e_ovar->size();i++) omf << e_ovar->at(i) << endl;
-      omf << e_oc->size() << endl;
-      for(size_t i=0;i<e_oc->size();i++) omf << e_oc->at(i) << endl;
-      omf << e_otheta->size() << endl;
-      for(size_t i=0;i<e_otheta->size();i++) omf << std::scientific << e_otheta->at(i) << endl;
-      
-      omf << e_sts->size() << endl;
-      for(size_t i=0;i<e_sts->size();i++) omf << e_sts->at(i) << endl;
-      omf << e_sid->size() << endl;
-      for(size_t i=0;i<e_sid->size();i++) omf << e_sid->at(i) << endl;
-      omf << e_svar->size() << endl;
-      for(size_t i=0;i<e_svar->size();i++) omf << e_svar->at(i) << endl;
-      omf << e_sc->size() << endl;
-      for(size_t i=0;i<e_sc->size();i++) omf << e_sc->at(i) << endl;
-      omf << e_stheta->size() << endl;
-      for(size_t i=0;i<e_stheta->size();i++) omf << std::scientific << e_stheta->at(i) << endl;
-      
+      fw.end();
       omf.close();
+      if(fittext) fittotext(folder + modelname + ".fit");
 
       //Write standard deviation -- sigma -- files
       /*
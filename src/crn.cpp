@@ -23,6 +23,7 @@
 
 
 #include "crn.h"
+#include <limits>
 
 //--------------------------------------------------
 crn::crn():df(0),alpha(0.5),beta(0.5),gen(0),nor(0),uni(0),chi(0),gam(0)
@@ -70,4 +71,25 @@ void crn::set_engine_state(std::stringstream& state)
 {
    state >> (*gen);
 }
+//the distributions are saved too: normal keeps the second value of each
+//pair it generates, and gamma has a normal of its own.
+void crn::get_state(std::ostream& os)
+{
+   std::streamsize prec=os.precision(std::numeric_limits<double>::max_digits10);
+   os << df << " " << alpha << " " << beta << " " << (chi ? 1 : 0) << " ";
+   os << *gen << " " << *nor << " " << *uni << " " << *gam;
+   if(chi) os << " " << *chi;
+   os.precision(prec);
+}
+void crn::set_state(std::istream& is)
+{
+   int havechi=0;
+   is >> df >> alpha >> beta >> havechi;
+   is >> std::ws >> *gen;  //the engine doesn't skip leading white space itself
+   is >> *nor >> *uni >> *gam;
+   if(havechi) {
+      if(!chi) chi = new chiD;
+      is >> *chi;
+   }
+}
 
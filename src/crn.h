@@ -53,6 +53,9 @@ public:
    void set_gam(double alpha,double beta);
    std::default_random_engine get_engine_state();
    void set_engine_state(std::stringstream& state);
+   //engine and distribution states (text), so a checkpointed run can continue exactly
+   void get_state(std::ostream& os);
+   void set_state(std::istream& is);
 private:
    int df;
    double alpha,beta;
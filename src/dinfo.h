@@ -44,15 +44,21 @@ public:
 
 class dinfo {
 public:
-   dinfo() {p=0;n=0;x=0;y=0;tc=1;}
-   dinfo(const dinfo& d) : p(d.p),n(d.n),x(d.x),y(d.y),tc(d.tc) {}
-   dinfo(size_t ip, size_t in, double *ix, double *iy) : p(ip), n(in), x(ix), y(iy), tc(1) {}
-   dinfo(size_t ip, size_t in, double *ix, double *iy,int itc) : p(ip), n(in), x(ix), y(iy), tc(itc) {}
+   dinfo() {p=0;n=0;x=0;y=0;tc=1;xb8=0;xb16=0;}
+   dinfo(const dinfo& d) : p(d.p),n(d.n),x(d.x),y(d.y),tc(d.tc),xb8(d.xb8),xb16(d.xb16) {}
+   dinfo(size_t ip, size_t in, double *ix, double *iy) : p(ip), n(in), x(ix), y(iy), tc(1), xb8(0), xb16(0) {}
+   dinfo(size_t ip, size_t in, double *ix, double *iy,int itc) : p(ip), n(in), x(ix), y(iy), tc(itc), xb8(0), xb16(0) {}
    size_t p;  //number of vars
    size_t n;  //number of observations
    double *x; // jth var of ith obs is *(x + p*i+j)
    double *y; // ith y is *(y+i) or y[i]
    int tc; //thread count
+   //optional binned x, laid out like x: the rank of x among the cutpoints of its variable,
+   //i.e. the number of cutpoints <= x, so x[v] < xi[v][c] exactly when the rank is <= c.
+   //One byte per value if every variable has fewer than 256 cutpoints, else two.
+   //At most one of these is set, see makexbin().
+   unsigned char *xb8;
+   unsigned short *xb16;
 
    // compound addition operator
    dinfo& operator+=(const dinfo& rhs) {
@@ -225,6 +231,8 @@ public:
         this->n = rhs.n;
         this->p = rhs.p;
         this->x = rhs.x;
+        this->xb8 = rhs.xb8;
+        this->xb16 = rhs.xb16;
         #ifdef _OPENMP
         #pragma omp parallel for num_threads(tc)
         #endif
@@ -269,23 +277,34 @@ public:
 };
 
 // a dinfo iterator, of sorts.
+// Optionally walks the rows listed in an index array (eg brt's observation index)
+// instead of the rows first..last-1 directly, in which case first,last are positions in ix.
 class diterator : public std::iterator<std::input_iterator_tag, size_t>
 {
 	size_t i, end;
 	dinfo di;
+	unsigned int* ix;
 public:
-  diterator(dinfo* d) : i(0),end((*d).n),di(*d) {}  //copy of d, helps OPENMP speed apparently.
-  diterator(const diterator& dit) : i(dit.i),end(dit.end),di(dit.di) {}
-  diterator(dinfo* d, size_t first, size_t last) : i(first),end(last),di(*d) {}
+  diterator(dinfo* d) : i(0),end((*d).n),di(*d),ix(0) {}  //copy of d, helps OPENMP speed apparently.
+  diterator(const diterator& dit) : i(dit.i),end(dit.end),di(dit.di),ix(dit.ix) {}
+  diterator(const diterator& dit, size_t first, size_t last) : i(first),end(last),di(dit.di),ix(dit.ix) {}
+  diterator(dinfo* d, size_t first, size_t last) : i(first),end(last),di(*d),ix(0) {}
+  diterator(dinfo* d, unsigned int* ix, size_t first, size_t last) : i(first),end(last),di(*d),ix(ix) {}
   diterator& operator++() {++i;return *this;}
   diterator operator++(int) {diterator tmp(*this); operator++(); return tmp;}
-  double* getxp() { return di.x+i*di.p; }
+  size_t row() { return ix ? (size_t)ix[i] : i; }
+  double* getxp() { return di.x+row()*di.p; }
+  unsigned char* getxb8p() { return di.xb8 ? di.xb8+row()*di.p : 0; }
+  unsigned short* getxb16p() { return di.xb16 ? di.xb16+row()*di.p : 0; }
   double getx() { return *(getxp()); }
-  double* getyp() { return di.y+i; }
+  double* getyp() { return di.y+row(); }
   double gety() { return *(getyp()); }
-  void sety(double val) { di.y[i]=val; }
-  size_t geti(){return i;} //added to allow easy reference for the row vectors of f in model mixing
+  void sety(double val) { di.y[row()]=val; }
+  size_t geti(){return row();} //added to allow easy reference for the row vectors of f in model mixing
+  size_t getpos() { return i; }
   size_t until() { return end; }
+  bool indexed() { return ix!=0; }
+  dinfo& getdi() { return di; }  //the rows are getpos() to until()-1 of this if !indexed()
   bool operator==(const diterator& rhs) { return i==rhs.i; }
   bool operator==(size_t last) { return i==last; }
   bool operator!=(const diterator& rhs) { return i!=rhs.i; }
@@ -296,7 +315,7 @@ public:
   bool operator<(size_t last) { return i<last; }
   bool operator>(const diterator& rhs) { return i>rhs.i; }
   bool operator>(size_t last) { return i>last; }
-  size_t operator*() { return i; }
+  size_t operator*() { return row(); }
 };
 
 #endif
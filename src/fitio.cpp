@@ -0,0 +1,395 @@
+//     fitio.cpp: Reading and writing of saved posterior tree draws (.fit files).
+//     Copyright (C) 2012-2018 Matthew T. Pratola
+//
+//     This file is part of OpenBT.
+//
+//     OpenBT is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Affero General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     OpenBT is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public License
+//     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//     Author contact information
+//     Matthew T. Pratola: mpratola@gmail.com
+
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fitio.h"
+
+using std::cout;
+using std::endl;
+
+static const char fitmagic[8]={'O','B','T','F','I','T','0','1'};
+//the tree vectors are int and are copied straight into the int32 arrays
+static_assert(sizeof(int)==sizeof(int32_t),"fitio assumes 32 bit int");
+
+//--------------------------------------------------
+//append n bytes to a buffer
+static void putbytes(std::vector<char>& buf, const void* src, size_t n)
+{
+   const char* s=static_cast<const char*>(src);
+   buf.insert(buf.end(),s,s+n);
+}
+static void pad8(std::vector<char>& buf)
+{
+   while(buf.size()%8) buf.push_back(0);
+}
+static size_t roundup8(size_t n)
+{
+   return (n+7)/8*8;
+}
+
+//--------------------------------------------------
+//fitwriter
+//--------------------------------------------------
+void fitwriter::begin(std::ostream& ios, size_t nd, size_t m, size_t mh, size_t k)
+{
+   os=&ios;
+   bstart=os->tellp();
+   std::memcpy(hd.magic,fitmagic,8);
+   hd.nd=nd; hd.m=m; hd.mh=mh; hd.k=k;
+   hd.ndraw=0; hd.dtab=0; hd.bsize=0;
+   os->write(reinterpret_cast<const char*>(&hd),sizeof(fithead));
+   doff.clear();
+   doff.reserve(nd);
+}
+//--------------------------------------------------
+void fitwriter::addens(size_t iter, size_t ntree, size_t k, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+               std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta)
+{
+   size_t indx=iter*ntree;
+   int32_t off=0;
+   putbytes(buf,&off,sizeof(int32_t));
+   for(size_t j=0;j<ntree;j++) {
+      off+=(int32_t)id[indx+j].size();
+      putbytes(buf,&off,sizeof(int32_t));
+   }
+   for(size_t j=0;j<ntree;j++) putbytes(buf,id[indx+j].data(),id[indx+j].size()*sizeof(int32_t));
+   for(size_t j=0;j<ntree;j++) putbytes(buf,v[indx+j].data(),v[indx+j].size()*sizeof(int32_t));
+   for(size_t j=0;j<ntree;j++) putbytes(buf,c[indx+j].data(),c[indx+j].size()*sizeof(int32_t));
+   pad8(buf);
+   for(size_t j=0;j<ntree;j++) putbytes(buf,theta[indx+j].data(),id[indx+j].size()*k*sizeof(double));
+}
+//--------------------------------------------------
+void fitwriter::adddraw(size_t iter, std::vector<std::vector<int> >& oid, std::vector<std::vector<int> >& ov,
+                std::vector<std::vector<int> >& oc, std::vector<std::vector<double> >& otheta,
+                std::vector<std::vector<int> >& sid, std::vector<std::vector<int> >& sv,
+                std::vector<std::vector<int> >& sc, std::vector<std::vector<double> >& stheta)
+{
+   uint64_t nbytes=0;
+   buf.clear();
+   putbytes(buf,&nbytes,sizeof(uint64_t));
+   addens(iter,hd.m,hd.k,oid,ov,oc,otheta);
+   addens(iter,hd.mh,1,sid,sv,sc,stheta);
+   pad8(buf);
+   nbytes=buf.size();
+   std::memcpy(&buf[0],&nbytes,sizeof(uint64_t));
+
+   doff.push_back((uint64_t)(os->tellp()-bstart));
+   os->write(&buf[0],buf.size());
+   hd.ndraw++;
+}
+//--------------------------------------------------
+void fitwriter::end()
+{
+   hd.dtab=(uint64_t)(os->tellp()-bstart);
+   if(doff.size()) os->write(reinterpret_cast<const char*>(&doff[0]),doff.size()*sizeof(uint64_t));
+   std::streamoff bend=os->tellp();
+   hd.bsize=(uint64_t)(bend-bstart);
+   os->seekp(bstart);
+   os->write(reinterpret_cast<const char*>(&hd),sizeof(fithead));
+   os->seekp(bend);
+   os->flush();
+}
+//--------------------------------------------------
+void fitwriter::savestate(std::ostream& cs)
+{
+   uint64_t pos=(uint64_t)os->tellp(), b=(uint64_t)bstart, nd=doff.size();
+   cs.write(reinterpret_cast<const char*>(&pos),sizeof(uint64_t));
+   cs.write(reinterpret_cast<const char*>(&b),sizeof(uint64_t));
+   cs.write(reinterpret_cast<const char*>(&hd),sizeof(fithead));
+   cs.write(reinterpret_cast<const char*>(&nd),sizeof(uint64_t));
+   if(nd) cs.write(reinterpret_cast<const char*>(&doff[0]),nd*sizeof(uint64_t));
+}
+bool fitwriter::resume(std::ofstream& ofs, const std::string& fname, std::istream& cs)
+{
+   uint64_t pos=0, b=0, nd=0;
+   cs.read(reinterpret_cast<char*>(&pos),sizeof(uint64_t));
+   cs.read(reinterpret_cast<char*>(&b),sizeof(uint64_t));
+   cs.read(reinterpret_cast<char*>(&hd),sizeof(fithead));
+   cs.read(reinterpret_cast<char*>(&nd),sizeof(uint64_t));
+   if(!cs || std::memcmp(hd.magic,fitmagic,8)!=0) return false;
+   doff.resize(nd);
+   if(nd) cs.read(reinterpret_cast<char*>(&doff[0]),nd*sizeof(uint64_t));
+   if(!cs) return false;
+
+   if(::truncate(fname.c_str(),(off_t)pos)!=0) {
+      cout << "Error: can't truncate " << fname << endl;
+      return false;
+   }
+   ofs.open(fname,std::ios::in|std::ios::out|std::ios::binary);
+   if(!ofs) return false;
+   ofs.seekp((std::streamoff)pos);
+   os=&ofs;
+   bstart=(std::streamoff)b;
+   doff.reserve(hd.nd);
+   return true;
+}
+
+//--------------------------------------------------
+//fitfile
+//--------------------------------------------------
+bool fitfile::open(const std::string& fname)
+{
+   close();
+   char magic[8]={0};
+   std::ifstream is(fname,std::ios::binary);
+   if(!is) { cout << "Error: can't open " << fname << endl; return false; }
+   is.read(magic,8);
+   if(is.gcount()==8 && std::memcmp(magic,fitmagic,8)==0) {
+      is.close();
+      int fd=::open(fname.c_str(),O_RDONLY);
+      struct stat st;
+      if(fd<0 || fstat(fd,&st)!=0) { cout << "Error: can't open " << fname << endl; if(fd>=0) ::close(fd); return false; }
+      len=(size_t)st.st_size;
+      void* p=mmap(0,len,PROT_READ,MAP_PRIVATE,fd,0);
+      ::close(fd);
+      if(p==MAP_FAILED) { cout << "Error: can't map " << fname << endl; len=0; return false; }
+      base=static_cast<const char*>(p);
+      mapped=true;
+   }
+   else {
+      is.clear();
+      is.seekg(0);
+      if(!readtext(is)) { cout << "Error: can't read posterior trees from " << fname << endl; return false; }
+      base=tbuf.data();
+      len=tbuf.size();
+   }
+   if(!index()) {
+      cout << "Error: " << fname << " is not a valid posterior tree file" << endl;
+      close();
+      return false;
+   }
+   return true;
+}
+//--------------------------------------------------
+void fitfile::close()
+{
+   if(mapped) munmap(const_cast<char*>(base),len);
+   mapped=false;
+   base=0;
+   len=0;
+   tbuf.clear();
+   blk.clear();
+}
+//--------------------------------------------------
+//find the blocks and the draws in each of them
+bool fitfile::index()
+{
+   size_t pos=0;
+   while(pos+sizeof(fithead)<=len) {
+      fitblock fb;
+      fb.p=base+pos;
+      fb.hd=reinterpret_cast<const fithead*>(fb.p);
+      if(std::memcmp(fb.hd->magic,fitmagic,8)!=0) return false;
+      if(fb.hd->dtab) {
+         if(pos+fb.hd->bsize>len) return false;
+         const uint64_t* dt=reinterpret_cast<const uint64_t*>(fb.p+fb.hd->dtab);
+         fb.doff.assign(dt,dt+fb.hd->ndraw);
+         blk.push_back(fb);
+         pos+=fb.hd->bsize;
+      }
+      else {
+         //unfinished block, keep the draws that were written out completely
+         size_t q=pos+sizeof(fithead);
+         uint64_t nb;
+         while(q+sizeof(uint64_t)<=len) {
+            std::memcpy(&nb,base+q,sizeof(uint64_t));
+            if(nb==0 || q+nb>len) break;
+            fb.doff.push_back(q-pos);
+            q+=nb;
+         }
+         cout << "Warning: posterior tree file is incomplete, using the " << fb.doff.size() << " complete draws" << endl;
+         blk.push_back(fb);
+         break;
+      }
+   }
+   return blk.size()>0;
+}
+//--------------------------------------------------
+fitens fitfile::ens(const char* p, size_t ntree, size_t k, size_t& nb)
+{
+   fitens e;
+   e.ntree=ntree;
+   e.k=k;
+   e.toff=reinterpret_cast<const int32_t*>(p);
+   size_t nn=(size_t)e.toff[ntree];
+   e.id=e.toff+ntree+1;
+   e.v=e.id+nn;
+   e.c=e.v+nn;
+   size_t off=roundup8((ntree+1+3*nn)*sizeof(int32_t));
+   e.theta=reinterpret_cast<const double*>(p+off);
+   nb=off+nn*k*sizeof(double);
+   return e;
+}
+//--------------------------------------------------
+fitens fitfile::getens(size_t i, size_t b)
+{
+   size_t nb;
+   return ens(blk[b].p+blk[b].doff[i]+sizeof(uint64_t),m(b),k(b),nb);
+}
+//--------------------------------------------------
+fitens fitfile::getsens(size_t i, size_t b)
+{
+   size_t nb;
+   const char* p=blk[b].p+blk[b].doff[i]+sizeof(uint64_t);
+   ens(p,m(b),k(b),nb);
+   return ens(p+nb,mh(b),1,nb);
+}
+//--------------------------------------------------
+void fitfile::todraw(const fitens& e, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+               std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta)
+{
+   nn.resize(e.ntree);
+   id.resize(e.ntree);
+   v.resize(e.ntree);
+   c.resize(e.ntree);
+   theta.resize(e.ntree);
+   for(size_t j=0;j<e.ntree;j++) {
+      size_t beg=(size_t)e.toff[j],end=(size_t)e.toff[j+1];
+      nn[j]=(int)(end-beg);
+      id[j].assign(e.id+beg,e.id+end);
+      v[j].assign(e.v+beg,e.v+end);
+      c[j].assign(e.c+beg,e.c+end);
+      theta[j].assign(e.theta+beg*e.k,e.theta+end*e.k);
+   }
+}
+//--------------------------------------------------
+void fitfile::getdraw(size_t i, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+                std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta, size_t b)
+{
+   todraw(getens(i,b),nn,id,v,c,theta);
+}
+//--------------------------------------------------
+void fitfile::getsdraw(size_t i, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+                std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta, size_t b)
+{
+   todraw(getsens(i,b),nn,id,v,c,theta);
+}
+//--------------------------------------------------
+//read the text format: nd, m, mh, then size followed by values for the
+//tree sizes, ids, vars, cuts and thetas of the mean trees and then the
+//same for the variance trees.  Several of these may follow each other.
+bool fitfile::readtext(std::istream& is)
+{
+   std::ostringstream os;
+   size_t nd,m,mh;
+   while(is >> nd) {
+      if(!(is >> m >> mh)) return false;
+      std::vector<int> ots,oid,ov,oc,sts,sid,sv,sc;
+      std::vector<double> otheta,stheta;
+      std::vector<int>* iv[8]={&ots,&oid,&ov,&oc,&sts,&sid,&sv,&sc};
+      size_t temp;
+      for(size_t a=0;a<8;a++) {
+         if(!(is >> temp)) return false;
+         iv[a]->resize(temp);
+         for(size_t i=0;i<temp;i++) is >> iv[a]->at(i);
+         if(a==3 || a==7) {
+            std::vector<double>& th=(a==3) ? otheta : stheta;
+            if(!(is >> temp)) return false;
+            th.resize(temp);
+            for(size_t i=0;i<temp;i++) is >> std::scientific >> th.at(i);
+         }
+      }
+      if(!is || ots.size()!=nd*m || sts.size()!=nd*mh) return false;
+      size_t k=oid.size() ? otheta.size()/oid.size() : 1;
+
+      std::vector<std::vector<int> > did(m),dv(m),dc(m),dsid(mh),dsv(mh),dsc(mh);
+      std::vector<std::vector<double> > dtheta(m),dstheta(mh);
+      size_t ocum=0,scum=0;
+      fitwriter fw;
+      fw.begin(os,nd,m,mh,k);
+      for(size_t i=0;i<nd;i++) {
+         for(size_t j=0;j<m;j++) {
+            size_t nn=(size_t)ots[i*m+j];
+            did[j].assign(oid.begin()+ocum,oid.begin()+ocum+nn);
+            dv[j].assign(ov.begin()+ocum,ov.begin()+ocum+nn);
+            dc[j].assign(oc.begin()+ocum,oc.begin()+ocum+nn);
+            dtheta[j].assign(otheta.begin()+ocum*k,otheta.begin()+(ocum+nn)*k);
+            ocum+=nn;
+         }
+         for(size_t j=0;j<mh;j++) {
+            size_t nn=(size_t)sts[i*mh+j];
+            dsid[j].assign(sid.begin()+scum,sid.begin()+scum+nn);
+            dsv[j].assign(sv.begin()+scum,sv.begin()+scum+nn);
+            dsc[j].assign(sc.begin()+scum,sc.begin()+scum+nn);
+            dstheta[j].assign(stheta.begin()+scum,stheta.begin()+scum+nn);
+            scum+=nn;
+         }
+         fw.adddraw(0,did,dv,dc,dtheta,dsid,dsv,dsc,dstheta);
+      }
+      fw.end();
+   }
+   tbuf=os.str();
+   return tbuf.size()>0;
+}
+//--------------------------------------------------
+void fitfile::writetext(std::ostream& os, size_t b)
+{
+   size_t ndr=nd(b);
+   os << ndr << endl;
+   os << m(b) << endl;
+   os << mh(b) << endl;
+   for(size_t s=0;s<2;s++) {
+      std::vector<fitens> e(ndr);
+      size_t ntree=0,nn=0;
+      for(size_t i=0;i<ndr;i++) {
+         e[i]=(s==0) ? getens(i,b) : getsens(i,b);
+         ntree+=e[i].ntree;
+         nn+=(size_t)e[i].toff[e[i].ntree];
+      }
+      os << ntree << endl;
+      for(size_t i=0;i<ndr;i++) for(size_t j=0;j<e[i].ntree;j++) os << e[i].treesize(j) << endl;
+      os << nn << endl;
+      for(size_t i=0;i<ndr;i++) for(int32_t l=0;l<e[i].toff[e[i].ntree];l++) os << e[i].id[l] << endl;
+      os << nn << endl;
+      for(size_t i=0;i<ndr;i++) for(int32_t l=0;l<e[i].toff[e[i].ntree];l++) os << e[i].v[l] << endl;
+      os << nn << endl;
+      for(size_t i=0;i<ndr;i++) for(int32_t l=0;l<e[i].toff[e[i].ntree];l++) os << e[i].c[l] << endl;
+      os << nn*((s==0) ? k(b) : 1) << endl;
+      for(size_t i=0;i<ndr;i++) for(size_t l=0;l<(size_t)e[i].toff[e[i].ntree]*e[i].k;l++) os << std::scientific << e[i].theta[l] << endl;
+   }
+}
+
+//--------------------------------------------------
+bool fittotext(const std::string& fname)
+{
+   fitfile ff;
+   if(!ff.open(fname)) return false;
+   std::string tname=fname+".txt";
+   std::ofstream os(tname);
+   for(size_t b=0;b<ff.nblock();b++) ff.writetext(os,b);
+   os.close();
+   ff.close();
+   if(!os || std::rename(tname.c_str(),fname.c_str())!=0) {
+      cout << "Error: can't write " << fname << endl;
+      return false;
+   }
+   return true;
+}
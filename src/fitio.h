@@ -0,0 +1,153 @@
+//     fitio.h: Reading and writing of saved posterior tree draws (.fit files).
+//     Copyright (C) 2012-2018 Matthew T. Pratola
+//
+//     This file is part of OpenBT.
+//
+//     OpenBT is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Affero General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     OpenBT is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public License
+//     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//     Author contact information
+//     Matthew T. Pratola: mpratola@gmail.com
+
+
+#ifndef GUARD_fitio_h
+#define GUARD_fitio_h
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------
+//Binary .fit format.
+//A file is one or more blocks written back to back (.fitemulate holds one
+//block per emulator).  Each block holds nd draws of a mean ensemble of m trees
+//with k theta values per node and a variance ensemble of mh trees:
+//
+//   fithead
+//   draw 0 ... draw nd-1, each one record:
+//      uint64 nbytes                         size of the record
+//      int32  toff[m+1]                      node offset of each mean tree in this draw
+//      int32  id[no], v[no], c[no]           no=toff[m]
+//      pad to 8 bytes, double theta[no*k]
+//      int32  toff[mh+1], id[ns], v[ns], c[ns], pad, double theta[ns]
+//   uint64 doff[nd]                          offset of each draw from the block start
+//
+//Everything is 8 byte aligned and in native byte order, so a reader can mmap
+//the file and use the arrays in place.  The header is patched with dtab and
+//bsize when the block is finished; if the writer never got there (crashed run)
+//the readers recover the complete draws by walking the nbytes fields.
+//The old text format is still read, and can be written with fittotext().
+//--------------------------------------------------
+class fithead {
+public:
+   char magic[8];   //"OBTFIT01"
+   uint64_t nd;     //number of draws the block was set up for
+   uint64_t m;      //number of mean trees
+   uint64_t mh;     //number of variance trees
+   uint64_t k;      //number of thetas per mean tree node (1 unless model mixing)
+   uint64_t ndraw;  //number of draws written
+   uint64_t dtab;   //offset of the draw table from the block start, 0 if unfinished
+   uint64_t bsize;  //size of the block in bytes, 0 if unfinished
+};
+
+//--------------------------------------------------
+//pointers to the trees of one ensemble in one draw
+class fitens {
+public:
+   fitens(): ntree(0), k(1), toff(0), id(0), v(0), c(0), theta(0) {}
+   size_t ntree, k;
+   const int32_t *toff;     //tree j uses nodes toff[j] to toff[j+1]-1 of the arrays below
+   const int32_t *id, *v, *c;
+   const double *theta;     //k values per node
+   size_t treesize(size_t j) const { return (size_t)(toff[j+1]-toff[j]); }
+};
+
+//--------------------------------------------------
+//write one block of posterior draws to os, one draw at a time.
+class fitwriter {
+public:
+   fitwriter(): os(0), bstart(0) {}
+   //start a block at the current position of os
+   void begin(std::ostream& ios, size_t nd, size_t m, size_t mh, size_t k);
+   //append draw iter from vectors in savetree() layout (tree j of draw iter is element iter*m+j)
+   void adddraw(size_t iter, std::vector<std::vector<int> >& oid, std::vector<std::vector<int> >& ov,
+                std::vector<std::vector<int> >& oc, std::vector<std::vector<double> >& otheta,
+                std::vector<std::vector<int> >& sid, std::vector<std::vector<int> >& sv,
+                std::vector<std::vector<int> >& sc, std::vector<std::vector<double> >& stheta);
+   //write the draw table and patch the header
+   void end();
+   size_t ndraw() { return (size_t)hd.ndraw; }
+   //checkpoints: save how far the block has got, and carry on from there after a
+   //restart.  resume() cuts fname back to the saved length and reopens it in ofs.
+   void savestate(std::ostream& cs);
+   bool resume(std::ofstream& ofs, const std::string& fname, std::istream& cs);
+private:
+   std::ostream* os;
+   std::streamoff bstart;
+   fithead hd;
+   std::vector<uint64_t> doff;
+   std::vector<char> buf;
+   void addens(size_t iter, size_t ntree, size_t k, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+               std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta);
+};
+
+//--------------------------------------------------
+//read a .fit file, binary (mmap'd) or text.
+class fitfile {
+public:
+   fitfile(): base(0), len(0), mapped(false) {}
+   ~fitfile() { close(); }
+   //returns false and prints an error if the file can't be read
+   bool open(const std::string& fname);
+   void close();
+   size_t nblock() { return blk.size(); }
+   size_t nd(size_t b=0) { return blk[b].doff.size(); }
+   size_t m(size_t b=0) { return (size_t)blk[b].hd->m; }
+   size_t mh(size_t b=0) { return (size_t)blk[b].hd->mh; }
+   size_t k(size_t b=0) { return (size_t)blk[b].hd->k; }
+   //trees of draw i, mean ensemble (getens) or variance ensemble (getsens)
+   fitens getens(size_t i, size_t b=0);
+   fitens getsens(size_t i, size_t b=0);
+   //copy draw i into the vectors used by loadtree()/loadtree_vec() with iter=0
+   void getdraw(size_t i, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+                std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta, size_t b=0);
+   void getsdraw(size_t i, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+                std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta, size_t b=0);
+   //write block b in the text format
+   void writetext(std::ostream& os, size_t b=0);
+private:
+   class fitblock {
+   public:
+      const fithead* hd;
+      const char* p;                //start of the block
+      std::vector<uint64_t> doff;   //offsets of the complete draws
+   };
+   const char* base;
+   size_t len;
+   bool mapped;
+   std::string tbuf;   //text files are converted into the binary layout here
+   std::vector<fitblock> blk;
+   bool index();
+   bool readtext(std::istream& is);
+   fitens ens(const char* p, size_t ntree, size_t k, size_t& nb);
+   void todraw(const fitens& e, std::vector<int>& nn, std::vector<std::vector<int> >& id, std::vector<std::vector<int> >& v,
+               std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta);
+};
+
+//--------------------------------------------------
+//rewrite the (binary) .fit file fname in the text format, in place.
+bool fittotext(const std::string& fname);
+
+#endif
@@ -0,0 +1,290 @@
+//     flatforest.cpp: Flattened tree ensembles for batch prediction.
+//     Copyright (C) 2012-2018 Matthew T. Pratola
+//
+//     This file is part of OpenBT.
+//
+//     OpenBT is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Affero General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     OpenBT is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public License
+//     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//     Author contact information
+//     Matthew T. Pratola: mpratola@gmail.com
+
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "flatforest.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FLATFOREST_X86
+#include <immintrin.h>
+#endif
+
+//--------------------------------------------------
+//traversal kernels.  Each one pushes the n<=flatforest::nblock rows
+//x, x+p, ... through the tree rooted at node root and puts the leaf numbers in lf.
+typedef void (*leafkernel)(const int32_t* var, const double* cut, const int32_t* kid, int32_t root,
+                           size_t n, size_t p, const double* x, int32_t* lf);
+
+static void leaves_scalar(const int32_t* var, const double* cut, const int32_t* kid, int32_t root,
+                          size_t n, size_t p, const double* x, int32_t* lf)
+{
+   //all rows go down one level per pass, without branching on the split
+   int32_t idx[flatforest::nblock];
+   for(size_t r=0;r<n;r++) idx[r]=root;
+   for(bool more=true;more;) {
+      more=false;
+      for(size_t r=0;r<n;r++) {
+         int32_t i=idx[r], v=var[i];
+         if(v<0) continue;
+         idx[r]=kid[i]+!(x[r*p+v] < cut[i]);
+         more=true;
+      }
+   }
+   for(size_t r=0;r<n;r++) lf[r]=kid[idx[r]];
+}
+
+#ifdef FLATFOREST_X86
+//8 rows at a time.  Lanes past n repeat the last row.  Lanes that reached a
+//leaf keep going through the loop but their node is not changed.
+__attribute__((target("avx2")))
+static void leaves_avx2(const int32_t* var, const double* cut, const int32_t* kid, int32_t root,
+                        size_t n, size_t p, const double* x, int32_t* lf)
+{
+   const __m256i zero=_mm256_setzero_si256(), one=_mm256_set1_epi32(1), leaf=_mm256_set1_epi32(-1);
+   const __m256i lo=_mm256_setr_epi32(0,2,4,6,0,2,4,6), all=_mm256_set1_epi32(-1);
+   const __m256d dall=_mm256_castsi256_pd(all), dzero=_mm256_setzero_pd();
+   int32_t buf[8];
+   for(size_t r0=0;r0<n;r0+=8) {
+      for(size_t r=0;r<8;r++) buf[r]=(int32_t)(std::min(r0+r,n-1)*p);
+      __m256i xo=_mm256_loadu_si256((const __m256i*)buf);
+      __m256i idx=_mm256_set1_epi32(root);
+      for(;;) {
+         __m256i v=_mm256_mask_i32gather_epi32(zero,var,idx,all,4);
+         __m256i in=_mm256_cmpgt_epi32(v,leaf);
+         if(_mm256_testz_si256(in,in)) break;
+         __m256i xv=_mm256_add_epi32(xo,_mm256_max_epi32(v,zero));
+         __m256d xl=_mm256_mask_i32gather_pd(dzero,x,_mm256_castsi256_si128(xv),dall,8);
+         __m256d xh=_mm256_mask_i32gather_pd(dzero,x,_mm256_extracti128_si256(xv,1),dall,8);
+         __m256d cl=_mm256_mask_i32gather_pd(dzero,cut,_mm256_castsi256_si128(idx),dall,8);
+         __m256d ch=_mm256_mask_i32gather_pd(dzero,cut,_mm256_extracti128_si256(idx,1),dall,8);
+         //narrow the two 64 bit compare masks to one 32 bit mask, left is -1 in
+         //the lanes that go left, so kid+1+left picks the child
+         __m256i ll=_mm256_permutevar8x32_epi32(_mm256_castpd_si256(_mm256_cmp_pd(xl,cl,_CMP_LT_OQ)),lo);
+         __m256i lh=_mm256_permutevar8x32_epi32(_mm256_castpd_si256(_mm256_cmp_pd(xh,ch,_CMP_LT_OQ)),lo);
+         __m256i left=_mm256_blend_epi32(ll,lh,0xf0);
+         __m256i kd=_mm256_mask_i32gather_epi32(zero,kid,idx,all,4);
+         idx=_mm256_blendv_epi8(idx,_mm256_add_epi32(_mm256_add_epi32(kd,one),left),in);
+      }
+      _mm256_storeu_si256((__m256i*)buf,_mm256_mask_i32gather_epi32(zero,kid,idx,all,4));
+      for(size_t r=0;r<8 && r0+r<n;r++) lf[r0+r]=buf[r];
+   }
+}
+
+//same as above, 16 rows at a time
+__attribute__((target("avx512f")))
+static void leaves_avx512(const int32_t* var, const double* cut, const int32_t* kid, int32_t root,
+                          size_t n, size_t p, const double* x, int32_t* lf)
+{
+   const __m512i zero=_mm512_setzero_si512(), one=_mm512_set1_epi32(1), leaf=_mm512_set1_epi32(-1);
+   const __m512d dzero=_mm512_setzero_pd();
+   int32_t buf[16];
+   for(size_t r0=0;r0<n;r0+=16) {
+      for(size_t r=0;r<16;r++) buf[r]=(int32_t)(std::min(r0+r,n-1)*p);
+      __m512i xo=_mm512_loadu_si512(buf);
+      __m512i idx=_mm512_set1_epi32(root);
+      for(;;) {
+         __m512i v=_mm512_mask_i32gather_epi32(zero,0xffff,idx,var,4);
+         __mmask16 in=_mm512_cmpgt_epi32_mask(v,leaf);
+         if(!in) break;
+         __m512i xv=_mm512_add_epi32(xo,_mm512_maskz_max_epi32(0xffff,v,zero));
+         __m512d xl=_mm512_mask_i32gather_pd(dzero,0xff,_mm512_maskz_extracti64x4_epi64(0xff,xv,0),x,8);
+         __m512d xh=_mm512_mask_i32gather_pd(dzero,0xff,_mm512_maskz_extracti64x4_epi64(0xff,xv,1),x,8);
+         __m512d cl=_mm512_mask_i32gather_pd(dzero,0xff,_mm512_maskz_extracti64x4_epi64(0xff,idx,0),cut,8);
+         __m512d ch=_mm512_mask_i32gather_pd(dzero,0xff,_mm512_maskz_extracti64x4_epi64(0xff,idx,1),cut,8);
+         __mmask16 lt=(__mmask16)((unsigned)_mm512_cmp_pd_mask(xl,cl,_CMP_LT_OQ)
+                                 | ((unsigned)_mm512_cmp_pd_mask(xh,ch,_CMP_LT_OQ)<<8));
+         __m512i kd=_mm512_mask_i32gather_epi32(zero,0xffff,idx,kid,4);
+         kd=_mm512_mask_add_epi32(kd,(__mmask16)~lt,kd,one);
+         idx=_mm512_mask_mov_epi32(idx,in,kd);
+      }
+      _mm512_storeu_si512(buf,_mm512_mask_i32gather_epi32(zero,0xffff,idx,kid,4));
+      for(size_t r=0;r<16 && r0+r<n;r++) lf[r0+r]=buf[r];
+   }
+}
+#endif
+
+static int bestsimd()
+{
+#ifdef FLATFOREST_X86
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f")) return 2;
+   if(__builtin_cpu_supports("avx2")) return 1;
+#endif
+   return 0;
+}
+const size_t flatforest::nblock;
+int flatforest::simd=bestsimd();
+
+void flatforest::setsimd(int s)
+{
+   simd=std::max(0,std::min(s,bestsimd()));
+}
+
+//--------------------------------------------------
+//rebuild from one ensemble of a .fit file
+void flatforest::set(const fitens& e, xinfo& xi)
+{
+   k=e.k;
+   var.clear(); cut.clear(); kid.clear(); theta.clear();
+   root.resize(e.ntree);
+
+   std::unordered_map<int32_t,size_t> pos; //node id -> position in the .fit arrays
+   std::vector<size_t> q;                  //.fit positions of this tree's nodes in flat order
+   for(size_t j=0;j<e.ntree;j++) {
+      size_t beg=(size_t)e.toff[j],end=(size_t)e.toff[j+1];
+      pos.clear();
+      for(size_t i=beg;i<end;i++) pos[e.id[i]]=i;
+
+      //breadth first from the root (id 1), children of node id are 2id and 2id+1
+      int32_t f0=(int32_t)var.size();
+      root[j]=f0;
+      q.assign(1,pos[1]);
+      for(size_t h=0;h<q.size();h++) {
+         size_t i=q[h];
+         std::unordered_map<int32_t,size_t>::const_iterator il=pos.find(2*e.id[i]);
+         if(il!=pos.end()) {
+            var.push_back(e.v[i]);
+            cut.push_back(xi[e.v[i]][e.c[i]]);
+            kid.push_back(f0+(int32_t)q.size());
+            q.push_back(il->second);
+            q.push_back(pos[2*e.id[i]+1]);
+         } else {
+            var.push_back(-1);
+            cut.push_back(0.0);
+            kid.push_back((int32_t)(theta.size()/k));
+            theta.insert(theta.end(),e.theta+i*k,e.theta+(i+1)*k);
+         }
+      }
+   }
+}
+//--------------------------------------------------
+//rebuild from trees, same layout as above
+void flatforest::set(const tree::cnpv& t, xinfo& xi, size_t kvec)
+{
+   k = kvec ? kvec : 1;
+   var.clear(); cut.clear(); kid.clear(); theta.clear();
+   root.resize(t.size());
+
+   tree::cnpv q;
+   for(size_t j=0;j<t.size();j++) {
+      int32_t f0=(int32_t)var.size();
+      root[j]=f0;
+      q.assign(1,t[j]);
+      for(size_t h=0;h<q.size();h++) {
+         tree::tree_cp n=q[h];
+         if(n->l) {
+            var.push_back((int32_t)n->v);
+            cut.push_back(xi[n->v][n->c]);
+            kid.push_back(f0+(int32_t)q.size());
+            q.push_back(n->l);
+            q.push_back(n->r);
+         } else {
+            var.push_back(-1);
+            cut.push_back(0.0);
+            kid.push_back((int32_t)(theta.size()/k));
+            if(kvec) theta.insert(theta.end(),n->thetavec.data(),n->thetavec.data()+k);
+            else theta.push_back(n->theta);
+         }
+      }
+   }
+}
+//--------------------------------------------------
+void flatforest::leaves(size_t j, size_t n, size_t p, const double* x, int32_t* lf) const
+{
+#ifdef FLATFOREST_X86
+   if(simd==2) { leaves_avx512(&var[0],&cut[0],&kid[0],root[j],n,p,x,lf); return; }
+   if(simd==1) { leaves_avx2(&var[0],&cut[0],&kid[0],root[j],n,p,x,lf); return; }
+#endif
+   leaves_scalar(&var[0],&cut[0],&kid[0],root[j],n,p,x,lf);
+}
+//--------------------------------------------------
+//The predict functions go through the rows nblock at a time, and for each
+//block through the trees in order, so the accumulation for a row is the
+//same as going through the trees one row at a time.
+void flatforest::predictsum(size_t beg, size_t end, size_t p, const double* x, double* y) const
+{
+   int32_t lf[nblock];
+   double acc[nblock];
+   for(size_t i=beg;i<end;i+=nblock) {
+      size_t nb=std::min(nblock,end-i);
+      for(size_t r=0;r<nb;r++) acc[r]=0.0;
+      for(size_t j=0;j<root.size();j++) {
+         leaves(j,nb,p,x+i*p,lf);
+         for(size_t r=0;r<nb;r++) acc[r]+=theta[lf[r]];
+      }
+      for(size_t r=0;r<nb;r++) y[i+r]=acc[r];
+   }
+}
+//--------------------------------------------------
+void flatforest::predictprod(size_t beg, size_t end, size_t p, const double* x, double* y) const
+{
+   int32_t lf[nblock];
+   double acc[nblock];
+   for(size_t i=beg;i<end;i+=nblock) {
+      size_t nb=std::min(nblock,end-i);
+      for(size_t r=0;r<nb;r++) acc[r]=1.0;
+      for(size_t j=0;j<root.size();j++) {
+         leaves(j,nb,p,x+i*p,lf);
+         for(size_t r=0;r<nb;r++) acc[r]*=theta[lf[r]];
+      }
+      for(size_t r=0;r<nb;r++) y[i+r]=acc[r];
+   }
+}
+//--------------------------------------------------
+void flatforest::predictmix(size_t beg, size_t end, size_t p, const double* x, const finfo& f, double* y) const
+{
+   int32_t lf[nblock];
+   double acc[nblock];
+   for(size_t i=beg;i<end;i+=nblock) {
+      size_t nb=std::min(nblock,end-i);
+      for(size_t r=0;r<nb;r++) acc[r]=0.0;
+      for(size_t j=0;j<root.size();j++) {
+         leaves(j,nb,p,x+i*p,lf);
+         for(size_t r=0;r<nb;r++) {
+            const double* th=&theta[k*(size_t)lf[r]];
+            double s=f(i+r,0)*th[0];
+            for(size_t l=1;l<k;l++) s+=f(i+r,l)*th[l];
+            acc[r]+=s;
+         }
+      }
+      for(size_t r=0;r<nb;r++) y[i+r]=acc[r];
+   }
+}
+//--------------------------------------------------
+void flatforest::mixwts(size_t beg, size_t end, size_t p, const double* x, mxd& wts) const
+{
+   int32_t lf[nblock];
+   for(size_t i=beg;i<end;i+=nblock) {
+      size_t nb=std::min(nblock,end-i);
+      for(size_t r=0;r<nb;r++) wts.col(i+r).setZero();
+      for(size_t j=0;j<root.size();j++) {
+         leaves(j,nb,p,x+i*p,lf);
+         for(size_t r=0;r<nb;r++) {
+            const double* th=&theta[k*(size_t)lf[r]];
+            double* w=&wts(0,i+r);
+            for(size_t l=0;l<k;l++) w[l]+=th[l];
+         }
+      }
+   }
+}
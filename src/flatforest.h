@@ -0,0 +1,85 @@
+//     flatforest.h: Flattened tree ensembles for batch prediction.
+//     Copyright (C) 2012-2018 Matthew T. Pratola
+//
+//     This file is part of OpenBT.
+//
+//     OpenBT is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Affero General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     OpenBT is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public License
+//     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//     Author contact information
+//     Matthew T. Pratola: mpratola@gmail.com
+
+
+#ifndef GUARD_flatforest_h
+#define GUARD_flatforest_h
+
+#include <cstdint>
+#include <vector>
+
+#include "tree.h"
+#include "fitio.h"
+
+//--------------------------------------------------
+//One posterior draw of an ensemble stored as flat arrays, for prediction.
+//The nodes of all trees are in one set of arrays, each tree in breadth first
+//order with the two children of a node next to each other:
+//   var[i]   split variable of node i, -1 if i is a leaf
+//   cut[i]   split value xi[var[i]][c], go left if x[var[i]] < cut[i]
+//   kid[i]   index of the left child (right child is kid[i]+1), or for a
+//            leaf the leaf number, whose k thetas are theta[k*kid[i]...]
+//   root[j]  index of the root of tree j
+//The forest is built straight from the .fit arrays, or from the trees of a
+//fitted model.  Rows are pushed through each tree nblock at a time by a
+//kernel that uses AVX-512 or AVX2 gathers when the cpu has them, and plain
+//scalar code otherwise.  The predict functions accumulate over trees in the
+//same order as ambrt/psbrt/amxbrt, so they give the same numbers.
+//--------------------------------------------------
+class flatforest {
+public:
+   static const size_t nblock=16;
+   flatforest(): k(1) {}
+   //rebuild from one ensemble of a .fit file, using cutpoints xi
+   void set(const fitens& e, xinfo& xi);
+   //rebuild from trees with scalar theta (kvec=0) or thetavec of length kvec
+   void set(const tree::cnpv& t, xinfo& xi, size_t kvec=0);
+   size_t ntree() const { return root.size(); }
+   size_t nnode() const { return var.size(); }
+   //thetas of the leaf x falls in for tree j
+   const double* leaf(size_t j, const double* x) const {
+      int32_t i=root[j];
+      while(var[i]>=0) i = (x[var[i]] < cut[i]) ? kid[i] : kid[i]+1;
+      return &theta[k*(size_t)kid[i]];
+   }
+   //leaf numbers of tree j for the n<=nblock rows x, x+p, ..., x+(n-1)*p
+   void leaves(size_t j, size_t n, size_t p, const double* x, int32_t* lf) const;
+   //the functions below predict at rows beg to end-1 of x (row i starts at x+i*p)
+   //sum of trees into y[i] (ambrt)
+   void predictsum(size_t beg, size_t end, size_t p, const double* x, double* y) const;
+   //product of trees into y[i] (psbrt)
+   void predictprod(size_t beg, size_t end, size_t p, const double* x, double* y) const;
+   //sum over trees of f.row(i)*thetavec into y[i] (amxbrt)
+   void predictmix(size_t beg, size_t end, size_t p, const double* x, const finfo& f, double* y) const;
+   //column i of wts is the sum of the leaf vectors at row i (amxbrt::get_mix_wts)
+   void mixwts(size_t beg, size_t end, size_t p, const double* x, mxd& wts) const;
+   //traversal kernel: 0 scalar, 1 AVX2, 2 AVX-512.  Starts at the best one the
+   //cpu supports, setsimd() can only choose a lower one.
+   static int getsimd() { return simd; }
+   static void setsimd(int s);
+private:
+   static int simd;
+   size_t k;
+   std::vector<int32_t> var, kid, root;
+   std::vector<double> cut, theta;
+};
+
+#endif
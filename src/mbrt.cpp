@@ -111,7 +111,7 @@ void mbrt::local_mpi_sr_suffs(sinfo& sil, sinfo& sir)
       int position=0;
       unsigned int ln,rn;
       //cout << "Here2 mpi" << endl;
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          //cout << "tsir.sumw = " << tsir.sumw << endl;
          //cout << "tsir.sumwy = " << tsir.sumwy << endl;
          
@@ -165,7 +165,7 @@ void mbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
    double sumwvec[siv.size()];
    double sumwyvec[siv.size()];
 
-   for(size_t i=0;i<siv.size();i++) { // on root node, these should be 0 because of newsinfo().
+   for(size_t i=0;i<siv.size();i++) { // on root node, the suff stats of its own rows (0 if it holds none).
       msinfo* msi=static_cast<msinfo*>(siv[i]);
       nvec[i]=(unsigned int)msi->n;    // cast to int
       sumwvec[i]=msi->sumw;
@@ -185,13 +185,13 @@ void mbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
       double tempsumwyvec[siv.size()];
       
       // receive nvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempnvec,siv.size(),MPI_UNSIGNED,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             nvec[j]+=tempnvec[j]; 
       }
-      MPI_Request *request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&nvec,siv.size(),MPI_UNSIGNED,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       
@@ -200,17 +200,17 @@ void mbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          msinfo* msi=static_cast<msinfo*>(siv[i]);
          msi->n=(size_t)nvec[i];    // cast back to size_t
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 
       // receive sumwvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempsumwvec,siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             sumwvec[j]+=tempsumwvec[j];
       }
-      request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&sumwvec,siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to msi
@@ -218,17 +218,17 @@ void mbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          msinfo* msi=static_cast<msinfo*>(siv[i]);
          msi->sumw=sumwvec[i];
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
       
       // receive sumwyvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempsumwyvec,siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             sumwyvec[j]+=tempsumwyvec[j];
       }
-      request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&sumwyvec,siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to msi
@@ -236,7 +236,7 @@ void mbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          msinfo* msi=static_cast<msinfo*>(siv[i]);
          msi->sumwy=sumwyvec[i];
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
    }
    else {
@@ -93,6 +93,9 @@ public:
    virtual std::vector<sinfo*>& newsinfovec(size_t dim) { std::vector<sinfo*>* si = new std::vector<sinfo*>; si->resize(dim); for(size_t i=0;i<dim;i++) si->push_back(new msinfo); return *si; }
    virtual void local_mpi_reduce_allsuff(std::vector<sinfo*>& siv);
    virtual void local_mpi_sr_suffs(sinfo& sil, sinfo& sir);
+   virtual size_t mpi_suffsize() { return 3; }
+   virtual void local_mpi_packsuff(sinfo& si, double* buf) { msinfo& msi=static_cast<msinfo&>(si); buf[0]=(double)msi.n; buf[1]=msi.sumw; buf[2]=msi.sumwy; }
+   virtual void local_mpi_unpacksuff(double* buf, sinfo& si) { msinfo& msi=static_cast<msinfo&>(si); msi.n=(size_t)buf[0]; msi.sumw=buf[1]; msi.sumwy=buf[2]; }
    void pr();
 
    //--------------------
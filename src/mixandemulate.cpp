@@ -1,4 +1,5 @@
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <ctime>
@@ -22,6 +23,7 @@
 #include "tnorm.h"
 #include "mxbrt.h"
 #include "amxbrt.h"
+#include "fitio.h"
 
 using std::cout;
 using std::endl;
@@ -37,10 +39,81 @@ using std::endl;
 #define MODEL_MIXBART 9
 #define MODEL_MIXEMULATE 10
 
+//--------------------------------------------------
+//Coupling of the mixing model and the emulators at the field obs.  The full mixed
+//prediction w0+sum_k wk*fk is kept in mixpred, so emulator j's leave-one-out mixture is
+//mixpred-wj*fj and each step is one O(n) pass rather than a sum over the other K-1 models.
+
+//mixed prediction at the field obs from the weights of the current mixing draw
+void setmixpred(const finfo& fi, const mxd& wts, std::vector<double>& mixpred, int tc)
+{
+#ifdef _OPENMP
+#  pragma omp parallel num_threads(tc)
+#endif
+    {
+        int beg=0,end=(int)mixpred.size();
+#ifdef _OPENMP
+        calcbegend((int)mixpred.size(),omp_get_thread_num(),omp_get_num_threads(),&beg,&end);
+#endif
+        for(size_t l=(size_t)beg;l<(size_t)end;l++){
+            double mp=wts(0,l);
+            for(size_t k=1;k<(size_t)wts.rows();k++) mp+=fi(l,k)*wts(k,l);
+            mixpred[l]=mp;
+        }
+    }
+}
+
+//re-weighted field obs and their variances for emulator j, written into its yj and sj
+void setemufield(int j, const finfo& fi, const mxd& wts, const std::vector<double>& mixpred, const double* y0,
+                const double* s0, double mean, double* yj, double* sj, int tc)
+{
+#ifdef _OPENMP
+#  pragma omp parallel num_threads(tc)
+#endif
+    {
+        int beg=0,end=(int)mixpred.size();
+#ifdef _OPENMP
+        calcbegend((int)mixpred.size(),omp_get_thread_num(),omp_get_num_threads(),&beg,&end);
+#endif
+        for(size_t l=(size_t)beg;l<(size_t)end;l++){
+            double wj=wts(j+1,l);
+            yj[l]=(y0[l]-(mixpred[l]-fi(l,j+1)*wj))/wj-mean;
+            sj[l]=s0[l]/wj;
+        }
+    }
+}
+
+//put emulator j's new predictions fj at the field obs in fi and keep mixpred current
+void setemufi(int j, const double* fj, double mean, finfo& fi, const mxd& wts, std::vector<double>& mixpred, int tc)
+{
+#ifdef _OPENMP
+#  pragma omp parallel num_threads(tc)
+#endif
+    {
+        int beg=0,end=(int)mixpred.size();
+#ifdef _OPENMP
+        calcbegend((int)mixpred.size(),omp_get_thread_num(),omp_get_num_threads(),&beg,&end);
+#endif
+        for(size_t l=(size_t)beg;l<(size_t)end;l++){
+            double f=fj[l]+mean;
+            mixpred[l]+=(f-fi(l,j+1))*wts(j+1,l);
+            fi(l,j+1)=f;
+        }
+    }
+}
+
 
 int main(int argc, char* argv[])
 {
     std::string folder("");
+    //optional: --checkpoint N saves the state of the chain every N iterations and
+    //--resume carries on from the last checkpoint.  With MPI, --threads N has each
+    //rank run N OpenMP threads over its rows (hybrid builds).
+    size_t chkevery=0;
+    bool resume=false;
+#ifdef _OPENMPI
+    int ranktc=1;
+#endif
 
     if(argc>1)
     {
@@ -56,6 +129,15 @@ int main(int argc, char* argv[])
     //otherwise argument on the command line is path to conifg file.
     folder=std::string(argv[1]);
     folder=folder+"/";
+
+    for(int a=2;a<argc;a++) {
+        std::string opt(argv[a]);
+        if(opt=="--resume") resume=true;
+        else if(opt=="--checkpoint" && a+1<argc) chkevery=std::stoul(argv[++a]);
+#ifdef _OPENMPI
+        else if(opt=="--threads" && a+1<argc) ranktc=std::stoi(argv[++a]);
+#endif
+    }
     }
 
 
@@ -220,6 +302,11 @@ int main(int argc, char* argv[])
     conf >> summarystats_str;
     if(summarystats_str=="TRUE"){ summarystats = true;}
     if(summarystats){ cout << "Add summary stats...";}
+
+    // posterior tree file format, binary unless "text" is given (optional)
+    bool fittext = false;
+    std::string fitformat_str;
+    if(conf >> fitformat_str && fitformat_str=="text") fittext = true;
     conf.close();
 
     //MPI initialization
@@ -239,6 +326,12 @@ int main(int argc, char* argv[])
     // #else
     //    if(tc!=1) return 0; //serial mode should have no slave threads!
 #endif
+    //OpenMP threads of the data objects and of the trees.  With MPI, tc is the number
+    //of processes and each rank runs its own team of --threads over its rows.
+    int ditc=tc, brttc=tc-1;
+#ifdef _OPENMPI
+    ditc=brttc=ranktc;
+#endif
 
     //--------------------------------------------------
     // Banner
@@ -249,6 +342,14 @@ int main(int argc, char* argv[])
         cout << "Loading config file at " << folder << endl;
     }
 
+    //--------------------------------------------------
+    //every rank holding rows loads its own shard.  Rank 0 always coordinates the moves
+    //and holds rows as well when its shard of the field data is there.
+    bool hasrows=true;
+#ifdef _OPENMPI
+    if(mpirank==0) hasrows=std::ifstream(folder + ycore_list[0] + "0").good();
+#endif
+
     //--------------------------------------------------
     //read in y for mixing and z's for emulation
     std::vector<std::vector<double>> y_list(ycore_list.size(), std::vector<double>(1));
@@ -263,7 +364,7 @@ int main(int argc, char* argv[])
     for(size_t i=0;i<ycore_list.size();i++){
     if(y.size()>0){y.clear();} //clear the contents of the y vector
     #ifdef _OPENMPI
-        if(mpirank>0) { //only load data on slaves
+        if(hasrows) { //only load data on the ranks holding rows
     #endif
         yfss << folder << ycore_list[i] << mpirank;
         yfs=yfss.str();
@@ -306,7 +407,7 @@ int main(int argc, char* argv[])
     p = 0;
     for(size_t i = 0;i<xcore_list.size();i++){
 #ifdef _OPENMPI
-        if(mpirank>0) {
+        if(hasrows) {
 #endif
         if(x.size() > 0){x.clear();}
         xfss << folder << xcore_list[i] << mpirank;
@@ -340,14 +441,14 @@ int main(int argc, char* argv[])
         }
         int tempp = (unsigned int) pvec[i];
         MPI_Allreduce(MPI_IN_PLACE,&tempp,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
-        if(mpirank>0 && pvec[i] != ((size_t) tempp)) { cout << "PROBLEM LOADING DATA" << endl; MPI_Finalize(); return 0;}
+        if(hasrows && pvec[i] != ((size_t) tempp)) { cout << "PROBLEM LOADING DATA" << endl; MPI_Finalize(); return 0;}
         pvec[i]=(size_t)tempp;
 #endif
     }
 
     // Set xv_list = x_list. This preserves the original separation of field anc computer inputs
     // xv_list is the set of inputs passed into the variance models
-    if(mpirank>0){
+    if(hasrows){
         xv_list = x_list;
     }
 
@@ -357,7 +458,7 @@ int main(int argc, char* argv[])
     size_t xcolsize = 0;
     xcol = 0;
     // Get the appropriate x columns
-    if(mpirank > 0){
+    if(hasrows){
         for(int i=0;i<nummodels;i++){
             xcolsize = x_cols_list[i].size(); //x_cols_list is nummodel dimensional -- only for emulators
             for(size_t j=0;j<nvec[0];j++){
@@ -385,9 +486,9 @@ int main(int argc, char* argv[])
     //dinfo
     std::vector<dinfo> dinfo_list(nummodels+1);
     for(int i=0;i<=nummodels;i++){
-        dinfo_list[i].n=0;dinfo_list[i].p=pvec[i],dinfo_list[i].x = NULL;dinfo_list[i].y=NULL;dinfo_list[i].tc=tc;
+        dinfo_list[i].n=0;dinfo_list[i].p=pvec[i],dinfo_list[i].x = NULL;dinfo_list[i].y=NULL;dinfo_list[i].tc=ditc;
 #ifdef _OPENMPI
-        if(mpirank>0){ 
+        if(hasrows){ 
 #endif 
             dinfo_list[i].n=nvec[i]; dinfo_list[i].x = &x_list[i][0]; dinfo_list[i].y = &y_list[i][0];
             //cout <<  "dinfo_list[i].n = " << dinfo_list[i].n << endl;
@@ -426,7 +527,7 @@ int main(int argc, char* argv[])
     size_t nsig=0;
     for(int i=0;i<=nummodels;i++){
 #ifdef _OPENMPI
-        if(mpirank>0) { //only load data on slaves
+        if(hasrows) { //only load data on the ranks holding rows
 #endif
         sigmav.clear(); // clear the vector of any contents
         sfss << folder << score_list[i] << mpirank;
@@ -452,9 +553,9 @@ int main(int argc, char* argv[])
 #endif
 
         sig_vec[i]=&sigmav_list[i][0];
-        disig_list[i].n=0; disig_list[i].p=pvec[i]; disig_list[i].x=NULL; disig_list[i].y=NULL; disig_list[i].tc=tc;
+        disig_list[i].n=0; disig_list[i].p=pvec[i]; disig_list[i].x=NULL; disig_list[i].y=NULL; disig_list[i].tc=ditc;
 #ifdef _OPENMPI
-        if(mpirank>0) { 
+        if(hasrows) { 
 #endif
         if(i>0){
             // Emulators
@@ -573,6 +674,16 @@ int main(int argc, char* argv[])
         }
 #endif
     }
+
+    //--------------------------------------------------
+    //binned x used by the tree moves. The variance data and the field obs used for
+    //predictions are rows of x_list[j] too, so they share its bins.
+    std::vector<std::vector<unsigned char>> xb8_list(nummodels+1);
+    std::vector<std::vector<unsigned short>> xb16_list(nummodels+1);
+    for(int j=0;j<=nummodels;j++){
+        makexbin(dinfo_list[j],xi_list[j],xb8_list[j],xb16_list[j]);
+        disig_list[j].xb8=dinfo_list[j].xb8; disig_list[j].xb16=dinfo_list[j].xb16;
+    }
     
     //--------------------------------------------------
     //Load master list of ids for emulators, designates field obs vs computer output
@@ -630,7 +741,7 @@ int main(int argc, char* argv[])
     nu = 1.0; //reset nu to 1, previosuly defined earlier in program
 
     //Initialize the model mixing bart objects
-    if(mpirank > 0){
+    if(hasrows){
         fi = mxd::Ones(nvec[0], nummodels+1); //dummy initialize to matrix of 1's -- n0 x K+1 (1st column is discrepancy)
     }
     //cutpoints
@@ -640,10 +751,11 @@ int main(int argc, char* argv[])
     //data objects
     axb.setdata_mix(&dinfo_list[0]);  //set the data
     //thread count
-    axb.settc(tc-1);      //set the number of slaves when using MPI.
+    axb.settc(brttc);      //set the number of threads (per rank when using MPI).
     //mpi rank
 #ifdef _OPENMPI
     axb.setmpirank(mpirank);  //set the rank when using MPI.
+    axb.setmpislaves(tc-1);  //set the number of slaves when using MPI.
     axb.setmpicvrange(lwr_vec[0],upr_vec[0]); //range of variables each slave node will update in MPI change-of-var proposals.
 #endif
     //tree prior
@@ -675,17 +787,18 @@ int main(int argc, char* argv[])
     //--------------------------------------------------
     //setup psbrt object
     //make di for psbrt object
-    dips_list[0].n=0; dips_list[0].p=pvec[0]; dips_list[0].x=NULL; dips_list[0].y=NULL; dips_list[0].tc=tc;
+    dips_list[0].n=0; dips_list[0].p=pvec[0]; dips_list[0].x=NULL; dips_list[0].y=NULL; dips_list[0].tc=ditc;
     for(int j=0;j<=nummodels;j++) r_list[j] = NULL;
     //double *r = NULL;
 #ifdef _OPENMPI
-    if(mpirank>0) {
+    if(hasrows) {
 #endif
     r_list[0] = new double[nvec[0]]; 
     //r = new double[nvec[0]];
     for(size_t i=0;i<nvec[0];i++) r_list[0][i]=sigmav_list[0][i];
     //for(size_t i=0;i<nvec[0];i++) r[i]=sigmav_list[0][i];
     dips_list[0].x=&xv_list[0][0]; dips_list[0].y=r_list[0]; dips_list[0].n=nvec[0];
+    dips_list[0].xb8=dinfo_list[0].xb8; dips_list[0].xb16=dinfo_list[0].xb16;
     //dips_list[0].x=&x_list[0][0]; dips_list[0].y=r; dips_list[0].n=nvec[0];
 #ifdef _OPENMPI
     }
@@ -701,10 +814,11 @@ int main(int argc, char* argv[])
     //data objects
     pxb.setdata(&dips_list[0]);  //set the data
     //thread count
-    pxb.settc(tc-1); 
+    pxb.settc(brttc);
     //mpi rank
 #ifdef _OPENMPI
     pxb.setmpirank(mpirank);  //set the rank when using MPI.
+    pxb.setmpislaves(tc-1);  //set the number of slaves when using MPI.
     pxb.setmpicvrange(lwr_vec[0],upr_vec[0]); //range of variables each slave node will update in MPI change-of-var proposals.
 #endif
     //tree prior
@@ -733,10 +847,11 @@ int main(int argc, char* argv[])
         //data objects
         ambm_list[l]->setdata(&dinfo_list[j]);        
         //thread count
-        ambm_list[l]->settc(tc-1);      //set the number of slaves when using MPI.
+        ambm_list[l]->settc(brttc);      //set the number of threads (per rank when using MPI).
         //mpi rank
     #ifdef _OPENMPI
         ambm_list[l]->setmpirank(mpirank);  //set the rank when using MPI.
+        ambm_list[l]->setmpislaves(tc-1);  //set the number of slaves when using MPI.
         ambm_list[l]->setmpicvrange(lwr_vec[j],upr_vec[j]); //range of variables each slave node will update in MPI change-of-var proposals.
     #endif
         //tree prior
@@ -766,14 +881,15 @@ int main(int argc, char* argv[])
 
         //make dips info
         tempn = 0;
-        dips_list[j].n=0; dips_list[j].p=p; dips_list[j].x=NULL; dips_list[j].y=NULL; dips_list[j].tc=tc;
+        dips_list[j].n=0; dips_list[j].p=p; dips_list[j].x=NULL; dips_list[j].y=NULL; dips_list[j].tc=ditc;
 #ifdef _OPENMPI
-        if(mpirank>0) {
+        if(hasrows) {
 #endif      
             tempn = nvec[j] - nvec[0];
             r_list[j] = new double[tempn];
             for(size_t i=0;i<tempn;i++) r_list[j][i]=sigmav_list[j][i];
             dips_list[j].x=&xv_list[j][0]; dips_list[j].y=r_list[j]; dips_list[j].n=tempn;
+            dips_list[j].xb8=dinfo_list[j].xb8; dips_list[j].xb16=dinfo_list[j].xb16;
             /*
             if(j == 2){
                 diterator diter2(&dips_list[2]);
@@ -793,10 +909,11 @@ int main(int argc, char* argv[])
         //data objects
         psbm_list[l]->setdata(&dips_list[j]);  //set the data
         //thread count
-        psbm_list[l]->settc(tc-1); 
+        psbm_list[l]->settc(brttc);
         //mpi rank
         #ifdef _OPENMPI
         psbm_list[l]->setmpirank(mpirank);  //set the rank when using MPI.
+        psbm_list[l]->setmpislaves(tc-1);  //set the number of slaves when using MPI.
         psbm_list[l]->setmpicvrange(lwr_vec[j],upr_vec[j]); //range of variables each slave node will update in MPI change-of-var proposals.
         #endif
         //tree prior
@@ -824,37 +941,38 @@ int main(int argc, char* argv[])
     //brtMethodWrapper *fambm_list[nummodels];
     //brtMethodWrapper *fpsbm_list[nummodels];
     
-    // Define containers -- similar to those in cli.cpp, except now we iterate over K+1 bart objects
-    std::vector<std::vector<int>> onn_list(nummodels+1, std::vector<int>(nd,1));
-    std::vector<std::vector<std::vector<int>>> oid_list(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-    std::vector<std::vector<std::vector<int>>> ovar_list(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-    std::vector<std::vector<std::vector<int>>> oc_list(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-    std::vector<std::vector<std::vector<double>>> otheta_list(nummodels+1, std::vector<std::vector<double>>(nd, std::vector<double>(1)));
+    // Define containers for one draw -- similar to those in cli.cpp, except now we iterate over K+1 bart objects.
+    // The draws are written out as they are made: the mixing trees to .fitmix and each emulator
+    // to a part file of its own, which are put together in .fitemulate at the end.
+    std::vector<std::vector<int>> onn_list(nummodels+1);
+    std::vector<std::vector<std::vector<int>>> oid_list(nummodels+1);
+    std::vector<std::vector<std::vector<int>>> ovar_list(nummodels+1);
+    std::vector<std::vector<std::vector<int>>> oc_list(nummodels+1);
+    std::vector<std::vector<std::vector<double>>> otheta_list(nummodels+1);
     
-    std::vector<std::vector<int>> snn_list(nummodels+1, std::vector<int>(nd,1));
-    std::vector<std::vector<std::vector<int>>> sid_list(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-    std::vector<std::vector<std::vector<int>>> svar_list(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-    std::vector<std::vector<std::vector<int>>> sc_list(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-    std::vector<std::vector<std::vector<double>>> stheta_list(nummodels+1, std::vector<std::vector<double>>(nd, std::vector<double>(1)));
+    std::vector<std::vector<int>> snn_list(nummodels+1);
+    std::vector<std::vector<std::vector<int>>> sid_list(nummodels+1);
+    std::vector<std::vector<std::vector<int>>> svar_list(nummodels+1);
+    std::vector<std::vector<std::vector<int>>> sc_list(nummodels+1);
+    std::vector<std::vector<std::vector<double>>> stheta_list(nummodels+1);
+    std::vector<std::ofstream> omf_list(nummodels+1);
+    std::vector<fitwriter> fw_list(nummodels+1);
+    std::vector<std::string> fitname_list(nummodels+1);
   
     // Initialization of objects
     for(int i=0;i<=nummodels;i++){
-        onn_list[i].resize(nd*m_list[i],1);
-        oid_list[i].resize(nd*m_list[i], std::vector<int>(1));
-        ovar_list[i].resize(nd*m_list[i], std::vector<int>(1));
-        oc_list[i].resize(nd*m_list[i], std::vector<int>(1));
-        otheta_list[i].resize(nd*m_list[i], std::vector<double>(1));
+        onn_list[i].resize(m_list[i],1);
+        oid_list[i].resize(m_list[i], std::vector<int>(1));
+        ovar_list[i].resize(m_list[i], std::vector<int>(1));
+        oc_list[i].resize(m_list[i], std::vector<int>(1));
+        otheta_list[i].resize(m_list[i], std::vector<double>(1));
         
-
-        snn_list[i].resize(nd*mh_list[i],1);
-        sid_list[i].resize(nd*mh_list[i], std::vector<int>(1));
-        svar_list[i].resize(nd*mh_list[i], std::vector<int>(1));
-        sc_list[i].resize(nd*mh_list[i], std::vector<int>(1));
-        stheta_list[i].resize(nd*mh_list[i], std::vector<double>(1));
-        if(i>0){
-            //fambm_list[i-1] = new brtMethodWrapper(&brt::f,*ambm_list[i-1]);
-            //fpsbm_list[i-1] = new brtMethodWrapper(&brt::f,*psbm_list[i-1]);
-        }
+        snn_list[i].resize(mh_list[i],1);
+        sid_list[i].resize(mh_list[i], std::vector<int>(1));
+        svar_list[i].resize(mh_list[i], std::vector<int>(1));
+        sc_list[i].resize(mh_list[i], std::vector<int>(1));
+        stheta_list[i].resize(mh_list[i], std::vector<double>(1));
+        fitname_list[i] = (i==0) ? folder + modelname + ".fitmix" : folder + modelname + ".fitemulate" + std::to_string(i);
      }
 
     // dinfo for predictions
@@ -862,13 +980,16 @@ int main(int argc, char* argv[])
     std::vector<double*> fmix_list(nummodels);
     for(int i=0;i<nummodels;i++){
         // Initialize class objects
-        if(mpirank > 0){
+        if(hasrows){
             fmix_list[i] = new double[nvec[0]];
             dimix_list[i].y=fmix_list[i];
             dimix_list[i].p = pvec[i+1]; 
             dimix_list[i].n=nvec[0];
             dimix_list[i].tc=1;
             dimix_list[i].x = &xf_list[i][0];
+            //the field obs are the last nvec[0] rows of x_list[i+1]
+            if(dinfo_list[i+1].xb8) dimix_list[i].xb8 = dinfo_list[i+1].xb8 + (nvec[i+1]-nvec[0])*pvec[i+1];
+            if(dinfo_list[i+1].xb16) dimix_list[i].xb16 = dinfo_list[i+1].xb16 + (nvec[i+1]-nvec[0])*pvec[i+1];
         }else{
             fmix_list[i] = NULL;
             dimix_list[i].y = NULL;
@@ -881,20 +1002,70 @@ int main(int argc, char* argv[])
 
     // Items used to extract weights from the mix bart model
     mxd wts_iter; //matrix to store current set of weights
-    std::vector<double> mixprednotj;
+    std::vector<double> mixpred; //mixed prediction at the field obs
     
     double *fw = NULL;
     dinfo diw;
-    if(mpirank>0){
+    if(hasrows){
         // Resize objects and define diw
         wts_iter.resize(nummodels+1,nvec[0]);
-        mixprednotj.resize(nvec[0],0);
+        mixpred.resize(nvec[0],0);
         fw = new double[nvec[0]];
         diw.x = &x_list[0][0]; diw.y=fw; diw.p = pvec[0]; diw.n=nvec[0]; diw.tc=1;
+        diw.xb8 = dinfo_list[0].xb8; diw.xb16 = dinfo_list[0].xb16;
     }else{
         diw.x = NULL; diw.y=NULL; diw.p = pvec[0]; diw.n=0; diw.tc=1;
     }
 
+    //checkpoint contents
+    std::string chkfile=folder + modelname + ".chk" + std::to_string(mpirank);
+    std::vector<brt*> chkmods={&axb,&pxb};
+    chkarrays chkarrs;
+    for(int j=0;j<=nummodels;j++){
+        if(j>0){
+            chkmods.push_back(ambm_list[j-1]);
+            chkmods.push_back(psbm_list[j-1]);
+        }
+        chkarrs.push_back({&y_list[j][0],y_list[j].size()});
+        chkarrs.push_back({&sigmav_list[j][0],sigmav_list[j].size()});
+        chkarrs.push_back({r_list[j],dips_list[j].n});
+        for(size_t i=0;i<chgv_list[j].size();i++) chkarrs.push_back({&chgv_list[j][i][0],chgv_list[j][i].size()});
+    }
+    std::vector<fitwriter*> chkfws;
+    std::vector<std::ofstream*> chkofs;
+    if(mpirank==0){
+        for(int j=0;j<=nummodels;j++){ chkfws.push_back(&fw_list[j]); chkofs.push_back(&omf_list[j]); }
+    }else{
+        fitname_list.clear();
+    }
+    size_t it0=0;  //iterations already done, when resuming
+    if(resume) {
+        bool ok=loadchk(chkfile,it0,gen,chkmods,chkarrs,chkfws,chkofs,fitname_list);
+#ifdef _OPENMPI
+        //every process has to be able to resume, and from the same iteration
+        unsigned long chk[3]={ok ? 1UL : 0UL, (unsigned long)it0, ~(unsigned long)it0}, chkmin[3];
+        MPI_Allreduce(chk,chkmin,3,MPI_UNSIGNED_LONG,MPI_MIN,MPI_COMM_WORLD);
+        ok=(chkmin[0]==1 && chkmin[1]==~chkmin[2]);
+#endif
+        if(!ok) {
+            if(mpirank==0) cout << "Error: can't resume from checkpoint " << folder + modelname + ".chk" << endl;
+#ifdef _OPENMPI
+            MPI_Finalize();
+#endif
+            return 1;
+        }
+        if(mpirank==0) cout << "Resuming after iteration " << it0 << endl;
+    }
+    else if(mpirank==0) {
+        for(int j=0;j<=nummodels;j++){
+            omf_list[j].open(fitname_list[j],std::ios::binary);
+            fw_list[j].begin(omf_list[j],nd,m_list[j],mh_list[j],(j==0) ? nummodels+1 : 1);
+        }
+    }
+    size_t adapt0=std::min(it0,nadapt);
+    size_t burn0=std::min(it0-adapt0,nburn);
+    size_t draw0=it0-adapt0-burn0;
+
     // Start the MCMC
 #ifdef _OPENMPI
     double tstart=0.0,tend=0.0;
@@ -905,7 +1076,7 @@ int main(int argc, char* argv[])
 #endif
 
     // Initialize finfo using predictions from each emulator
-    if(mpirank > 0){
+    if(hasrows){
         for(int j=0;j<nummodels;j++){
             ambm_list[j]->predict(&dimix_list[j]);
             for(size_t k=0;k<dimix_list[j].n;k++){
@@ -916,104 +1087,66 @@ int main(int argc, char* argv[])
 
     // Adapt Stage in the MCMC
     diterator diter0(&dips_list[0]);
-    for(size_t i=0;i<nadapt;i++) { 
+    for(size_t i=adapt0;i<nadapt;i++) { 
         // Print adapt step number
         if((i % printevery) ==0 && mpirank==0) cout << "Adapt iteration " << i << endl;
 #ifdef _OPENMPI  
         // Model Mixing step
+        axb.updatefi(); //the emulator columns of fi changed since the last draw
         if(mpirank==0){axb.drawvec(gen);} else {axb.drawvec_mpislave(gen);}
-        // Get the current model mixing weights   
-        if(mpirank>0){
-            // draw new weight matrix
-            wts_iter = mxd::Zero(nummodels+1,dimix_list[0].n); //resets wt matrix
-            axb.get_mix_wts(&diw, &wts_iter);  
+        // Get the current model mixing weights and the mixed prediction at the field obs
+        if(hasrows){
+            axb.get_mix_wts(&diw, &wts_iter);
+            setmixpred(fi,wts_iter,mixpred,ditc);
         } 
         
         //Emulation Steps
         for(int j=0;j<nummodels;j++){
             // Get re-weighted field observations
-            if(mpirank > 0){
-                // rest mixprednotj
-                mixprednotj.clear();
-                mixprednotj.resize(dimix_list[0].n, 0);
-                for(int k=0;k<nummodels;k++){    
-                    // Get the mixed prediction
-                    if(k!=j){
-                        for(size_t l=0;l<dimix_list[j].n;l++){
-                            mixprednotj[l] = mixprednotj[l] + fi(l,k+1)*wts_iter(k+1,l);  
-                            //if(i%1000 == 0)cout << "mixprednotj[l] = " << mixprednotj[l] << endl;
-                        }
-                    }
-                }
-                // add the discrepancy and get the weighted field obs
-                for(size_t l=0;l<dimix_list[j].n;l++){
-                    mixprednotj[l] = mixprednotj[l] + wts_iter(0,l);
-                    y_list[j+1][nvec[j+1] - nvec[0] + l] = (y_list[0][l] - mixprednotj[l])/wts_iter(j+1,l) - means_list[j+1];
-                    //cout << "wts_iter(j+1,l) = " << wts_iter(j+1,l) << "---- y_list[j+1][nvec[j+1] - nvec[0] + l] = " << y_list[j+1][nvec[j+1]- nvec[0] + l] << endl;
-                    // Now update the appropriate sigmav_list[j+1] entries where the last nvec[0] entries are reweighted field obs
-                    sigmav_list[j+1][nvec[j+1]-nvec[0]+l] = sigmav_list[0][l]/wts_iter(j+1,l);
-                    //if(i%1000 == 0)cout << "y_list[j+1][nvec[j+1]- nvec[0] + l] = " << y_list[j+1][nvec[j+1]- nvec[0] + l] << endl;
-                }
+            if(hasrows){
+                tempn = nvec[j+1]-nvec[0]; //the field obs are the last nvec[0] entries
+                setemufield(j,fi,wts_iter,mixpred,&y_list[0][0],&sigmav_list[0][0],means_list[j+1],
+                            &y_list[j+1][tempn],&sigmav_list[j+1][tempn],ditc);
             }
             
             // Update emulator
             if(mpirank==0){ambm_list[j]->draw(gen);} else {ambm_list[j]->draw_mpislave(gen);}
             
-            if(mpirank>0){
-                //Update finfo column 
+            if(hasrows){
+                //Update finfo column and the mixed prediction
                 ambm_list[j]->predict(&dimix_list[j]);
-                for(size_t l=0;l<dimix_list[j].n;l++){
-                    fi(l,j+1) = fmix_list[j][l] + means_list[j+1]; // f_mix is only K dimensional -- hence using j as its index
-                    //cout << "fi(l,j+1) = " << fi(l,j+1) << endl; 
-                }
+                setemufi(j,fmix_list[j],means_list[j+1],fi,wts_iter,mixpred,ditc);
             }           
         } 
 #else
         // Model Mixing step
+        axb.updatefi(); //the emulator columns of fi changed since the last draw
         axb.drawvec(gen);
         
-        // Get the current model mixing weights    
-        wts_iter = mxd::Zero(nummodels+1,dimix_list[0].n); //resets wt matrix
-        axb.get_mix_wts(&diw, &wts_iter);  
+        // Get the current model mixing weights and the mixed prediction at the field obs
+        axb.get_mix_wts(&diw, &wts_iter);
+        setmixpred(fi,wts_iter,mixpred,ditc);
 
         // Emulation Steps
         for(int j=0;j<nummodels;j++){
-            // reset mixprednotj
-            mixprednotj.clear();
-            mixprednotj.resize(dimix_list[0].n, 0);
-
-            for(int k=0;k<nummodels;k++){
-                // Get the mixed prediction
-                if(k!=j){
-                    for(int l=0;l<nvec[0];l++){
-                        mixprednotj[l] = mixprednotj[l] + fi(l,k+1)*wts_iter(k+1,l);  
-                    }
-                }
-            }
-            
-            // add the discrepancy and get the weighted field obs
-            for(int l=0;l<nvec[0];l++){
-                mixprednotj[l] = mixprednotj[l] + wts_iter(0,l);
-                y_list[j+1][nvec[j+1] + l] = (y_list[0][l] - mixprednotj[l])/wts_iter(j+1,l)- means_list[j+1];
-                // Now update the appropriate sigmav_list[j+1] entries where the last nvec[0] entries are reweighted field obs
-                sigmav_list[j+1][nvec[j+1]-nvec[0]+l] = sigmav_list[0][l]/wts_iter(j+1,l);
-            }
-            ambm_list[j]->drawvec(gen);
+            // Get re-weighted field observations
+            tempn = nvec[j+1]-nvec[0]; //the field obs are the last nvec[0] entries
+            setemufield(j,fi,wts_iter,mixpred,&y_list[0][0],&sigmav_list[0][0],means_list[j+1],
+                        &y_list[j+1][tempn],&sigmav_list[j+1][tempn],ditc);
+            ambm_list[j]->draw(gen);
             
-            // Update finfo column
+            // Update finfo column and the mixed prediction
             ambm_list[j]->predict(&dimix_list[j]);
-            for(int l=0;l<nvec[0];l++){
-                fi(l,j+1) = fmix_list[j][l] + means_list[j+1]; 
-            }
+            setemufi(j,fmix_list[j],means_list[j+1],fi,wts_iter,mixpred,ditc);
         }
 #endif
-    // *** Think about moving this into mpi sections since we use mpirank > 0 below
+    // *** Think about moving this into mpi sections since we use hasrows below
         // Set dinfo objecs for the variance
         for(int j=0;j<=nummodels;j++){
             //dips_list[j] = dinfo_list[j];
             if(j>0){
                 // Emulators
-                if(mpirank>0){
+                if(hasrows){
                     ambm_list[j-1]->predict(&dips_list[j]);
                     for(size_t l=0;l<dips_list[j].n;l++){r_list[j][l] = y_list[j][l] - r_list[j][l];}    
                     //dips_list[j] -= dinfo_list[j]; // Get residuals
@@ -1062,92 +1195,63 @@ int main(int argc, char* argv[])
             }
             
         }
+        if(chkevery && (i+1)%chkevery==0)
+            savechk(chkfile,i+1,gen,chkmods,chkarrs,chkfws);
     }
 
 
     // Burn-in Stage in the MCMC
-    for(size_t i=0;i<nburn;i++) { 
+    for(size_t i=burn0;i<nburn;i++) { 
         // Print burn step number
         if((i % printevery) ==0 && mpirank==0) cout << "Burn iteration " << i << endl;
 #ifdef _OPENMPI  
         // Model Mixing step
+        axb.updatefi(); //the emulator columns of fi changed since the last draw
         if(mpirank==0){axb.drawvec(gen);} else {axb.drawvec_mpislave(gen);}
-        // Get the current model mixing weights   
-        if(mpirank>0){
-            wts_iter = mxd::Zero(nummodels+1,dimix_list[0].n); //resets wt matrix
-            axb.get_mix_wts(&diw, &wts_iter);  
+        // Get the current model mixing weights and the mixed prediction at the field obs
+        if(hasrows){
+            axb.get_mix_wts(&diw, &wts_iter);
+            setmixpred(fi,wts_iter,mixpred,ditc);
         } 
         
         //Emulation Steps
         for(int j=0;j<nummodels;j++){
             // Get re-weighted field observations
-            if(mpirank > 0){
-                // rest mixprednotj
-                mixprednotj.clear();
-                mixprednotj.resize(dimix_list[0].n, 0);
-                for(int k=0;k<nummodels;k++){    
-                    // Get the mixed prediction
-                    if(k!=j){
-                        for(size_t l=0;l<dimix_list[j].n;l++){
-                            mixprednotj[l] = mixprednotj[l] + fi(l,k+1)*wts_iter(k+1,l);  
-                            //cout << "mixprednotj[l] = " << mixprednotj[l] << endl;
-                        }
-                    }
-                }
-                // add the discrepancy and get the weighted field obs
-                for(size_t l=0;l<dimix_list[j].n;l++){
-                    mixprednotj[l] = mixprednotj[l] + wts_iter(0,l);
-                    y_list[j+1][nvec[j+1] - nvec[0] + l] = (y_list[0][l] - mixprednotj[l])/wts_iter(j+1,l)- means_list[j+1];
-                    // Now update the appropriate sigmav_list[j+1] entries where the last nvec[0] entries are reweighted field obs
-                    sigmav_list[j+1][nvec[j+1]-nvec[0]+l] = sigmav_list[0][l]/wts_iter(j+1,l);
-                }
+            if(hasrows){
+                tempn = nvec[j+1]-nvec[0]; //the field obs are the last nvec[0] entries
+                setemufield(j,fi,wts_iter,mixpred,&y_list[0][0],&sigmav_list[0][0],means_list[j+1],
+                            &y_list[j+1][tempn],&sigmav_list[j+1][tempn],ditc);
             }
             
             // Update emulator
             if(mpirank==0){ambm_list[j]->draw(gen);} else {ambm_list[j]->draw_mpislave(gen);}
-            if(mpirank>0){
-                //Update finfo column 
+            
+            if(hasrows){
+                //Update finfo column and the mixed prediction
                 ambm_list[j]->predict(&dimix_list[j]);
-                for(size_t l=0;l<dimix_list[j].n;l++){
-                    fi(l,j+1) = fmix_list[j][l] + means_list[j+1];
-                    //cout << "fi(l,j+1) = " << fi(l,j+1) << endl; 
-                }
+                setemufi(j,fmix_list[j],means_list[j+1],fi,wts_iter,mixpred,ditc);
             }           
         } 
 #else
         // Model Mixing step
+        axb.updatefi(); //the emulator columns of fi changed since the last draw
         axb.drawvec(gen);
         
-        // Get the current model mixing weights    
-        wts_iter = mxd::Zero(nummodels+1,dimix_list[0].n); //resets wt matrix
-        axb.get_mix_wts(&diw, &wts_iter);  
+        // Get the current model mixing weights and the mixed prediction at the field obs
+        axb.get_mix_wts(&diw, &wts_iter);
+        setmixpred(fi,wts_iter,mixpred,ditc);
 
         // Emulation Steps
         for(int j=0;j<nummodels;j++){
-            // rest mixprednotj
-            mixprednotj.clear();
-            mixprednotj.resize(dimix_list[0].n, 0);
-            for(int k=0;k<nummodels;k++){
-                // Get the mixed prediction
-                if(k!=j){
-                    for(int l=0;l<nvec[0];l++){
-                        mixprednotj[l] = mixprednotj[l] + fi(l,k+1)*wts_iter(k+1,l);  
-                    }
-                }
-            }
-            // add the discrepancy and get the weighted field obs
-            for(int l=0;l<nvec[0];l++){
-                mixprednotj[l] = mixprednotj[l] + wts_iter(0,l);
-                y_list[j+1][nvec[j+1] + l] = (y_list[0][l] - mixprednotj[l])/wts_iter(j+1,l)- means_list[j+1];
-                sigmav_list[j+1][nvec[j+1]-nvec[0]+l] = sigmav_list[0][l]/wts_iter(j+1,l);
-            }
-            ambm_list[j]->drawvec(gen);
+            // Get re-weighted field observations
+            tempn = nvec[j+1]-nvec[0]; //the field obs are the last nvec[0] entries
+            setemufield(j,fi,wts_iter,mixpred,&y_list[0][0],&sigmav_list[0][0],means_list[j+1],
+                        &y_list[j+1][tempn],&sigmav_list[j+1][tempn],ditc);
+            ambm_list[j]->draw(gen);
             
-            // Update finfo column
+            // Update finfo column and the mixed prediction
             ambm_list[j]->predict(&dimix_list[j]);
-            for(int l=0;l<nvec[0];l++){
-                fi(l,j+1) = fmix_list[j][l] + means_list[j+1]; 
-            }
+            setemufi(j,fmix_list[j],means_list[j+1],fi,wts_iter,mixpred,ditc);
         }
 #endif
         // Set dinfo objecs for the variance
@@ -1155,7 +1259,7 @@ int main(int argc, char* argv[])
             //dips_list[j] = dinfo_list[j];
             if(j>0){
                 // Emulators
-                if(mpirank>0){
+                if(hasrows){
                     ambm_list[j-1]->predict(&dips_list[j]);
                     for(size_t l=0;l<dips_list[j].n;l++){r_list[j][l] = y_list[j][l] - r_list[j][l];}
                     //dips_list[j] -= dinfo_list[j];
@@ -1199,89 +1303,61 @@ int main(int argc, char* argv[])
             }
             
         }
+        if(chkevery && (nadapt+i+1)%chkevery==0)
+            savechk(chkfile,nadapt+i+1,gen,chkmods,chkarrs,chkfws);
     }
 
-    for(size_t i=0;i<nd;i++) { 
+    for(size_t i=draw0;i<nd;i++) { 
         // Print burn step number
         if((i % printevery) ==0 && mpirank==0) cout << "Draw iteration " << i << endl;
 #ifdef _OPENMPI  
         // Model Mixing step
+        axb.updatefi(); //the emulator columns of fi changed since the last draw
         if(mpirank==0){axb.drawvec(gen);} else {axb.drawvec_mpislave(gen);}
-        // Get the current model mixing weights   
-        if(mpirank>0){
-            wts_iter = mxd::Zero(nummodels+1,dimix_list[0].n); //resets wt matrix
-            axb.get_mix_wts(&diw, &wts_iter);  
+        // Get the current model mixing weights and the mixed prediction at the field obs
+        if(hasrows){
+            axb.get_mix_wts(&diw, &wts_iter);
+            setmixpred(fi,wts_iter,mixpred,ditc);
         } 
         
         //Emulation Steps
         for(int j=0;j<nummodels;j++){
             // Get re-weighted field observations
-            if(mpirank > 0){
-                // rest mixprednotj
-                mixprednotj.clear();
-                mixprednotj.resize(dimix_list[0].n, 0);
-                for(int k=0;k<nummodels;k++){    
-                    // Get the mixed prediction
-                    if(k!=j){
-                        for(size_t l=0;l<dimix_list[j].n;l++){
-                            mixprednotj[l] = mixprednotj[l] + fi(l,k+1)*wts_iter(k+1,l);  
-                            //cout << "mixprednotj[l] = " << mixprednotj[l] << endl;
-                        }
-                    }
-                }
-                // add the discrepancy and get the weighted field obs
-                for(size_t l=0;l<dimix_list[j].n;l++){
-                    mixprednotj[l] = mixprednotj[l] + wts_iter(0,l);
-                    y_list[j+1][nvec[j+1] - nvec[0] + l] = (y_list[0][l] - mixprednotj[l])/wts_iter(j+1,l)- means_list[j+1];
-                    sigmav_list[j+1][nvec[j+1]-nvec[0]+l] = sigmav_list[0][l]/wts_iter(j+1,l);
-                }
+            if(hasrows){
+                tempn = nvec[j+1]-nvec[0]; //the field obs are the last nvec[0] entries
+                setemufield(j,fi,wts_iter,mixpred,&y_list[0][0],&sigmav_list[0][0],means_list[j+1],
+                            &y_list[j+1][tempn],&sigmav_list[j+1][tempn],ditc);
             }
             
             // Update emulator
             if(mpirank==0){ambm_list[j]->draw(gen);} else {ambm_list[j]->draw_mpislave(gen);}
-            if(mpirank>0){
-                //Update finfo column 
+            
+            if(hasrows){
+                //Update finfo column and the mixed prediction
                 ambm_list[j]->predict(&dimix_list[j]);
-                for(size_t l=0;l<dimix_list[j].n;l++){
-                    fi(l,j+1) = fmix_list[j][l] + means_list[j+1];
-                    //cout << "fi(l,j+1) = " << fi(l,j+1) << endl; 
-                }
+                setemufi(j,fmix_list[j],means_list[j+1],fi,wts_iter,mixpred,ditc);
             }           
         } 
 #else
         // Model Mixing step
+        axb.updatefi(); //the emulator columns of fi changed since the last draw
         axb.drawvec(gen);
         
-        // Get the current model mixing weights    
-        wts_iter = mxd::Zero(nummodels+1,dimix_list[0].n); //resets wt matrix
-        axb.get_mix_wts(&diw, &wts_iter);  
+        // Get the current model mixing weights and the mixed prediction at the field obs
+        axb.get_mix_wts(&diw, &wts_iter);
+        setmixpred(fi,wts_iter,mixpred,ditc);
 
         // Emulation Steps
         for(int j=0;j<nummodels;j++){
-            // rest mixprednotj
-            mixprednotj.clear();
-            mixprednotj.resize(dimix_list[0].n, 0);
-            for(int k=0;k<nummodels;k++){
-                // Get the mixed prediction
-                if(k!=j){
-                    for(int l=0;l<nvec[0];l++){
-                        mixprednotj[l] = mixprednotj[l] + fi(l,k+1)*wts_iter(k+1,l);  
-                    }
-                }
-            }
-            // add the discrepancy and get the weighted field obs
-            for(int l=0;l<nvec[0];l++){
-                mixprednotj[l] = mixprednotj[l] + wts_iter(0,l);
-                y_list[j+1][nvec[j+1] + l] = (y_list[0][l] - mixprednotj[l])/wts_iter(j+1,l)- means_list[j+1];
-                sigmav_list[j+1][nvec[j+1]-nvec[0]+l] = sigmav_list[0][l]/wts_iter(j+1,l);
-            }
-            ambm_list[j]->drawvec(gen);
+            // Get re-weighted field observations
+            tempn = nvec[j+1]-nvec[0]; //the field obs are the last nvec[0] entries
+            setemufield(j,fi,wts_iter,mixpred,&y_list[0][0],&sigmav_list[0][0],means_list[j+1],
+                        &y_list[j+1][tempn],&sigmav_list[j+1][tempn],ditc);
+            ambm_list[j]->draw(gen);
             
-            // Update finfo column
+            // Update finfo column and the mixed prediction
             ambm_list[j]->predict(&dimix_list[j]);
-            for(int l=0;l<nvec[0];l++){
-                fi(l,j+1) = fmix_list[j][l] + means_list[j+1]; 
-            }
+            setemufi(j,fmix_list[j],means_list[j+1],fi,wts_iter,mixpred,ditc);
         }
 #endif
         // Set dinfo objecs for the variance
@@ -1289,7 +1365,7 @@ int main(int argc, char* argv[])
             //dips_list[j] = dinfo_list[j];
             if(j>0){
                 // Emulators
-                if(mpirank>0){
+                if(hasrows){
                     ambm_list[j-1]->predict(&dips_list[j]);
                     for(size_t l=0;l<dips_list[j].n;l++){r_list[j][l] = y_list[j][l] - r_list[j][l];}
                     //dips_list[j] -= dinfo_list[j];
@@ -1336,16 +1412,22 @@ int main(int argc, char* argv[])
         }
 
 
-        // Save Tree to vector format
+        // Save Tree to vector format and write the draw out
         if(mpirank==0) {
             //axb.pr_vec();
-            axb.savetree_vec(i,m_list[0],onn_list[0],oid_list[0],ovar_list[0],oc_list[0],otheta_list[0]); 
-            pxb.savetree(i,mh_list[0],snn_list[0],sid_list[0],svar_list[0],sc_list[0],stheta_list[0]);
+            axb.savetree_vec(0,m_list[0],onn_list[0],oid_list[0],ovar_list[0],oc_list[0],otheta_list[0]); 
+            pxb.savetree(0,mh_list[0],snn_list[0],sid_list[0],svar_list[0],sc_list[0],stheta_list[0]);
             for(int j=1;j<=nummodels;j++){
-                ambm_list[j-1]->savetree(i,m_list[j],onn_list[j],oid_list[j],ovar_list[j],oc_list[j],otheta_list[j]);
-                psbm_list[j-1]->savetree(i,mh_list[j],snn_list[j],sid_list[j],svar_list[j],sc_list[j],stheta_list[j]); 
+                ambm_list[j-1]->savetree(0,m_list[j],onn_list[j],oid_list[j],ovar_list[j],oc_list[j],otheta_list[j]);
+                psbm_list[j-1]->savetree(0,mh_list[j],snn_list[j],sid_list[j],svar_list[j],sc_list[j],stheta_list[j]); 
+            }
+            for(int j=0;j<=nummodels;j++){
+                fw_list[j].adddraw(0,oid_list[j],ovar_list[j],oc_list[j],otheta_list[j],sid_list[j],svar_list[j],sc_list[j],stheta_list[j]);
+                omf_list[j].flush();
             }
         }
+        if(chkevery && (nadapt+nburn+i+1)%chkevery==0)
+            savechk(chkfile,nadapt+nburn+i+1,gen,chkmods,chkarrs,chkfws);
     }
 
 // Writing data to output files
@@ -1355,109 +1437,27 @@ int main(int argc, char* argv[])
     cout << "Training time was " << (tend-tstart)/60.0 << " minutes." << endl;
     }
 #endif
-    //Flatten posterior trees to a few (very long) vectors so we can just pass pointers
-    //to these vectors back to R (which is much much faster than copying all the data back).
+    //Finish the posterior tree files -- the emulator blocks are put together in .fitemulate.
     if(mpirank==0) {
         cout << "Returning posterior, please wait...";
-        // Instantiate containers
-        std::vector<std::vector<int>*> e_ots(nummodels+1); //=new std::vector<int>(nd*m);
-        std::vector<std::vector<int>*> e_oid(nummodels+1); //=new std::vector<int>;
-        std::vector<std::vector<int>*> e_ovar(nummodels+1); //=new std::vector<int>;
-        std::vector<std::vector<int>*> e_oc(nummodels+1); //=new std::vector<int>;
-        std::vector<std::vector<double>*> e_otheta(nummodels+1); //=new std::vector<double>;
-        std::vector<std::vector<int>*> e_sts(nummodels+1); //=new std::vector<int>(nd*mh);
-        std::vector<std::vector<int>*> e_sid(nummodels+1); //=new std::vector<int>;
-        std::vector<std::vector<int>*> e_svar(nummodels+1); //=new std::vector<int>;
-        std::vector<std::vector<int>*> e_sc(nummodels+1); //=new std::vector<int>;
-        std::vector<std::vector<double>*> e_stheta(nummodels+1); //=new std::vector<double>;
-
-        // Initialize containers with pointers
         for(int j=0;j<=nummodels;j++){
-            e_ots[j]=new std::vector<int>(nd*m_list[j]);
-            e_oid[j]=new std::vector<int>;
-            e_ovar[j]=new std::vector<int>;
-            e_oc[j]=new std::vector<int>;
-            e_otheta[j]=new std::vector<double>;
-            e_sts[j]=new std::vector<int>(nd*mh_list[j]);
-            e_sid[j]=new std::vector<int>;
-            e_svar[j]=new std::vector<int>;
-            e_sc[j]=new std::vector<int>;
-            e_stheta[j]=new std::vector<double>;
+            fw_list[j].end();
+            omf_list[j].close();
         }
+        if(fittext) fittotext(fitname_list[0]);
 
-        // Loop through each model and store in appropriate outfile 
-        for(size_t i=0;i<nd;i++)
-            for(int l=0;l<=nummodels;l++) {
-                m = m_list[l];
-                for(size_t j=0;j<m;j++){ 
-                    e_ots[l]->at(i*m+j)=static_cast<int>(oid_list[l][i*m+j].size());
-                    e_oid[l]->insert(e_oid[l]->end(),oid_list[l][i*m+j].begin(),oid_list[l][i*m+j].end());
-                    e_ovar[l]->insert(e_ovar[l]->end(),ovar_list[l][i*m+j].begin(),ovar_list[l][i*m+j].end());
-                    e_oc[l]->insert(e_oc[l]->end(),oc_list[l][i*m+j].begin(),oc_list[l][i*m+j].end());
-                    e_otheta[l]->insert(e_otheta[l]->end(),otheta_list[l][i*m+j].begin(),otheta_list[l][i*m+j].end());
-                }
-            }
-        for(size_t i=0;i<nd;i++)
-            for(int l=0;l<=nummodels;l++) {
-                mh = mh_list[l];
-                for(size_t j=0;j<mh;j++){
-                    e_sts[l]->at(i*mh+j)=static_cast<int>(sid_list[l][i*mh+j].size());
-                    e_sid[l]->insert(e_sid[l]->end(),sid_list[l][i*mh+j].begin(),sid_list[l][i*mh+j].end());
-                    e_svar[l]->insert(e_svar[l]->end(),svar_list[l][i*mh+j].begin(),svar_list[l][i*mh+j].end());
-                    e_sc[l]->insert(e_sc[l]->end(),sc_list[l][i*mh+j].begin(),sc_list[l][i*mh+j].end());
-                    e_stheta[l]->insert(e_stheta[l]->end(),stheta_list[l][i*mh+j].begin(),stheta_list[l][i*mh+j].end());
-                }
-            }
-
-        //write out to file
-        std::ofstream omf;
-        std::string ofile;
-        //std::ofstream omf_mix(folder + modelname + ".fitmix");
-        //std::ofstream omf_emu(folder + modelname + ".fitemu");
-        
-        for(int j=0;j<=nummodels;j++){
-            // Open the mixing for emulation file
-            if(j == 0){
-                ofile = folder + modelname + ".fitmix";
-                omf.open(ofile);
-                cout << "Saving mixing trees..." << endl;
-            }else if(j == 1){
-                ofile = folder + modelname + ".fitemulate";
-                omf.open(ofile); //opened at first emulator -- kept open until very end
-                cout << "Saving emulation trees..." << endl;
-            }
-
-            omf << nd << endl;
-            omf << m_list[j] << endl;
-            omf << mh_list[j] << endl;
-            omf << e_ots[j]->size() << endl;
-            for(size_t i=0;i<e_ots[j]->size();i++) omf << e_ots[j]->at(i) << endl;
-            omf << e_oid[j]->size() << endl;
-            for(size_t i=0;i<e_oid[j]->size();i++) omf << e_oid[j]->at(i) << endl;
-            omf << e_ovar[j]->size() << endl;
-            for(size_t i=0;i<e_ovar[j]->size();i++) omf << e_ovar[j]->at(i) << endl;
-            omf << e_oc[j]->size() << endl;
-            for(size_t i=0;i<e_oc[j]->size();i++) omf << e_oc[j]->at(i) << endl;
-            omf << e_otheta[j]->size() << endl;
-            for(size_t i=0;i<e_otheta[j]->size();i++) omf << std::scientific << e_otheta[j]->at(i) << endl;
-            omf << e_sts[j]->size() << endl;
-            for(size_t i=0;i<e_sts[j]->size();i++) omf << e_sts[j]->at(i) << endl;
-            omf << e_sid[j]->size() << endl;
-            for(size_t i=0;i<e_sid[j]->size();i++) omf << e_sid[j]->at(i) << endl;
-            omf << e_svar[j]->size() << endl;
-            for(size_t i=0;i<e_svar[j]->size();i++) omf << e_svar[j]->at(i) << endl;
-            omf << e_sc[j]->size() << endl;
-            for(size_t i=0;i<e_sc[j]->size();i++) omf << e_sc[j]->at(i) << endl;
-            omf << e_stheta[j]->size() << endl;
-            for(size_t i=0;i<e_stheta[j]->size();i++) omf << std::scientific << e_stheta[j]->at(i) << endl;
-            
-            // Close the mixing file before saving the emulation trees
-            if(j == 0){
-                omf.close();
+        if(nummodels>0){
+            std::string ofile = folder + modelname + ".fitemulate";
+            std::ofstream omf(ofile,std::ios::binary);
+            for(int j=1;j<=nummodels;j++){
+                std::ifstream imf(fitname_list[j],std::ios::binary);
+                omf << imf.rdbuf();
+                imf.close();
+                std::remove(fitname_list[j].c_str());
             }
+            omf.close();
+            if(fittext) fittotext(ofile);
         }
-        // Close the emulation text file
-        omf.close();
         cout << " done." << endl;
     }
     //-------------------------------------------------- 
@@ -22,6 +22,8 @@
 #include "tnorm.h"
 #include "mxbrt.h"
 #include "amxbrt.h"
+#include "fitio.h"
+#include "flatforest.h"
 
 using std::cout;
 using std::endl;
@@ -231,56 +233,27 @@ int main(int argc, char* argv[])
    }
 
    //--------------------------------------------------
-   //Set up model objects and MCMC
-   //--------------------------------------------------    
-   ambrt *ambm_list[nummodels]; //additive mean bart emulators
-   psbrt *psbm_list[nummodels]; //product variance for bart emulators
-   amxbrt axb(m_list[0]); // additive mean mixing bart
-   psbrt pxb(mh_list[0]); //product model for mixing variance
+   //finfo matrix for the mixing predictions
+   //--------------------------------------------------
    finfo fi;
-
-   //finfo matrix
    fi = mxd::Ones(np, nummodels+1); //dummy initialize to matrix of 1's -- n0 x K+1 (1st column is discrepancy)
-   
-   //Initialie the model mixing related objects
-   axb.setxi(&xi_list[0]);   
-   pxb.setxi(&xi_list[0]);
-   axb.setfi(&fi, nummodels+1);
 
-   // Initialize the emulators and associated variance models 
-   for(size_t i=0;i<nummodels;i++){
-      ambm_list[i] = new ambrt(m_list[i+1]);
-      ambm_list[i]->setxi(&xi_list[i+1]);
-      psbm_list[i] = new psbrt(mh_list[i+1]);
-      psbm_list[i]->setxi(&xi_list[i+1]);
-   }
    //--------------------------------------------
    // load files
    //--------------------------------------------
-   // Initialize containers
-   size_t temp=0;
-   std::vector<std::vector<int>> e_ots(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<int>> e_oid(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<int>> e_ovar(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<int>> e_oc(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<double>> e_otheta(nummodels+1, std::vector<double>(temp));
-   std::vector<std::vector<int>> e_sts(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<int>> e_sid(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<int>> e_svar(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<int>> e_sc(nummodels+1, std::vector<int>(temp));
-   std::vector<std::vector<double>> e_stheta(nummodels+1, std::vector<double>(temp));
-   std::vector<int> e_sstart(nummodels+1,0);
+   // The mixing trees are in .fitmix, the emulators are one block each in .fitemulate
+   fitfile fitmix, fitemu;
    size_t ind,im,imh;
-   std::ifstream imf;
 #ifndef SILENT
    if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
 #endif
+   bool fitok=fitmix.open(folder + modelname + ".fitmix");
+   if(fitok && nummodels>0) fitok=fitemu.open(folder + modelname + ".fitemulate");
    for(size_t j=0;j<=nummodels;j++){
-      if(j == 0){imf.open(folder + modelname + ".fitmix");}
-      if(j==1){imf.open(folder + modelname + ".fitemulate");}
-      imf >> ind;
-      imf >> im;
-      imf >> imh;
+      fitfile& ff=(j==0) ? fitmix : fitemu;
+      size_t b=(j==0) ? 0 : j-1;
+      ind=im=imh=0;
+      if(fitok && b<ff.nblock()) { ind=ff.nd(b); im=ff.m(b); imh=ff.mh(b); }
    #ifdef _OPENMPI
       if(nd!=ind) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
       if(m_list[j]!=im) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
@@ -290,129 +263,24 @@ int main(int argc, char* argv[])
       if(m_list[j]!=im) { cout << "Error loading posterior trees" << endl; return 0; }
       if(mh_list[j]!=imh) { cout << "Error loading posterior trees" << endl; return 0; }
    #endif
-      // Model Mixing object
-      imf >> temp;
-      e_ots[j].resize(temp);
-      for(size_t i=0;i<temp;i++)imf >> e_ots[j].at(i); 
-
-      imf >> temp;
-      e_oid[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_oid[j].at(i);
-
-      imf >> temp;
-      e_ovar[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_ovar[j].at(i);
-
-      imf >> temp;
-      e_oc[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_oc[j].at(i);
-
-      imf >> temp;
-      e_otheta[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_otheta[j].at(i);
-
-      imf >> temp;
-      e_sts[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_sts[j].at(i);
-
-      imf >> temp;
-      e_sid[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_sid[j].at(i);
-
-      imf >> temp;
-      e_svar[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_svar[j].at(i);
-
-      imf >> temp;
-      e_sc[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> e_sc[j].at(i);
-
-      imf >> temp;
-      e_stheta[j].resize(temp);
-      for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_stheta[j].at(i);
-
-      // close file if reading in model mixing data
-      if(j == 0){imf.close();}
-   
    }
-   // close file for emulation data
-   imf.close();
 
    //-------------------------------------------------
    // Setup containers for predictions 
    //-------------------------------------------------
    std::vector<std::vector<std::vector<double>>> tedraw_list(nummodels+1, std::vector<std::vector<double>>(nd, std::vector<double>(np)));
    std::vector<std::vector<std::vector<double>>> tedrawh_list(nummodels+1, std::vector<std::vector<double>>(nd, std::vector<double>(np)));
-   std::vector<double*> fp_list(nummodels+1);
    std::vector<dinfo> dip_list(nummodels+1);
    for(size_t j=0;j<=nummodels;j++){
-      fp_list[j] = new double[np];
-      dip_list[j].y=fp_list[j]; dip_list[j].p = p; dip_list[j].n=np; dip_list[j].tc=1;
+      dip_list[j].p = p; dip_list[j].n=np; dip_list[j].tc=1;
       if(j == 0){
          dip_list[j].x = &xp[0]; //mixing inputs
       }else{
          dip_list[j].x = &xc_list[j-1][0]; //emulator specific inputs
       }  
    }
-   
-   // Temporary vectors used for loading one model realization at a time.
-   /*
-   std::vector<int> onn(1,1);
-   std::vector<std::vector<int> > oid(1, std::vector<int>(1));
-   std::vector<std::vector<int> > ov(1, std::vector<int>(1));
-   std::vector<std::vector<int> > oc(1, std::vector<int>(1));
-   std::vector<std::vector<double> > otheta(1, std::vector<double>(1));
-   std::vector<int> snn(1,1);
-   std::vector<std::vector<int> > sid(1, std::vector<int>(1));
-   std::vector<std::vector<int> > sv(1, std::vector<int>(1));
-   std::vector<std::vector<int> > sc(1, std::vector<int>(1));
-   std::vector<std::vector<double> > stheta(1, std::vector<double>(1));
-   */
-
-   std::vector<std::vector<int>> onn(nummodels+1, std::vector<int>(nd,1));
-   std::vector<std::vector<std::vector<int>>> oid(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-   std::vector<std::vector<std::vector<int>>> ov(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-   std::vector<std::vector<std::vector<int>>> oc(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-   std::vector<std::vector<std::vector<double>>> otheta(nummodels+1, std::vector<std::vector<double>>(nd, std::vector<double>(1)));
-   std::vector<int> snn(1,1);
-   std::vector<std::vector<int> > sid(1, std::vector<int>(1));
-   std::vector<std::vector<int> > sv(1, std::vector<int>(1));
-   std::vector<std::vector<int> > sc(1, std::vector<int>(1));
-   std::vector<std::vector<double> > stheta(1, std::vector<double>(1));
-   /*
-   std::vector<std::vector<int>> snn(nummodels+1, std::vector<int>(nd,1));
-   std::vector<std::vector<std::vector<int>>> sid(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-   std::vector<std::vector<std::vector<int>>> sv(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-   std::vector<std::vector<std::vector<int>>> sc(nummodels+1, std::vector<std::vector<int>>(nd, std::vector<int>(1)));
-   std::vector<std::vector<std::vector<double>>> stheta(nummodels+1, std::vector<std::vector<double>>(nd, std::vector<double>(1)));
-   */
-
-   for(size_t k=0;k<=nummodels;k++){
-      // Reset sizes of containers
-      m = m_list[k];
-      mh = mh_list[k];
-      onn[k].resize(m,1);
-      oid[k].resize(m, std::vector<int>(1));
-      ov[k].resize(m, std::vector<int>(1));
-      oc[k].resize(m, std::vector<int>(1));
-      otheta[k].resize(m, std::vector<double>(1));
-      /*
-      snn[k].resize(mh,1);
-      sid[k].resize(mh, std::vector<int>(1));
-      sv[k].resize(mh, std::vector<int>(1));
-      sc[k].resize(mh, std::vector<int>(1));
-      stheta[k].resize(mh, std::vector<double>(1));
-      */
-   }
-      
-
 
    // Draw realizations of the posterior predictive.
-   std::vector<size_t> curdx(nummodels+1,0);
-   std::vector<size_t> cumdx(nummodels+1,0);
-   size_t cmdx = 0;
-   size_t crdx = 0;
-   size_t nt=1; //number of thetas
 #ifdef _OPENMPI
    double tstart=0.0,tend=0.0;
    if(mpirank==0) tstart=MPI_Wtime();
@@ -421,127 +289,41 @@ int main(int argc, char* argv[])
    //-------------------------------------------------
    // Get predictions 
    //-------------------------------------------------
-   // Mean trees first -- store all thetas from the text files and get predictions for emulators
-   if(mpirank==0) cout << "Drawing mean response from posterior predictive" << endl;
-   for(size_t i=0;i<nd;i++){      
-      for(size_t a=0;a<=nummodels;a++){curdx[a] = 0;}
-      for(size_t k=0;k<=nummodels;k++){
-         if(k==0){nt = nummodels+1;}else{nt = 1;}
-         for(size_t j=0;j<m_list[k];j++){
-            onn[k][j]=e_ots[k].at(i*m_list[k]+j);
-            oid[k][j].resize(onn[k][j]);
-            ov[k][j].resize(onn[k][j]);
-            oc[k][j].resize(onn[k][j]);
-            otheta[k][j].resize(onn[k][j]*nt);
-            // Loop through the nodes in a given tree
-            for(size_t l=0;l<(size_t)onn[k][j];l++) {
-               oid[k][j][l]=e_oid[k].at(cumdx[k]+curdx[k]+l);
-               ov[k][j][l]=e_ovar[k].at(cumdx[k]+curdx[k]+l);
-               oc[k][j][l]=e_oc[k].at(cumdx[k]+curdx[k]+l);
-               if(k==0){
-                  // Vector theta -- model mixing
-                  for(size_t r=0;r<nt;r++){otheta[k][j][l*nt+r]=e_otheta[k].at((cumdx[k]+curdx[k]+l)*nt+r);}
-               }else{
-                  // Scalar theta -- emulators
-                  otheta[k][j][l]=e_otheta[k].at(cumdx[k]+curdx[k]+l);
-               }
-            }
-            curdx[k]+=(size_t)onn[k][j];
-         }
-         cumdx[k]+=curdx[k];
-         // Load tree and draw relization
-         if(k == 0){
-            /*
-            axb.loadtree_vec(0,m_list[k],onn[k],oid[k],ov[k],oc[k],otheta[k]);
-            axb.predict_mix(&dip_list[k],&fi);
-            // Set prediction and update finfo
-            for(size_t j=0;j<np;j++){
-               tedraw_list[k][i][j] = fp_list[k][j];
-            }
-            */
-         }else{
-            ambm_list[k-1]->loadtree(0,m_list[k],onn[k],oid[k],ov[k],oc[k],otheta[k]);
-            ambm_list[k-1]->predict(&dip_list[k]);
+   // The draws are split into contiguous ranges over tc OpenMP threads.  Each
+   // worker has its own flattened model and finfo, and writes its draws
+   // straight into tedraw_list and tedrawh_list.
+   if(mpirank==0) cout << "Drawing mean and sd response from posterior predictive" << endl;
+#ifdef _OPENMP
+#  pragma omp parallel num_threads(tc)
+#endif
+   {
+      int beg=0,end=(int)nd;
+#ifdef _OPENMP
+      calcbegend((int)nd,omp_get_thread_num(),omp_get_num_threads(),&beg,&end);
+#endif
+      flatforest flat;
+      finfo fiw=fi;
+      for(size_t i=(size_t)beg;i<(size_t)end;i++){
+         // Mean trees first -- get predictions for emulators, which fill in finfo for the mixing predictions
+         for(size_t k=1;k<=nummodels;k++){
+            flat.set(fitemu.getens(i,k-1),xi_list[k]);
+            flat.predictsum(0,np,dip_list[k].p,dip_list[k].x,tedraw_list[k][i].data());
             // Set prediction and update finfo
             for(size_t j=0;j<np;j++){
-               tedraw_list[k][i][j] = fp_list[k][j] + means_list[k];
-               fi(j,k) = tedraw_list[k][i][j];
+               tedraw_list[k][i][j] += means_list[k];
+               fiw(j,k) = tedraw_list[k][i][j];
             }
          }
-         
-      }
-      // Now get the mixing predictions for the ith iteration of the mcmc
-      axb.loadtree_vec(0,m_list[0],onn[0],oid[0],ov[0],oc[0],otheta[0]);
-      axb.predict_mix(&dip_list[0],&fi);
-      for(size_t j=0;j<np;j++){
-         tedraw_list[0][i][j] = fp_list[0][j];
-      }
-   }
-   
-   // Now get Model Mixing Predictions using the emualtor results to update finfo
-   /*
-   for(size_t i=0;i<nd;i++){
-      // Set prediction and update finfo
-      for(size_t k=1;k<=nummodels;k++){
-         for(size_t j=0;j<np;j++){
-            fi(j,k) = tedraw_list[k][i][j];
-         }
-      }
-      
-      axb.loadtree_vec(0,m_list[0],onn[0],oid[0],ov[0],oc[0],otheta[0]);
-      axb.predict_mix(&dip_list[0],&fi);
-      // Set prediction and update finfo
-      for(size_t j=0;j<np;j++){
-         tedraw_list[0][i][j] = fp_list[0][j];
-      }      
-   }
-   */
-
-   // Variance trees third
-   if(mpirank==0) cout << "Drawing sd response from posterior predictive" << endl;
-   for(size_t k=0;k<=nummodels;k++){
-      // Set values
-      mh = mh_list[k];
-      cmdx=0;
-      crdx=0;
-
-      // Reset sizes of containers
-      snn.resize(mh,1);
-      sid.resize(mh, std::vector<int>(1));
-      sv.resize(mh, std::vector<int>(1));
-      sc.resize(mh, std::vector<int>(1));
-      stheta.resize(mh, std::vector<double>(1));
-      
-      for(size_t i=0;i<nd;i++) {
-         crdx=0;
-         for(size_t j=0;j<mh;j++) {
-            snn[j]=e_sts[k].at(i*mh+j);
-            sid[j].resize(snn[j]);
-            sv[j].resize(snn[j]);
-            sc[j].resize(snn[j]);
-            stheta[j].resize(snn[j]);
-            for(size_t l=0;l<(size_t)snn[j];l++) {
-               sid[j][l]=e_sid[k].at(cmdx+crdx+l);
-               sv[j][l]=e_svar[k].at(cmdx+crdx+l);
-               sc[j][l]=e_sc[k].at(cmdx+crdx+l);
-               stheta[j][l]=e_stheta[k].at(cmdx+crdx+l);
-            }
-            crdx+=(size_t)snn[j];
-         }
-         cmdx+=crdx;
-
-         if(k == 0){
-            // load tree and draw realization -- mixing variance
-            pxb.loadtree(0,mh,snn,sid,sv,sc,stheta);
-            pxb.predict(&dip_list[k]);
-            for(size_t j=0;j<np;j++) tedrawh_list[k][i][j] = fp_list[k][j];
-         }else{
-            // load tree and draw realization -- emulator variance
-            psbm_list[k-1]->loadtree(0,mh,snn,sid,sv,sc,stheta);
-            psbm_list[k-1]->predict(&dip_list[k]);
-            for(size_t j=0;j<np;j++) tedrawh_list[k][i][j] = fp_list[k][j];
+         // Now get the mixing predictions for the ith iteration of the mcmc
+         flat.set(fitmix.getens(i),xi_list[0]);
+         flat.predictmix(0,np,dip_list[0].p,dip_list[0].x,fiw,tedraw_list[0][i].data());
+
+         // Variance trees -- mixing variance (k=0) or emulator variance
+         for(size_t k=0;k<=nummodels;k++){
+            if(k==0) flat.set(fitmix.getsens(i),xi_list[0]);
+            else flat.set(fitemu.getsens(i,k-1),xi_list[k]);
+            flat.predictprod(0,np,dip_list[k].p,dip_list[k].x,tedrawh_list[k][i].data());
          }
-         
       }
    }
 
@@ -43,6 +43,8 @@
     #include "tnorm.h"
     #include "mxbrt.h"
     #include "amxbrt.h"
+    #include "fitio.h"
+    #include "flatforest.h"
 
     using std::cout;
     using std::endl;
@@ -190,21 +192,14 @@
         }
     #endif
 
-    //--------------------------------------------------
-    // set up amxbrt object
-    amxbrt axb(m); //Sets number of trees
-    axb.setk(k);
-    axb.setxi(&xi); //set the cutpoints for this model object
-    
     //load from file
     #ifndef SILENT
     if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
     #endif
     size_t ind,im,imh;
-    std::ifstream imf(folder + modelname + fitcore);
-    imf >> ind;
-    imf >> im;
-    imf >> imh;
+    fitfile imf;
+    if(!imf.open(folder + modelname + fitcore)) ind=im=imh=0;
+    else { ind=imf.nd(); im=imf.m(); imh=imf.mh(); }
     #ifdef _OPENMPI
     if(nd!=ind) { cout << "Error loading posterior trees"<< "nd = " << nd << " -- ind = " << ind << endl; MPI_Finalize(); return 0; }
     if(m!=im) { cout << "Error loading posterior trees" << "m = " << m << " -- im = " << im<< endl; MPI_Finalize(); return 0; }
@@ -215,33 +210,6 @@
     if(mh!=imh) { cout << "Error loading posterior trees" << "mh = " << mh << " -- imh = " << imh<< endl; return 0; }
     #endif
 
-    size_t temp=0;
-    imf >> temp;
-    std::vector<int> e_ots(temp);
-    for(size_t i=0;i<temp;i++) imf >> e_ots.at(i);
-
-    temp=0;
-    imf >> temp;
-    std::vector<int> e_oid(temp);
-    for(size_t i=0;i<temp;i++) imf >> e_oid.at(i);
-
-    temp=0;
-    imf >> temp;
-    std::vector<int> e_ovar(temp);
-    for(size_t i=0;i<temp;i++) imf >> e_ovar.at(i);
-
-    temp=0;
-    imf >> temp;
-    std::vector<int> e_oc(temp);
-    for(size_t i=0;i<temp;i++) imf >> e_oc.at(i);
-
-    temp=0;
-    imf >> temp;
-    std::vector<double> e_otheta(temp);
-    for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_otheta.at(i);
-
-    imf.close();
-
     //Create dinfo for predictions. The fp is just a place holder and is not needed in this script
     double *fp = new double[np];
     dinfo dip;
@@ -262,16 +230,10 @@
         //theta_list[i] = mxd::Zero(nd,m);
     }
 
-    // Temporary vectors used for loading one model realization at a time.
-    std::vector<int> onn(m,1);
-    std::vector<std::vector<int> > oid(m, std::vector<int>(1));
-    std::vector<std::vector<int> > ov(m, std::vector<int>(1));
-    std::vector<std::vector<int> > oc(m, std::vector<int>(1));
-    std::vector<std::vector<double> > otheta(m, std::vector<double>(1));
+    // Flattened copy of one model realization at a time.
+    flatforest flat;
     
     // Draw realizations of the posterior predictive.
-    size_t curdx=0;
-    size_t cumdx=0;
     #ifdef _OPENMPI
     double tstart=0.0,tend=0.0;
     if(mpirank==0) tstart=MPI_Wtime();
@@ -280,33 +242,11 @@
     // Mean trees first
     if(mpirank==0) cout << "Collecting posterior model weights" << endl;
     for(size_t i=0;i<nd;i++) {
-        curdx=0;
-        for(size_t j=0;j<m;j++) {
-            onn[j]=e_ots.at(i*m+j);
-            oid[j].resize(onn[j]);
-            ov[j].resize(onn[j]);
-            oc[j].resize(onn[j]);
-            otheta[j].resize(onn[j]*k);
-            for(size_t l=0;l<(size_t)onn[j];l++) {
-            oid[j][l]=e_oid.at(cumdx+curdx+l);
-            ov[j][l]=e_ovar.at(cumdx+curdx+l);
-            oc[j][l]=e_oc.at(cumdx+curdx+l);
-            for(size_t r=0;r<k;r++){
-                otheta[j][l*k+r]=e_otheta.at((cumdx+curdx+l)*k+r);
-            }
-            
-            }
-            curdx+=(size_t)onn[j];
-        }
-        cumdx+=curdx;
-
-        //Load the current tree structure by using the above vectors
-        axb.loadtree_vec(0,m,onn,oid,ov,oc,otheta); 
-        //if(mpirank == 0) axb.pr_vec();
+        //Load the current tree structure straight from the fit file
+        flat.set(imf.getens(i),xi);
 
         //Get the current posterior draw of the weights
-        wts_iter = mxd::Zero(k,np);
-        axb.get_mix_wts(&dip, &wts_iter);
+        flat.mixwts(0,np,p,dip.x,wts_iter);
         
         //Get terminal node parameters for the 1st pt on the node -- remove later
         //theta_iter = mxd::Zero(k,m);
@@ -38,6 +38,7 @@
 #include "mbrt.h"
 #include "ambrt.h"
 #include "psbrt.h"
+#include "fitio.h"
 
 using std::cout;
 using std::endl;
@@ -201,10 +202,9 @@ int main(int argc, char* argv[])
    if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
 #endif
    size_t ind,im,imh;
-   std::ifstream imf(folder + modelname + ".fit");
-   imf >> ind;
-   imf >> im;
-   imf >> imh;
+   fitfile imf1;
+   if(!imf1.open(folder + modelname + ".fit")) ind=im=imh=0;
+   else { ind=imf1.nd(); im=imf1.m(); imh=imf1.mh(); }
 #ifdef _OPENMPI
    if(nd!=ind) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
    if(m1!=im) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
@@ -215,58 +215,6 @@ int main(int argc, char* argv[])
    if(mh1!=imh) { cout << "Error loading posterior trees" << endl; return 0; }
 #endif
 
-   size_t temp=0;
-   imf >> temp;
-   std::vector<int> e1_ots(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_ots.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_oid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_oid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_ovar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_ovar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_oc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_oc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e1_otheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e1_otheta.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_sts(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_sts.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_sid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_sid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_svar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_svar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e1_sc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e1_sc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e1_stheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e1_stheta.at(i);
-
-   imf.close();
-
 
 
 
@@ -274,10 +222,9 @@ int main(int argc, char* argv[])
 #ifndef SILENT
    if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
 #endif
-   imf.open(folder2 + modelname2 + ".fit");
-   imf >> ind;
-   imf >> im;
-   imf >> imh;
+   fitfile imf2;
+   if(!imf2.open(folder2 + modelname2 + ".fit")) ind=im=imh=0;
+   else { ind=imf2.nd(); im=imf2.m(); imh=imf2.mh(); }
 #ifdef _OPENMPI
    if(nd!=ind) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
    if(m2!=im) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
@@ -288,64 +235,12 @@ int main(int argc, char* argv[])
    if(mh2!=imh) { cout << "Error loading posterior trees" << endl; return 0; }
 #endif
 
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_ots(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_ots.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_oid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_oid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_ovar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_ovar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_oc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_oc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e2_otheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e2_otheta.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_sts(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_sts.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_sid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_sid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_svar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_svar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e2_sc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e2_sc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e2_stheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e2_stheta.at(i);
-
-   imf.close();
-
 
 
 
    // Calculate range of posterior samples to do Pareto front/set on for MPI.
-   int startnd=0,endnd=nd-1;
-   size_t snd,end,rnd=nd;
+   int startnd=0,endnd=nd;
+   size_t snd=0,end=nd,rnd=nd;
 #ifdef _OPENMPI
    calcbegend(nd,mpirank,tc,&startnd,&endnd);
    snd=(size_t)startnd;
@@ -385,10 +280,6 @@ int main(int argc, char* argv[])
    std::vector<std::vector<double> > stheta2(mh2, std::vector<double>(1));
 
    // Draw realizations of the posterior predictive.
-   size_t curdx1=0;
-   size_t cumdx1=0;
-   size_t curdx2=0;
-   size_t cumdx2=0;
    std::vector<std::vector<double> > a1,a2,b1,b2;
    std::vector<double> theta1,theta2;
 #ifdef _OPENMPI
@@ -405,44 +296,15 @@ int main(int argc, char* argv[])
    std::vector<std::vector<std::vector<double> > > bset(nd, std::vector<std::vector<double> >(0, std::vector<double>(0)));
    std::vector<std::vector<std::vector<double> > > front(nd, std::vector<std::vector<double> >(0, std::vector<double>(0)));
 
-   for(size_t i=0;i<nd;i++) {
+   // Only the draws in this node's range are loaded
+   for(size_t i=snd;i<end;i++) {
 
       // Load a realization from model 1
-      curdx1=0;
-      for(size_t j=0;j<m1;j++) {
-         onn1[j]=e1_ots.at(i*m1+j);
-         oid1[j].resize(onn1[j]);
-         ov1[j].resize(onn1[j]);
-         oc1[j].resize(onn1[j]);
-         otheta1[j].resize(onn1[j]);
-         for(size_t k=0;k< (size_t)onn1[j];k++) {
-            oid1[j][k]=e1_oid.at(cumdx1+curdx1+k);
-            ov1[j][k]=e1_ovar.at(cumdx1+curdx1+k);
-            oc1[j][k]=e1_oc.at(cumdx1+curdx1+k);
-            otheta1[j][k]=e1_otheta.at(cumdx1+curdx1+k);
-         }
-         curdx1+=(size_t)onn1[j];
-      }
-      cumdx1+=curdx1;
+      imf1.getdraw(i,onn1,oid1,ov1,oc1,otheta1);
       ambm1.loadtree(0,m1,onn1,oid1,ov1,oc1,otheta1);
 
       // Load a realization from model 2
-      curdx2=0;
-      for(size_t j=0;j<m2;j++) {
-         onn2[j]=e2_ots.at(i*m2+j);
-         oid2[j].resize(onn2[j]);
-         ov2[j].resize(onn2[j]);
-         oc2[j].resize(onn2[j]);
-         otheta2[j].resize(onn2[j]);
-         for(size_t k=0;k< (size_t)onn2[j];k++) {
-            oid2[j][k]=e2_oid.at(cumdx2+curdx2+k);
-            ov2[j][k]=e2_ovar.at(cumdx2+curdx2+k);
-            oc2[j][k]=e2_oc.at(cumdx2+curdx2+k);
-            otheta2[j][k]=e2_otheta.at(cumdx2+curdx2+k);
-         }
-         curdx2+=(size_t)onn2[j];
-      }
-      cumdx2+=curdx2;
+      imf2.getdraw(i,onn2,oid2,ov2,oc2,otheta2);
       ambm2.loadtree(0,m2,onn2,oid2,ov2,oc2,otheta2);
 
 
@@ -39,159 +39,192 @@ void mxbrt::drawvec_mpislave(rn& gen){
 }
 
 //--------------------------------------------------
-//draw theta for a single bottom node for the brt model
-vxd mxbrt::drawnodethetavec(sinfo& si, rn& gen){
-    //initialize variables
-    mxsinfo& mxsi=static_cast<mxsinfo&>(si);
-    mxd I(k,k), Sig_inv(k,k), Sig(k,k), Ev(k,k), E(k,k), Sp(k,k), Prior_Sig_Inv(k,k);
-    vxd muhat(k), evals(k), stdnorm(k), betavec(k);
+//prior mean of the weights for a bottom node.  The prior precision P is
+//ci.invtau2_matrix with diffpriors, else I/tau^2, and is only used through
+//P*beta, sumpl and its addition in leafpost.
+void mxbrt::leafprior(const mxsinfo& mxsi, vxd& betavec, vxd& beta_t2, double& sumpl){
     double t2 = ci.tau*ci.tau;
-    
-    I = Eigen::MatrixXd::Identity(k,k); //Set identity matrix
-    betavec = ci.beta0*Eigen::VectorXd::Ones(k); //Set the prior mean vector
 
-    //Set the prior precision matrix 
     if(ci.diffpriors){
-        Prior_Sig_Inv = ci.invtau2_matrix;
-        betavec = ci.beta_vec;    
+        //Different prior parameters for each function
+        betavec = ci.beta_vec;
+        beta_t2 = ci.invtau2_matrix*betavec;
+        sumpl = -ci.invtau2_matrix.diagonal().array().log().sum(); //The negative appears here because we factor out -0.5 in lm
+        return;
+    }
+    if(nsprior){
+        // Compute beta vector and scale by 1/m (stored in c1.beta0)
+        betavec = mxsi.sump/mxsi.n;
+        betavec = betavec*ci.beta0;
+        sumpl = -(k*log(1/t2));
     }else{
-        //Assuming the same prior settings for tau2
-        if(nsprior){
-            // Compute beta vector and scale by 1/m (stored in c1.beta0) 
-            betavec = mxsi.sump/mxsi.n;
-            betavec = betavec*ci.beta0;
+        // Stationary prior
+        betavec = ci.beta0*vxd::Ones(k);
+        sumpl = k*log(t2);
+    }
+    beta_t2 = (1/t2)*betavec;
+}
 
-            // Compute the prior precision using the value of t2
-            Prior_Sig_Inv = 1/(t2)*I;
-            
-        }else{
-            // Compute the prior precision for stationary prior
-            Prior_Sig_Inv = (1/t2)*I;
-        }
+//--------------------------------------------------
+//factor the posterior of the weights for a bottom node
+void mxbrt::leafpost(const mxsinfo& mxsi, mxleafpost& lp, bool factor){
+    vxd betavec(k), beta_t2(k);
+    leafprior(mxsi,betavec,beta_t2,lp.sumpl);
+
+    //Factor the posterior precision in place and solve for the mean with L
+    if(factor){
+        lp.L = mxsi.sumffw;
+        if(ci.diffpriors) lp.L += ci.invtau2_matrix;
+        else lp.L.diagonal().array() += 1/(ci.tau*ci.tau);
+        Eigen::LLT<Eigen::Ref<mxd> > llt(lp.L);
+        if(llt.info() != Eigen::Success) abort(); //posterior precision is not positive definite
+        lp.L.triangularView<Eigen::StrictlyUpper>().setZero();
     }
+    lp.z = lp.L.triangularView<Eigen::Lower>().solve(mxsi.sumfyw + beta_t2);
+    lp.btpb = betavec.dot(beta_t2);
+}
 
-    //Compute the covariance
-    Sig_inv = mxsi.sumffw + Prior_Sig_Inv; //Get inverse covariance matrix
-    Sig = Sig_inv.llt().solve(I); //Invert Sig_inv with Cholesky Decomposition
-    //Compute the mean vector
-    muhat = Sig*(mxsi.sumfyw + Prior_Sig_Inv*betavec); //Get posterior mean -- may be able to simplify this calculation (k*ci.beta0/(ci.tau*ci.tau)) 
-    //Spectral Decomposition of Covaraince Matrix Sig -- maybe move to a helper function
-    //--Get eigenvalues and eigenvectors
-    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigensolver(Sig); //Get eigenvectors and eigenvalues
-    if(eigensolver.info() != Eigen::ComputationInfo::Success) abort(); //Checks if any errors occurred
-    evals = eigensolver.eigenvalues(); //Get vector of eigenvalues
-    Ev = eigensolver.eigenvectors(); //Get matrix of eigenvectors
-
-    //--Get sqrt of eigen values and store into a matrix    
-    E = mxd::Zero(k,k); //Set as matrix of 0's
-    E.diagonal() = evals.array().sqrt(); //Diagonal Matrix of sqrt of eigen values
-    
-    //--Compute Spectral Decomposition
-    Sp = Ev*E*Ev.transpose();
+//--------------------------------------------------
+//log of integrated likelihood from the factored posterior
+double mxbrt::leaflm(const mxsinfo& mxsi, const mxleafpost& lp){
+    //Log determinant of the posterior precision is 2*sum(log(Lii))
+    double suml = 2*(lp.L.diagonal().array().log().sum());
+
+    //Quadratic term: b^t*A^-1*b = z^t*z
+    double sumq = mxsi.sumyyw - lp.z.squaredNorm() + lp.btpb;
+
+    return -0.5*(suml + sumq + lp.sumpl);
+}
+
+//--------------------------------------------------
+//draw theta for a single bottom node for the brt model
+vxd mxbrt::drawnodethetavec(sinfo& si, rn& gen){
+    mxsinfo& mxsi=static_cast<mxsinfo&>(si);
+    mxleafpost lp;
+    leafpost(mxsi,lp);
 
     //Generate MVN Random vector
     //--Get vector of standard normal normal rv's
+    vxd stdnorm(k);
     for(size_t i=0; i<k;i++){
         stdnorm(i) = gen.normal(); 
     }
-    
-    //Print out matrix algebra step-by-step
-    /*
-    std::cout << "\nAll matrix Calculations:" << std::endl;
-    std::cout << "Sig_inv = \n" << Sig_inv << std::endl;
-    std::cout << "\n Sig = \n" << Sig << std::endl;
-    std::cout << "\n muhat = \n" << muhat << std::endl;
-    std::cout << "\n Ev = \n" << Ev << std::endl;
-    std::cout << "\n evals = \n" << evals << std::endl;
-    std::cout << "\n E = \n" << E << std::endl;
-    std::cout << "\n Sp = \n" << Sp << std::endl;
-    std::cout << "\n thetavec = " << std::endl;
-    */
-        
-    //--Generate the MVN vector
-    return muhat + Sp*stdnorm;
+
+    //--mean + L^-t*stdnorm has covariance A^-1, and the mean is L^-t*z
+    return lp.L.transpose().triangularView<Eigen::Upper>().solve(lp.z + stdnorm);
 }
 
 //--------------------------------------------------
 //lm: log of integrated likelihood, depends on prior and suff stats
 double mxbrt::lm(sinfo& si){
     mxsinfo& mxsi=static_cast<mxsinfo&>(si);
-    mxd Sig_inv(k,k), Sig(k,k), I(k,k);
-    vxd betavec(k), beta_t2(k); 
-    double t2 = ci.tau*ci.tau;
-    double suml=0.0; //sum of log determinent 
-    double sumq=0.0; //sum of quadratic term
-    double sumpl=0.0; //sum of prior precision log determinant
-    
-    I = mxd::Identity(k,k); //Set identity matrix
-
-    //Compute lm value if no discrepancy is specified and each weight has the same prior
-    if(!nsprior && !ci.diffpriors){
-        //prior mean vector
-        betavec = ci.beta0*vxd::Ones(k);
-
-        //Get covariance matrix
-        Sig = mxsi.sumffw + I/t2; //get Sig matrix
-        Sig_inv = Sig.llt().solve(I); //Get Sigma_inv
-        
-        //Compute Log determinent
-        mxd L(Sig.llt().matrixL()); //Cholesky decomp and store the L matrix
-        suml = 2*(L.diagonal().array().log().sum()); //The log determinent is the same as 2*sum(log(Lii)) --- Lii = diag element of L
-
-        //Now work on the exponential terms
-        sumq = mxsi.sumyyw - (mxsi.sumfyw + betavec/t2).transpose()*Sig_inv*(mxsi.sumfyw + betavec/t2) + k*ci.beta0*ci.beta0/t2;
-
-        //Get sum of prior precision log determinant
-        sumpl = k*log(t2);
-
-    }else if(nsprior && !ci.diffpriors){
-        //Get prior inverse covariance and mean vector
-        mxd Prior_Sig_Inv(k,k);
-        
-        //Get beta vector and scale by 1/m 
-        betavec = mxsi.sump/mxsi.n;
-        betavec = betavec*ci.beta0;
-
-        //Get the prior precision
-        Prior_Sig_Inv = (1/t2)*I;
-        
-        //Get posterior covariance matrix (Sig_inv)
-        Sig = mxsi.sumffw + Prior_Sig_Inv; //get Sig matrix
-        Sig_inv = Sig.llt().solve(I); //Get Sigma_inv
-        
-        //Compute Log determinent
-        mxd L(Sig.llt().matrixL()); //Cholesky decomp and store the L matrix
-        suml = 2*(L.diagonal().array().log().sum()); //The log determinent is the same as 2*sum(log(Lii)) --- Lii = diag element of L
-
-        //Now work on the exponential terms
-        beta_t2 = Prior_Sig_Inv*betavec;
-        sumq = mxsi.sumyyw - (mxsi.sumfyw + beta_t2).transpose()*Sig_inv*(mxsi.sumfyw + beta_t2) + betavec.transpose()*beta_t2;
-
-        //Get sum of prior precision log determinant
-        sumpl = -Prior_Sig_Inv.diagonal().array().log().sum(); //The negative appears here because we factor out -0.5 in the final sum       
-
-    }else if(ci.diffpriors){
-        //No discrpeancy and different priors for weights
-        //prior mean vector
-        betavec = ci.beta_vec;
+    mxleafpost lp;
+    leafpost(mxsi,lp);
+    return leaflm(mxsi,lp);
+}
 
-        //Get covariance matrix
-        Sig = mxsi.sumffw + ci.invtau2_matrix; //get Sig matrix
-        Sig_inv = Sig.llt().solve(I); //Get Sigma_inv
-        
-        //Compute Log determinent
-        mxd L(Sig.llt().matrixL()); //Cholesky decomp and store the L matrix
-        suml = 2*(L.diagonal().array().log().sum()); //The log determinent is the same as 2*sum(log(Lii)) --- Lii = diag element of L
+//--------------------------------------------------
+//Rank-1 update of a Cholesky factor, L*L^t + sgn*x*x^t with sgn=1 or -1.
+//x is overwritten.  Returns false if a downdate would leave a matrix that
+//is not positive definite, and L is then garbage.
+static bool cholupdate(mxd& L, vxd& x, double sgn){
+    size_t n=L.rows();
+    for(size_t j=0;j<n;j++){
+        double ljj=L(j,j);
+        double r2=ljj*ljj+sgn*x(j)*x(j);
+        if(!(r2>0.0)) return false;
+        double r=sqrt(r2), c=r/ljj, s=x(j)/ljj;
+        L(j,j)=r;
+        size_t nt=n-j-1;
+        if(nt){
+            L.col(j).tail(nt)=(L.col(j).tail(nt)+sgn*s*x.tail(nt))/c;
+            x.tail(nt)=c*x.tail(nt)-s*L.col(j).tail(nt);
+        }
+    }
+    return true;
+}
 
-        //Now work on the exponential terms
-        beta_t2 = ci.invtau2_matrix*betavec; //saves on doing this calculation 3 separate times 
-        sumq = mxsi.sumyyw - (mxsi.sumfyw + beta_t2).transpose()*Sig_inv*(mxsi.sumfyw + beta_t2) + betavec.transpose()*beta_t2;
+//--------------------------------------------------
+//A birth or death with k large and few rows in one of the children.
+//Factoring the posterior precision of each of the three nodes is O(k^3).
+//Instead only the parent t is factored; the small child s starts from the
+//factor of the prior precision and the big child b from the factor of t,
+//and each row of s is added to the first and removed from the second by a
+//rank-1 update, O(k^2) per row.
+//A downdate that fails numerically falls back to factoring b.
+void mxbrt::lmsplit(const std::vector<size_t>& rows, mxsinfo& sis, mxsinfo& sib, mxsinfo& sit, double& lms, double& lmb, double& lmt){
+    mxleafpost lpt, lps, lpb;
+    leafpost(sit,lpt);
+    lmt=leaflm(sit,lpt);
 
-        //Get sum of prior precision log determinant
-        sumpl = -ci.invtau2_matrix.diagonal().array().log().sum();    
+    if(ci.diffpriors){
+        Eigen::LLT<mxd> llt(ci.invtau2_matrix);
+        lps.L = llt.matrixL();
+    }else{
+        lps.L = mxd::Zero(k,k);
+        lps.L.diagonal().setConstant(1/ci.tau);
+    }
+    lpb.L = lpt.L;
+
+    bool ok=true;
+    vxd x(k), xb(k);
+    for(size_t r=0;r<rows.size();r++){
+        size_t i=rows[r];
+        double sw=sqrt(fc ? fc->w[i] : 1.0/(ci.sigma[i]*ci.sigma[i]));
+        x = sw*(*fi).row(i).transpose();
+        xb = x;
+        cholupdate(lps.L,x,1.0);
+        if(ok) ok=cholupdate(lpb.L,xb,-1.0);
     }
-    return -0.5*(suml + sumq + sumpl);
+    leafpost(sis,lps,false);
+    lms=leaflm(sis,lps);
+    leafpost(sib,lpb,!ok);
+    lmb=leaflm(sib,lpb);
+}
 
+//--------------------------------------------------
+//lm for birth and death.  Without MPI the rows of the nodes are local, so
+//when one child has fewer than k/updrows rows use lmsplit.
+void mxbrt::lmbirth(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir, sinfo& sit, double& lml, double& lmr, double& lmt){
+#ifndef _OPENMPI
+    bool left = sil.n<=sir.n;
+    size_t ns = left ? sil.n : sir.n;
+    if(ns*updrows<k){
+        size_t beg,end;
+        std::vector<size_t> rows;
+        rows.reserve(ns);
+        getoidxrng(nx,beg,end);
+        for(diterator diter(di,oidx.data(),beg,end);diter<diter.until();diter++)
+            if(goesleft(diter,v,c,*xi)==left) rows.push_back(*diter);
+        mxsinfo& msil=static_cast<mxsinfo&>(sil);
+        mxsinfo& msir=static_cast<mxsinfo&>(sir);
+        mxsinfo& msit=static_cast<mxsinfo&>(sit);
+        if(left) lmsplit(rows,msil,msir,msit,lml,lmr,lmt);
+        else lmsplit(rows,msir,msil,msit,lmr,lml,lmt);
+        return;
+    }
+#endif
+    brt::lmbirth(nx,v,c,sil,sir,sit,lml,lmr,lmt);
+}
+void mxbrt::lmdeath(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir, sinfo& sit, double& lml, double& lmr, double& lmt){
+#ifndef _OPENMPI
+    bool left = sil.n<=sir.n;
+    size_t ns = left ? sil.n : sir.n;
+    if(ns*updrows<k){
+        size_t beg,end;
+        std::vector<size_t> rows;
+        rows.reserve(ns);
+        getoidxrng(left ? l : r,beg,end);
+        for(size_t i=beg;i<end;i++) rows.push_back(oidx[i]);
+        mxsinfo& msil=static_cast<mxsinfo&>(sil);
+        mxsinfo& msir=static_cast<mxsinfo&>(sir);
+        mxsinfo& msit=static_cast<mxsinfo&>(sit);
+        if(left) lmsplit(rows,msil,msir,msit,lml,lmr,lmt);
+        else lmsplit(rows,msir,msil,msit,lmr,lml,lmt);
+        return;
+    }
+#endif
+    brt::lmdeath(l,r,sil,sir,sit,lml,lmr,lmt);
 }
 
 //--------------------------------------------------
@@ -204,6 +237,42 @@ void mxbrt::add_observation_to_suff(diterator& diter, sinfo& si){
     //Declare variables 
     mxsinfo& mxsi=static_cast<mxsinfo&>(si);
     //mxsi.resize(k);
+
+    //Use the fixed size versions for the usual numbers of models -- they don't touch the heap
+    switch(k){
+        case 2: add_observation_to_suff_k<2>(diter,mxsi); return;
+        case 3: add_observation_to_suff_k<3>(diter,mxsi); return;
+        case 4: add_observation_to_suff_k<4>(diter,mxsi); return;
+        case 5: add_observation_to_suff_k<5>(diter,mxsi); return;
+        case 6: add_observation_to_suff_k<6>(diter,mxsi); return;
+        case 7: add_observation_to_suff_k<7>(diter,mxsi); return;
+        case 8: add_observation_to_suff_k<8>(diter,mxsi); return;
+    }
+
+    //Read f f^t, pv and the weight from the cache when there is one
+    if(fc){
+        size_t i=*diter;
+        double y=diter.gety();
+        double w=fc->w[i];
+        const double* ffi=&fc->ff[i*(k*(k+1)/2)];
+        if(nsprior){
+            for(size_t l=0;l<k;l++) mxsi.sump(l)+=fc->pv[i*k+l];
+        }else{
+            mxsi.sump.setOnes();
+        }
+        mxsi.n+=1;
+        for(size_t a=0;a<k;a++){
+            for(size_t b=a;b<k;b++){
+                double t=w*(*ffi++);
+                mxsi.sumffw(a,b)+=t;
+                if(b!=a) mxsi.sumffw(b,a)+=t;
+            }
+            mxsi.sumfyw(a)+=w*((*fi)(i,a)*y);
+        }
+        mxsi.sumyyw+=w*(y*y);
+        return;
+    }
+
     double w, yy;
     mxd ff(k,k);
     vxd fy(k), pv(k), pv2(k);
@@ -228,8 +297,8 @@ void mxbrt::add_observation_to_suff(diterator& diter, sinfo& si){
         mxsi.sump+=pv;
     }else{
         //Set as 1's by default when no discrepancy is used
-        mxsi.sump = vxd::Ones(k);
-}
+        mxsi.sump.setOnes();
+    }
     
     //Update sufficient stats for nodes
     mxsi.n+=1;
@@ -240,6 +309,86 @@ void mxbrt::add_observation_to_suff(diterator& diter, sinfo& si){
 
 }
 
+//--------------------------------------------------
+//add_observation_to_suff with K=k models known at compile time.
+//The row of f is copied to the stack and f*f^t is added in as a symmetric
+//rank-1 update, each product computed once for both triangles.  Every entry
+//gets the same terms in the same order as the general version above.
+template<int K>
+void mxbrt::add_observation_to_suff_k(diterator& diter, mxsinfo& mxsi){
+    alignas(EIGEN_MAX_ALIGN_BYTES) double f[K], pv[K];
+    size_t i=*diter;
+    double y=diter.gety();
+    double w=fc ? fc->w[i] : 1.0/(ci.sigma[i]*ci.sigma[i]);
+    for(int l=0;l<K;l++) f[l]=(*fi)(i,l);
+
+    //Work with scaled precision vector for discrepancy model if true
+    if(nsprior && fc){
+        const double* pvi=&fc->pv[i*K];
+        for(int l=0;l<K;l++) mxsi.sump(l)+=pvi[l];
+    }else if(nsprior){
+        for(int l=0;l<K;l++) pv[l]=1/((*fisd)(i,l)*(*fisd)(i,l));
+        //Constrain pv to the simplex -- sum through Eigen so the rounding matches the general version
+        double psum=Eigen::Map<const vxd,Eigen::AlignedMax>(pv,K).sum();
+        for(int l=0;l<K;l++) mxsi.sump(l)+=pv[l]/psum;
+    }else{
+        //Set as 1's by default when no discrepancy is used
+        mxsi.sump.setOnes();
+    }
+
+    //Update sufficient stats for nodes
+    double* sff=mxsi.sumffw.data();
+    mxsi.n+=1;
+    if(fc){
+        const double* ffi=&fc->ff[i*(K*(K+1)/2)];
+        for(int a=0;a<K;a++){
+            for(int b=a;b<K;b++){
+                double t=w*(*ffi++);
+                sff[a+b*K]+=t;
+                if(b!=a) sff[b+a*K]+=t;
+            }
+            mxsi.sumfyw(a)+=w*(f[a]*y);
+        }
+    }else{
+        for(int a=0;a<K;a++){
+            for(int b=a;b<K;b++){
+                double t=w*(f[a]*f[b]);
+                sff[a+b*K]+=t;
+                if(b!=a) sff[b+a*K]+=t;
+            }
+            mxsi.sumfyw(a)+=w*(f[a]*y);
+        }
+    }
+    mxsi.sumyyw+=w*(y*y);
+}
+
+//--------------------------------------------------
+//mxfcache: per-row products for add_observation_to_suff
+void mxfcache::setff(const finfo& fi){
+    size_t n=fi.rows();
+    k=fi.cols();
+    ff.resize(n*(k*(k+1)/2));
+    double* p=ff.data();
+    for(size_t i=0;i<n;i++)
+        for(size_t a=0;a<k;a++)
+            for(size_t b=a;b<k;b++)
+                *p++=fi(i,a)*fi(i,b);
+}
+void mxfcache::setpv(const finfo& fisd){
+    size_t n=fisd.rows();
+    vxd pvi(k);
+    pv.resize(n*k);
+    for(size_t i=0;i<n;i++){
+        for(size_t l=0;l<k;l++) pvi(l)=1/(fisd(i,l)*fisd(i,l));
+        pvi=pvi/pvi.sum(); //constrain to the simplex, as in add_observation_to_suff
+        for(size_t l=0;l<k;l++) pv[i*k+l]=pvi(l);
+    }
+}
+void mxfcache::setw(const double* sigma, size_t n){
+    w.resize(n);
+    for(size_t i=0;i<n;i++) w[i]=1.0/(sigma[i]*sigma[i]);
+}
+
 //--------------------------------------------------
 // MPI virtualized part for sending/receiving left,right suffs
 void mxbrt::local_mpi_sr_suffs(sinfo& sil, sinfo& sir){
@@ -270,7 +419,7 @@ void mxbrt::local_mpi_sr_suffs(sinfo& sil, sinfo& sir){
             vector_to_array(tsir.sump, &sump_rarray[0]); //function defined in brtfuns
         }
          
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             position=0;
             MPI_Recv(buffer,buffer_size,MPI_PACKED,MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&status);
             MPI_Unpack(buffer,buffer_size,&position,&ln,1,MPI_UNSIGNED,MPI_COMM_WORLD);
@@ -365,7 +514,7 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
     std::vector<vxd, Eigen::aligned_allocator<vxd>> sumfywvec_ev(siv.size()); //Vector of Eigen Vectors k dim
     std::vector<vxd, Eigen::aligned_allocator<vxd>> sumpvec_em(siv.size()); //Vector of Eigen Vectors k dim
 
-    for(size_t i=0;i<siv.size();i++) { // on root node, these should be 0 because of newsinfo().
+    for(size_t i=0;i<siv.size();i++) { // on root node, the suff stats of its own rows (0 if it holds none).
         mxsinfo* mxsi=static_cast<mxsinfo*>(siv[i]);
         nvec[i]=(unsigned int)mxsi->n;    // cast to int
         sumyywvec[i]=mxsi->sumyyw;
@@ -400,14 +549,14 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
         double tempsumpvec[k*siv.size()]; //An array that contains siv.size() vectors of k dimension that are flattened.
 
         // receive nvec, update and send back.
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Recv(&tempnvec,siv.size(),MPI_UNSIGNED,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             for(size_t j=0;j<siv.size();j++){
                 nvec[j]+=tempnvec[j];
             }
         }
-        MPI_Request *request=new MPI_Request[tc];
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        MPI_Request *request=new MPI_Request[nslaves];
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(&nvec,siv.size(),MPI_UNSIGNED,i,0,MPI_COMM_WORLD,&request[i-1]);
         }
         // cast back to mxsi
@@ -416,17 +565,17 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
             mxsi->n=(size_t)nvec[i];    // cast back to size_t
             //std::cout << "nvec[" << i << "] = " << nvec[i] << std::endl;
         }
-        MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+        MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
         delete[] request;
 
         // receive sumyywvec, update and send back.
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Recv(&tempsumyywvec,siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             for(size_t j=0;j<siv.size();j++)
                 sumyywvec[j]+=tempsumyywvec[j];
         }
-        request=new MPI_Request[tc];
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        request=new MPI_Request[nslaves];
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(&sumyywvec,siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
         }
         // cast back to mxsi
@@ -435,11 +584,11 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
             mxsi->sumyyw=sumyywvec[i];
             //std::cout << "sumyyw[" << i << "] = " << sumyywvec[i] << std::endl;
         }
-        MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+        MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
         delete[] request;
 
         // receive sumfywvec, update and send back.
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Recv(&tempsumfywvec,k*siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             for(size_t j=0;j<k*siv.size();j++){
                 sumfywvec[j]+=tempsumfywvec[j]; //add temp vector to the sufficient stat
@@ -447,8 +596,8 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
         }
         //for(size_t j=0; j<k*siv.size(); j++){cout << "sumfywvec = " << sumfywvec[j] << endl;} //delete later
         
-        request=new MPI_Request[tc];
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        request=new MPI_Request[nslaves];
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(&sumfywvec,k*siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
         }
         
@@ -465,18 +614,18 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
             //std::cout << "tempsumfyw = \n" << tempsumfyw.transpose() << std::endl;
             mxsi->sumfyw=tempsumfyw;
         }
-        MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+        MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
         delete[] request;
 
         // receive sumffwvec, update and send back.
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Recv(&tempsumffwvec,k*k*siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             for(size_t j=0;j<(k*k*siv.size());j++){
                 sumffwvec[j]+=tempsumffwvec[j];
             }
         }
-        request=new MPI_Request[tc];
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        request=new MPI_Request[nslaves];
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(&sumffwvec,k*k*siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
         }
         // cast back to mxsi
@@ -490,20 +639,20 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
             //std::cout << "tempsumffw = \n" << tempsumffw << std::endl; 
             mxsi->sumffw=tempsumffw;
         }
-        MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+        MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
         delete[] request;
 
         //For discrepancy models
         if(nsprior){
             //receive sump, update, and send back
-            for(size_t i=1; i<=(size_t)tc; i++) {
+            for(size_t i=1; i<=(size_t)nslaves; i++) {
                 MPI_Recv(&tempsumpvec,k*siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
                 for(size_t j=0;j<k*siv.size();j++){
                     sumpvec[j]+=tempsumpvec[j];
                 }
             }
-            request=new MPI_Request[tc];
-            for(size_t i=1; i<=(size_t)tc; i++) {
+            request=new MPI_Request[nslaves];
+            for(size_t i=1; i<=(size_t)nslaves; i++) {
                 MPI_Isend(&sumpvec,k*siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
             }
             // cast back to mxsi
@@ -517,7 +666,7 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
                 //std::cout << "tempsump = \n" << tempsump << std::endl; 
                 mxsi->sump=tempsump;
             }
-            MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+            MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
             delete[] request;
 
         }
@@ -621,6 +770,26 @@ void mxbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv){
 #endif
 }
 
+//--------------------------------------------------
+//pack/unpack an mxsinfo for the replicated mode MPI_Allreduce:
+//n, sumyyw, sumffw (by row), sumfyw and sump when there is a discrepancy prior.
+void mxbrt::local_mpi_packsuff(sinfo& si, double* buf){
+    mxsinfo& mxsi=static_cast<mxsinfo&>(si);
+    buf[0]=(double)mxsi.n;
+    buf[1]=mxsi.sumyyw;
+    matrix_to_array(mxsi.sumffw,&buf[2]);
+    vector_to_array(mxsi.sumfyw,&buf[2+k*k]);
+    if(nsprior) vector_to_array(mxsi.sump,&buf[2+k*k+k]);
+}
+void mxbrt::local_mpi_unpacksuff(double* buf, sinfo& si){
+    mxsinfo& mxsi=static_cast<mxsinfo&>(si);
+    mxsi.n=(size_t)buf[0];
+    mxsi.sumyyw=buf[1];
+    array_to_matrix(mxsi.sumffw,&buf[2]);
+    array_to_vector(mxsi.sumfyw,&buf[2+k*k]);
+    if(nsprior) array_to_vector(mxsi.sump,&buf[2+k*k+k]);
+}
+
 //--------------------------------------------------
 //Print mxbrt object
 void mxbrt::pr_vec()
@@ -728,19 +897,12 @@ void mxbrt::local_getsumr2(double &sumr2, int &n){
 //local_mpi_getsumr2 -- performs the calculation for getting the resid sum of squares
 void mxbrt::local_mpi_getsumr2(double &sumr2, int &n){
 #ifdef _OPENMPI
-    if(rank==0) {
-        //reduce all the sumr2  across the processes (nodes)
-        local_mpi_reduce_getsumr2(sumr2, n);
-    }
-    else
-    {
-        //compute the sumr2 for this process 
-        local_getsumr2(sumr2,n);
-        //std::cout << "local_getsumr2 --- mpirank = " << rank << " --- sumr2,n = " << sumr2 << "," << n << std::endl; 
+    //compute the sumr2 for this process (rank 0 included, it may hold rows)
+    local_getsumr2(sumr2,n);
+    //std::cout << "local_getsumr2 --- mpirank = " << rank << " --- sumr2,n = " << sumr2 << "," << n << std::endl; 
 
-        //reduce all the sumr2  across the processes (nodes)
-        local_mpi_reduce_getsumr2(sumr2, n);
-    }
+    //reduce all the sumr2  across the processes (nodes)
+    local_mpi_reduce_getsumr2(sumr2, n);
     //std::cout << "After MPI Comm--- mpirank = " << rank << " --- sumr2,n = " << sumr2 << "," << n << std::endl;
 #endif
 }
@@ -750,7 +912,7 @@ void mxbrt::local_mpi_getsumr2(double &sumr2, int &n){
 void mxbrt::local_mpi_reduce_getsumr2(double &sumr2, int &n)
 {
 #ifdef _OPENMPI
-    double sr2 = sumr2; //this should be zero on root 
+    double sr2 = sumr2; //zero on root unless it holds rows
     int nval = n; //this is zero on the root
     if(rank==0) {
         MPI_Status status;
@@ -758,37 +920,37 @@ void mxbrt::local_mpi_reduce_getsumr2(double &sumr2, int &n)
         unsigned int tempnval;
         
         //Receive, Send, and update sr2
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Recv(&tempsr2,1,MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             sr2 += tempsr2;
         }
 
-        MPI_Request *request=new MPI_Request[tc];
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        MPI_Request *request=new MPI_Request[nslaves];
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(&sr2,1,MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
         }
 
         //set sumr2 to the value
         sumr2 = sr2;
 
-        MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+        MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
         delete[] request;
 
         //Receive, Send and update nval
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Recv(&tempnval,1,MPI_UNSIGNED,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
             nval += tempnval;
         }
 
-        request=new MPI_Request[tc];
-        for(size_t i=1; i<=(size_t)tc; i++) {
+        request=new MPI_Request[nslaves];
+        for(size_t i=1; i<=(size_t)nslaves; i++) {
             MPI_Isend(&nval,1,MPI_UNSIGNED,i,0,MPI_COMM_WORLD,&request[i-1]);
         }
 
         //set nval to the value
         n = (int)nval;
 
-        MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+        MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
         delete[] request;
     }
     else {
@@ -804,7 +966,7 @@ void mxbrt::local_mpi_reduce_getsumr2(double &sumr2, int &n)
         MPI_Recv(&sr2,1,MPI_DOUBLE,0,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
         
         //send nval
-        request=new MPI_Request[tc];
+        request=new MPI_Request[nslaves];
         MPI_Isend(&nval,1,MPI_UNSIGNED,0,0,MPI_COMM_WORLD,request);
         
         //update sumr2 to the value
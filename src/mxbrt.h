@@ -89,6 +89,37 @@ class mxsinfo : public sinfo{
 };
 
 
+//Per-row quantities used by the mixing suff stats that don't depend on the
+//residuals, shared by all m trees of an amxbrt:
+//   ff  packed upper triangle of f.row(i)^t*f.row(i), k(k+1)/2 values per row
+//   pv  discrepancy precisions scaled to sum to one, k per row (nsprior only)
+//   w   weight 1/sigma_i^2 of row i
+//ff and pv are set when f (or fisd) is, w after every draw of sigma.
+class mxfcache{
+    public:
+        mxfcache():k(0) {}
+        size_t k;
+        std::vector<double> ff, pv, w;
+        void setff(const finfo& fi);
+        void setpv(const finfo& fisd);
+        void setw(const double* sigma, size_t n);
+};
+
+
+//Posterior of the weight vector in one terminal node given its suff stats.
+//With prior N(beta,P^-1) the posterior is N(A^-1*b, A^-1), where the
+//precision A = sumffw + P and b = sumfyw + P*beta.  A is factored once,
+//A = L*L^t, and lm and the draw both work with triangular solves against L.
+//L can also come from a rank-1 update of a neighbouring node's factor.
+class mxleafpost{
+    public:
+        mxd L; //lower Cholesky factor of A
+        vxd z; //L^-1*b, so the posterior mean is L^-t*z
+        double btpb; //beta^t*P*beta
+        double sumpl; //minus the sum of the log of the diagonal of P
+};
+
+
 class mxbrt : public brt{
 public:
     //--------------------
@@ -108,7 +139,7 @@ public:
         };
     //--------------------
     //constructors/destructors
-    mxbrt():brt() {}
+    mxbrt():brt(),fc(0) {}
     //mxbrt(size_t ik):brt(ik) {}
     //--------------------
     //methods
@@ -117,6 +148,7 @@ public:
     void setci(double tau, double beta0, double* sigma) { ci.tau=tau; ci.beta0 = beta0; ci.sigma=sigma; } //Set for using the same prior for each weight
     void setci(mxd invtau2_matrix, vxd beta_vec, double* sigma) {ci.invtau2_matrix.resize(invtau2_matrix.rows(),invtau2_matrix.rows()); ci.beta_vec.resize(beta_vec.rows());
         ci.invtau2_matrix=invtau2_matrix; ci.beta_vec=beta_vec; ci.sigma=sigma; ci.diffpriors = true;} //Set when using prior's that differ by function
+    void setfcache(mxfcache* fc) { this->fc=fc; } //use the per-row products in *fc instead of computing them from fi, fisd and sigma
     virtual vxd drawnodethetavec(sinfo& si, rn& gen);
     virtual double lm(sinfo& si);
     virtual void add_observation_to_suff(diterator& diter, sinfo& si);
@@ -125,6 +157,9 @@ public:
     virtual std::vector<sinfo*>& newsinfovec(size_t dim) { std::vector<sinfo*>* si = new std::vector<sinfo*>; si->resize(dim); for(size_t i=0;i<dim;i++) si->push_back(new mxsinfo(k)); return *si; }
     virtual void local_mpi_reduce_allsuff(std::vector<sinfo*>& siv);
     virtual void local_mpi_sr_suffs(sinfo& sil, sinfo& sir);
+    virtual size_t mpi_suffsize() { return 2+k*k+k+(nsprior ? k : 0); }
+    virtual void local_mpi_packsuff(sinfo& si, double* buf);
+    virtual void local_mpi_unpacksuff(double* buf, sinfo& si);
     void pr_vec();
 
     //Method for sampling homoscedastic variance for paramter sigma^2 -- not sure if this works
@@ -147,12 +182,21 @@ public:
     //--------------------
     //model information
     cinfo ci; //conditioning info (e.g. other parameters and prior and end node models)
+    mxfcache* fc; //cached per-row products, or 0 to compute them as needed
+    static const size_t updrows=12; //lmbirth/lmdeath use rank-1 updates when a child has fewer than k/updrows rows
     //--------------------
     //data
     //--------------------
     //mcmc info
     //--------------------
     //methods
+    template<int K> void add_observation_to_suff_k(diterator& diter, mxsinfo& mxsi);
+    void leafprior(const mxsinfo& mxsi, vxd& betavec, vxd& beta_t2, double& sumpl); //prior mean for a terminal node
+    void leafpost(const mxsinfo& mxsi, mxleafpost& lp, bool factor=true); //posterior for a terminal node, factor=false if lp.L is already set
+    double leaflm(const mxsinfo& mxsi, const mxleafpost& lp);
+    virtual void lmbirth(tree::tree_p nx, size_t v, size_t c, sinfo& sil, sinfo& sir, sinfo& sit, double& lml, double& lmr, double& lmt);
+    virtual void lmdeath(tree::tree_p l, tree::tree_p r, sinfo& sil, sinfo& sir, sinfo& sit, double& lml, double& lmr, double& lmt);
+    void lmsplit(const std::vector<size_t>& rows, mxsinfo& sis, mxsinfo& sib, mxsinfo& sit, double& lms, double& lmb, double& lmt);
 };
 
 #endif
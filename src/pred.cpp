@@ -44,6 +44,8 @@
 #include "tnorm.h"
 #include "mxbrt.h"
 #include "amxbrt.h"
+#include "fitio.h"
+#include "flatforest.h"
 
 using std::cout;
 using std::endl;
@@ -58,6 +60,36 @@ using std::endl;
 #define MODEL_MIXBART 9 //Skipped 8 because MERCK is 8 in cli.cpp
 
 
+//--------------------------------------------------
+//Predict at the np rows of x for every saved draw in imf.  The draws are split
+//into contiguous ranges over tc OpenMP threads, each with its own flat forest,
+//and draw i goes straight into tedraw[i] (mean) and tedrawh[i] (sd).
+//fi is the model mixing function output, or 0 for a sum of trees.
+static void preddraws(fitfile& imf, xinfo& xi, size_t np, size_t p, const double* x, const finfo* fi, double fmean,
+                      int tc, std::vector<std::vector<double> >& tedraw, std::vector<std::vector<double> >& tedrawh)
+{
+   size_t nd=tedraw.size();
+#ifdef _OPENMP
+#  pragma omp parallel num_threads(tc)
+#endif
+   {
+      int beg=0,end=(int)nd;
+#ifdef _OPENMP
+      calcbegend((int)nd,omp_get_thread_num(),omp_get_num_threads(),&beg,&end);
+#endif
+      flatforest flat;
+      for(size_t i=(size_t)beg;i<(size_t)end;i++) {
+         flat.set(imf.getens(i),xi);
+         if(fi) flat.predictmix(0,np,p,x,*fi,tedraw[i].data());
+         else flat.predictsum(0,np,p,x,tedraw[i].data());
+         for(size_t j=0;j<np;j++) tedraw[i][j] += fmean;
+
+         flat.set(imf.getsens(i),xi);
+         flat.predictprod(0,np,p,x,tedrawh[i].data());
+      }
+   }
+}
+
 // Draw predictive realizations at the prediciton points, xp.
 int main(int argc, char* argv[])
 {
@@ -260,26 +292,14 @@ int main(int argc, char* argv[])
    */
    
 if(modeltype!=MODEL_MIXBART){
-   //--------------------------------------------------
-   // set up ambrt object
-   ambrt ambm(m);
-   ambm.setxi(&xi); //set the cutpoints for this model object
-
-   //setup psbrt object
-   psbrt psbm(mh);
-   psbm.setxi(&xi); //set the cutpoints for this model object
-
-
-
    //load from file
 #ifndef SILENT
    if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
 #endif
    size_t ind,im,imh;
-   std::ifstream imf(folder + modelname + ".fit");
-   imf >> ind;
-   imf >> im;
-   imf >> imh;
+   fitfile imf;
+   if(!imf.open(folder + modelname + ".fit")) ind=im=imh=0;
+   else { ind=imf.nd(); im=imf.m(); imh=imf.mh(); }
 #ifdef _OPENMPI
    if(nd!=ind) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
    if(m!=im) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
@@ -290,143 +310,22 @@ if(modeltype!=MODEL_MIXBART){
    if(mh!=imh) { cout << "Error loading posterior trees" << endl; return 0; }
 #endif
 
-   size_t temp=0;
-   imf >> temp;
-   std::vector<int> e_ots(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ots.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_ovar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ovar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_otheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_otheta.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sts(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sts.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_svar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_svar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_stheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_stheta.at(i);
-
-   imf.close();
-
 
 
    //objects where we'll store the realizations
    std::vector<std::vector<double> > tedraw(nd,std::vector<double>(np));
    std::vector<std::vector<double> > tedrawh(nd,std::vector<double>(np));
    std::vector<std::vector<double> > tedrawp(nd,std::vector<double>(np));
-   double *fp = new double[np];
-   dinfo dip;
-   dip.x = &xp[0]; dip.y=fp; dip.p = p; dip.n=np; dip.tc=1;
-
-   // Temporary vectors used for loading one model realization at a time.
-   std::vector<int> onn(m,1);
-   std::vector<std::vector<int> > oid(m, std::vector<int>(1));
-   std::vector<std::vector<int> > ov(m, std::vector<int>(1));
-   std::vector<std::vector<int> > oc(m, std::vector<int>(1));
-   std::vector<std::vector<double> > otheta(m, std::vector<double>(1));
-   std::vector<int> snn(mh,1);
-   std::vector<std::vector<int> > sid(mh, std::vector<int>(1));
-   std::vector<std::vector<int> > sv(mh, std::vector<int>(1));
-   std::vector<std::vector<int> > sc(mh, std::vector<int>(1));
-   std::vector<std::vector<double> > stheta(mh, std::vector<double>(1));
 
    // Draw realizations of the posterior predictive.
-   size_t curdx=0;
-   size_t cumdx=0;
 #ifdef _OPENMPI
    double tstart=0.0,tend=0.0;
    if(mpirank==0) tstart=MPI_Wtime();
 #endif
 
-
-   // Mean trees first
-   if(mpirank==0) cout << "Drawing mean response from posterior predictive" << endl;
-   for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<m;j++) {
-         onn[j]=e_ots.at(i*m+j);
-         oid[j].resize(onn[j]);
-         ov[j].resize(onn[j]);
-         oc[j].resize(onn[j]);
-         otheta[j].resize(onn[j]);
-         for(size_t k=0;k< (size_t)onn[j];k++) {
-            oid[j][k]=e_oid.at(cumdx+curdx+k);
-            ov[j][k]=e_ovar.at(cumdx+curdx+k);
-            oc[j][k]=e_oc.at(cumdx+curdx+k);
-            otheta[j][k]=e_otheta.at(cumdx+curdx+k);
-         }
-         curdx+=(size_t)onn[j];
-      }
-      cumdx+=curdx;
-
-      ambm.loadtree(0,m,onn,oid,ov,oc,otheta);
-      // draw realization
-      ambm.predict(&dip);
-      for(size_t j=0;j<np;j++) tedraw[i][j] = fp[j] + fmean;
-   }
-
-
-   // Variance trees second
-   if(mpirank==0) cout << "Drawing sd response from posterior predictive" << endl;
-   cumdx=0;
-   curdx=0;
-   for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<mh;j++) {
-         snn[j]=e_sts.at(i*mh+j);
-         sid[j].resize(snn[j]);
-         sv[j].resize(snn[j]);
-         sc[j].resize(snn[j]);
-         stheta[j].resize(snn[j]);
-         for(size_t k=0;k< (size_t)snn[j];k++) {
-            sid[j][k]=e_sid.at(cumdx+curdx+k);
-            sv[j][k]=e_svar.at(cumdx+curdx+k);
-            sc[j][k]=e_sc.at(cumdx+curdx+k);
-            stheta[j][k]=e_stheta.at(cumdx+curdx+k);
-         }
-         curdx+=(size_t)snn[j];
-      }
-      cumdx+=curdx;
-
-      psbm.loadtree(0,mh,snn,sid,sv,sc,stheta);
-      // draw realization
-      psbm.predict(&dip);
-      for(size_t j=0;j<np;j++) tedrawh[i][j] = fp[j];
-   }
+   // Mean and variance trees of each draw
+   if(mpirank==0) cout << "Drawing mean and sd response from posterior predictive" << endl;
+   preddraws(imf,xi,np,p,xp.data(),0,fmean,tc,tedraw,tedrawh);
 
    // For probit models we'll also construct probabilities
    if(modeltype==MODEL_PROBIT || modeltype==MODEL_MODIFIEDPROBIT) {
@@ -480,26 +379,14 @@ if(modeltype!=MODEL_MIXBART){
 #endif
 
 }else if(modeltype == MODEL_MIXBART){
-   //--------------------------------------------------
-   // set up amxbrt object
-   amxbrt axb(m);
-   axb.setxi(&xi); //set the cutpoints for this model object
-   axb.setfi(&fi_test, k); //set the function output for this model object -- main use is to set k 
-   //if(fdiscrepancy) {axb.setfdelta(&fdeltamean, &fdeltasd);}  //set individual function discrepacnies if provided -- main use is to set fdiscrepancy to TRUE
-   
-   //setup psbrt object
-   psbrt psbm(mh);
-   psbm.setxi(&xi); //set the cutpoints for this model object
-   
    //load from file
 #ifndef SILENT
    if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
 #endif
    size_t ind,im,imh;
-   std::ifstream imf(folder + modelname + ".fit");
-   imf >> ind;
-   imf >> im;
-   imf >> imh;
+   fitfile imf;
+   if(!imf.open(folder + modelname + ".fit")) ind=im=imh=0;
+   else { ind=imf.nd(); im=imf.m(); imh=imf.mh(); }
 #ifdef _OPENMPI
    if(nd!=ind) { cout << "Error loading posterior trees"<< "nd = " << nd << " -- ind = " << ind << endl; MPI_Finalize(); return 0; }
    if(m!=im) { cout << "Error loading posterior trees" << "m = " << m << " -- im = " << im<< endl; MPI_Finalize(); return 0; }
@@ -510,151 +397,20 @@ if(modeltype!=MODEL_MIXBART){
    if(mh!=imh) { cout << "Error loading posterior trees"  << endl; return 0; }
 #endif
 
-   size_t temp=0;
-   imf >> temp;
-   std::vector<int> e_ots(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ots.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_ovar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ovar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_otheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_otheta.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sts(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sts.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_svar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_svar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_stheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_stheta.at(i);
-
-   imf.close();
-
    //objects where we'll store the realizations
    std::vector<std::vector<double> > tedraw(nd,std::vector<double>(np));
    std::vector<std::vector<double> > tedrawh(nd,std::vector<double>(np));
    std::vector<std::vector<double> > tedrawp(nd,std::vector<double>(np));
-   double *fp = new double[np];
-   dinfo dip;
-   dip.x = &xp[0]; dip.y=fp; dip.p = p; dip.n=np; dip.tc=1;
-
-   // Temporary vectors used for loading one model realization at a time.
-   std::vector<int> onn(m,1);
-   std::vector<std::vector<int> > oid(m, std::vector<int>(1));
-   std::vector<std::vector<int> > ov(m, std::vector<int>(1));
-   std::vector<std::vector<int> > oc(m, std::vector<int>(1));
-   std::vector<std::vector<double> > otheta(m, std::vector<double>(1));
-   std::vector<int> snn(mh,1);
-   std::vector<std::vector<int> > sid(mh, std::vector<int>(1));
-   std::vector<std::vector<int> > sv(mh, std::vector<int>(1));
-   std::vector<std::vector<int> > sc(mh, std::vector<int>(1));
-   std::vector<std::vector<double> > stheta(mh, std::vector<double>(1));
-
 
    // Draw realizations of the posterior predictive.
-   size_t curdx=0;
-   size_t cumdx=0;
 #ifdef _OPENMPI
    double tstart=0.0,tend=0.0;
    if(mpirank==0) tstart=MPI_Wtime();
 #endif
 
-   // Mean trees first
-   if(mpirank==0) cout << "Drawing mean response from posterior predictive" << endl;
-   for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<m;j++) {
-         onn[j]=e_ots.at(i*m+j);
-         oid[j].resize(onn[j]);
-         ov[j].resize(onn[j]);
-         oc[j].resize(onn[j]);
-         otheta[j].resize(onn[j]*k);
-         for(size_t l=0;l<(size_t)onn[j];l++) {
-            oid[j][l]=e_oid.at(cumdx+curdx+l);
-            ov[j][l]=e_ovar.at(cumdx+curdx+l);
-            oc[j][l]=e_oc.at(cumdx+curdx+l);
-            for(size_t r=0;r<k;r++){
-               otheta[j][l*k+r]=e_otheta.at((cumdx+curdx+l)*k+r);
-               //cout << "Theta_i = " << otheta[j][l*k+r] << endl;;
-            }
-            
-         }
-         curdx+=(size_t)onn[j];
-      }
-      cumdx+=curdx;
-
-      axb.loadtree_vec(0,m,onn,oid,ov,oc,otheta); 
-      // draw realization
-      /*
-      if(fdiscrepancy){
-         axb.predict_mix_fd(&dip, &fi_test, &fdeltamean, &fdeltasd, gen);
-      }else{
-         axb.predict_mix(&dip, &fi_test);
-      }
-      */
-      axb.predict_mix(&dip, &fi_test);
-      for(size_t j=0;j<np;j++) tedraw[i][j] = fp[j] + fmean;
-   }
-
-      // Variance trees second
-   if(mpirank==0) cout << "Drawing sd response from posterior predictive" << endl;
-   cumdx=0;
-   curdx=0;
-   for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<mh;j++) {
-         snn[j]=e_sts.at(i*mh+j);
-         sid[j].resize(snn[j]);
-         sv[j].resize(snn[j]);
-         sc[j].resize(snn[j]);
-         stheta[j].resize(snn[j]);
-         for(size_t k=0;k< (size_t)snn[j];k++) {
-            sid[j][k]=e_sid.at(cumdx+curdx+k);
-            sv[j][k]=e_svar.at(cumdx+curdx+k);
-            sc[j][k]=e_sc.at(cumdx+curdx+k);
-            stheta[j][k]=e_stheta.at(cumdx+curdx+k);
-         }
-         curdx+=(size_t)snn[j];
-      }
-      cumdx+=curdx;
-
-      psbm.loadtree(0,mh,snn,sid,sv,sc,stheta);
-      // draw realization
-      psbm.predict(&dip);
-      for(size_t j=0;j<np;j++) tedrawh[i][j] = fp[j];
-   }
+   // Mean and variance trees of each draw
+   if(mpirank==0) cout << "Drawing mean and sd response from posterior predictive" << endl;
+   preddraws(imf,xi,np,p,xp.data(),&fi_test,fmean,tc,tedraw,tedrawh);
 
    #ifdef _OPENMPI
    if(mpirank==0) {
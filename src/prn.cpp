@@ -0,0 +1,139 @@
+//     prn.cpp: Counter-based random number generator class methods.
+//     Copyright (C) 2012-2019 Matthew T. Pratola
+//
+//     This file is part of OpenBT.
+//
+//     OpenBT is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Affero General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     OpenBT is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public License
+//     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//     Author contact information
+//     Matthew T. Pratola: mpratola@gmail.com
+
+
+#include "prn.h"
+#include <cmath>
+#include <limits>
+
+//--------------------------------------------------
+prn::prn(uint64_t seed):nbuf(4),havez(false),z(0.0),df(1),alpha(0.5),beta(0.5)
+{
+   set_seed(seed);
+}
+//--------------------------------------------------
+void prn::philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+   uint32_t c0=ctr[0],c1=ctr[1],c2=ctr[2],c3=ctr[3],k0=key[0],k1=key[1];
+   for(int r=0;r<10;r++) {
+      uint64_t p0=(uint64_t)0xD2511F53*c0, p1=(uint64_t)0xCD9E8D57*c2;
+      uint32_t hi0=(uint32_t)(p0>>32), lo0=(uint32_t)p0;
+      uint32_t hi1=(uint32_t)(p1>>32), lo1=(uint32_t)p1;
+      c0=hi1^c1^k0; c1=lo1; c2=hi0^c3^k1; c3=lo0;
+      k0+=0x9E3779B9; k1+=0xBB67AE85;
+   }
+   out[0]=c0; out[1]=c1; out[2]=c2; out[3]=c3;
+}
+//--------------------------------------------------
+void prn::set_seed(uint64_t seed)
+{
+   key[0]=(uint32_t)seed; key[1]=(uint32_t)(seed>>32);
+   set_stream(0,0,0);
+}
+void prn::set_stream(uint32_t a, uint32_t b, uint32_t c)
+{
+   ctr[0]=0; ctr[1]=a; ctr[2]=b; ctr[3]=c;
+   buf[0]=buf[1]=buf[2]=buf[3]=0;
+   nbuf=4;
+   havez=false;
+}
+prn prn::stream(uint32_t a, uint32_t b, uint32_t c) const
+{
+   prn g(*this);
+   g.set_stream(a,b,c);
+   return g;
+}
+//--------------------------------------------------
+double prn::uniform()
+{
+   return next53();
+}
+//Marsaglia's polar method, both values are used.  32 bits for each of u and v
+//is plenty here, so a block of 4 words is two tries.
+void prn::normalpair(double& z1, double& z2)
+{
+   double u,v,s;
+   do {
+      u=((double)(int32_t)next()+0.5)*(1.0/2147483648.0);
+      v=((double)(int32_t)next()+0.5)*(1.0/2147483648.0);
+      s=u*u+v*v;
+   } while(s>=1.0);
+   s=std::sqrt(-2.0*std::log(s)/s);
+   z1=u*s; z2=v*s;
+}
+double prn::normal()
+{
+   if(havez) { havez=false; return z; }
+   double z1;
+   normalpair(z1,z);
+   havez=true;
+   return z1;
+}
+void prn::fill_normal(double* zz, size_t n)
+{
+   size_t i=0;
+   if(n && havez) { zz[i++]=z; havez=false; }
+   for(;i+1<n;i+=2) normalpair(zz[i],zz[i+1]);
+   if(i<n) zz[i]=normal();
+}
+void prn::fill_uniform(double* u, size_t n)
+{
+   for(size_t i=0;i<n;i++) u[i]=next53();
+}
+//--------------------------------------------------
+//Marsaglia and Tsang (2000), boosted by u^(1/a) for a<1
+double prn::stdgamma(double a)
+{
+   if(a<1.0) return stdgamma(a+1.0)*std::pow(next53(),1.0/a);
+   double d=a-1.0/3.0, c=1.0/std::sqrt(9.0*d);
+   for(;;) {
+      double x=normal(), v=1.0+c*x;
+      if(v<=0.0) continue;
+      v=v*v*v;
+      double u=next53();
+      if(u<1.0-0.0331*x*x*x*x || std::log(u)<0.5*x*x+d*(1.0-v+std::log(v))) return d*v;
+   }
+}
+double prn::gamma()
+{
+   return stdgamma(alpha)/beta;  //beta is a rate, as in crn
+}
+double prn::chi_square()
+{
+   return 2.0*stdgamma(0.5*df);
+}
+//--------------------------------------------------
+void prn::get_state(std::ostream& os)
+{
+   std::streamsize prec=os.precision(std::numeric_limits<double>::max_digits10);
+   os << key[0] << " " << key[1];
+   for(int i=0;i<4;i++) os << " " << ctr[i];
+   for(int i=0;i<4;i++) os << " " << buf[i];
+   os << " " << nbuf << " " << havez << " " << z << " " << df << " " << alpha << " " << beta;
+   os.precision(prec);
+}
+void prn::set_state(std::istream& is)
+{
+   is >> key[0] >> key[1];
+   for(int i=0;i<4;i++) is >> ctr[i];
+   for(int i=0;i<4;i++) is >> buf[i];
+   is >> nbuf >> havez >> z >> df >> alpha >> beta;
+}
@@ -0,0 +1,85 @@
+//     prn.h: Counter-based random number generator class definition.
+//     Copyright (C) 2012-2019 Matthew T. Pratola
+//
+//     This file is part of OpenBT.
+//
+//     OpenBT is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Affero General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     OpenBT is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public License
+//     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//     Author contact information
+//     Matthew T. Pratola: mpratola@gmail.com
+
+
+#ifndef PRN_H
+#define PRN_H
+
+#include "rn.h"
+#include <cstdint>
+#include <iostream>
+
+//--------------------------------------------------
+//Counter-based generator: block i of stream (a,b,c) under seed s is
+//Philox4x32-10 (Salmon et al. 2011) of the counter (i,a,b,c) with key s.
+//Nothing but the counter has to be stored, so any stream can be started
+//anywhere without drawing up to it.  Give each (iteration,tree,leaf), or
+//each thread, its own stream and the draws do not depend on which thread
+//makes them or in what order; different chains use different seeds.
+//A stream holds 2^32 blocks of 4 words, a uniform uses 2 words.
+//--------------------------------------------------
+class prn: public rn
+{
+public:
+//constructor
+   prn(uint64_t seed=99);
+//virtual
+   virtual ~prn() {}
+   virtual double normal();
+   virtual double uniform();
+   virtual double chi_square();
+   virtual double gamma();
+   virtual void set_df(int df) { if(df>0) this->df=df; }
+   virtual void set_gam(double alpha,double beta) { this->alpha=alpha; this->beta=beta; }
+   virtual void fill_normal(double* z, size_t n);
+   virtual void fill_uniform(double* u, size_t n);
+//get,set
+   int get_df()  {return df;}
+   void set_seed(uint64_t seed);  //also goes back to the start of stream (0,0,0)
+   void set_stream(uint32_t a, uint32_t b=0, uint32_t c=0);  //go to the start of stream (a,b,c)
+   prn stream(uint32_t a, uint32_t b=0, uint32_t c=0) const;  //a copy at the start of stream (a,b,c)
+   //key, counter and unused words (text), so a checkpointed run can continue exactly
+   void get_state(std::ostream& os);
+   void set_state(std::istream& is);
+   //one Philox4x32-10 block
+   static void philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+private:
+   uint32_t key[2];  //the seed
+   uint32_t ctr[4];  //ctr[0] is the next block of the stream (ctr[1],ctr[2],ctr[3])
+   uint32_t buf[4];  //the current block, buf[nbuf..3] not used yet
+   int nbuf;
+   bool havez;  //normal() makes a pair, the second one is kept in z
+   double z;
+   int df;
+   double alpha,beta;
+   uint32_t next() {
+      if(nbuf==4) { philox(ctr,key,buf); ctr[0]++; nbuf=0; }
+      return buf[nbuf++];
+   }
+   double next53() {  //uniform on (0,1) from 53 random bits
+      uint64_t a=next(), b=next();
+      return ((double)((a<<21)|(b>>11))+0.5)*(1.0/9007199254740992.0);
+   }
+   void normalpair(double& z1, double& z2);
+   double stdgamma(double a);  //gamma(a,1)
+};
+
+#endif //PRN_H
@@ -23,7 +23,8 @@
 
 
 #include "psbrt.h"
-//#include "brtfuns.h"
+#include "brtfuns.h"
+#include "flatforest.h"
 #include <iostream>
 #include <map>
 #include <vector>
@@ -35,25 +36,25 @@ using std::endl;
 
 //--------------------------------------------------
 //a single iteration of the MCMC for brt model
+//yhat is kept as a running product: tree j is divided out before its draw and
+//its new fit multiplied back in after, so a sweep is O(n*m) rather than O(n*m^2).
 void psbrt::draw(rn& gen)
 {
   for(size_t j=0;j<m;j++) {
-    //update this row of notjsigmavs
-//    for(size_t i=0;i<di->n;i++) {
-//      notjsigmavs[j][i]=r(i)*sb[j].f(i);
-//    }
-    *divec[j]= *getr();
-    *divec[j]*= *sb[j].getf();
+    //set notjsigmav to the jth residual y/prod_{k!=j}tree_k
+    dropfit(j);
 
     // do the draw for jth component
     sb[j].draw(gen);
 
     // Update the in-sample predicted vector
-    setf();
-
-    // Update the in-sample residual vector
-    setr();
+    addfit(j);
   }
+  // Recompute the fit from all m trees so rounding in the running product
+  // does not build up, then the in-sample residual vector
+  setf();
+  setr();
+
   // overall statistics from the subtrees.  Need to divide by m*N to get
   // useful numbers after the MCMC is done.
   if(mi.dostats) {
@@ -67,20 +68,40 @@ void psbrt::draw(rn& gen)
 void psbrt::draw_mpislave(rn& gen)
 {
   for(size_t j=0;j<m;j++) {
-    //update this row of notjsigmavs
-    *divec[j]= *getr();
-    *divec[j]*= *sb[j].getf();
+    dropfit(j);
 
     // do the draw for jth component
     sb[j].draw_mpislave(gen);
-    // Update the in-sample predicted vector
-    setf();
 
-    // Update the in-sample residual vector
-    setr();
+    // Update the in-sample predicted vector
+    addfit(j);
+  }
+  setf();
+  setr();
+}
+//--------------------------------------------------
+//divide tree j out of the running product, y over what is left is the jth
+//residual.  The sigma trees are positive, so the division is safe.
+void psbrt::dropfit(size_t j)
+{
+  double* yh=yhat.data();
+  double* r=notjsigmav.data();
+  const double* fj=sb[j].getf()->data();
+  for(size_t i=0;i<di->n;i++) {
+    yh[i]/=fj[i];
+    r[i]=di->y[i]/yh[i];
   }
 }
 //--------------------------------------------------
+//multiply tree j's fit back into the running product after its draw
+void psbrt::addfit(size_t j)
+{
+  double* yh=yhat.data();
+  const double* fj=sb[j].getf()->data();
+  for(size_t i=0;i<di->n;i++)
+    yh[i]*=fj[i];
+}
+//--------------------------------------------------
 //adapt the proposal widths for perturb proposals,
 //bd or rot proposals and b or d proposals.
 void psbrt::adapt()
@@ -93,23 +114,35 @@ void psbrt::adapt()
   }
 }
 //--------------------------------------------------
+//save/load the state of the chain for checkpoints
+void psbrt::savestate(std::ostream& os)
+{
+  brt::savestate(os);
+  for(size_t j=0;j<m;j++)
+    sb[j].savestate(os);
+}
+void psbrt::loadstate(std::istream& is)
+{
+  brt::loadstate(is);
+  for(size_t j=0;j<m;j++)
+    sb[j].loadstate(is);
+}
+//--------------------------------------------------
 //setdata for psbrt
 void psbrt::setdata(dinfo *di) {
   this->di=di;
 
-  // initialize notjsigmavs.
-  for(size_t j=0;j<m;j++)
-      notjsigmavs[j].resize(this->di->n,1.0);
-  for(size_t j=0;j<m;j++)
-    for(size_t i=0;i<di->n;i++)
-      notjsigmavs[j][i]=pow(std::abs(this->di->y[i]/.8),1.0/m);  //E(|Y|) = .8sigma for normal
+  // initialize notjsigmav.  Only one tree is drawn at a time, so one residual
+  // buffer serves all m trees; draw refills it before each tree.
+  notjsigmav.resize(this->di->n);
+  dinotj.y=notjsigmav.data(); dinotj.tc=this->di->tc;
+  dinotj=*di;  //copies x (and the binned x, if any) and y into notjsigmav
+  for(size_t i=0;i<di->n;i++)
+    notjsigmav[i]=pow(std::abs(this->di->y[i]/.8),1.0/m);  //E(|Y|) = .8sigma for normal
 
+  // each sb[j]'s data is the residual in notjsigmav
   for(size_t j=0;j<m;j++)
-    divec[j]=new dinfo(this->di->p,this->di->n,this->di->x,&notjsigmavs[j][0],this->di->tc);
-
-  // each sb[j]'s data is the appropriate row in notjsigmavs
-  for(size_t j=0;j<m;j++)
-    sb[j].setdata(divec[j]);
+    sb[j].setdata(&dinotj);
 
   resid.resize(di->n);
   yhat.resize(di->n);
@@ -139,17 +172,12 @@ void psbrt::local_setr(diterator& diter)
 //Note: the result appears in *dipred.y.
 void psbrt::local_predict(diterator& diter)
 {
-  tree::tree_p bn;
-  double temp;
-
-  for(;diter<diter.until();diter++) {
-    temp=1.0;
-    for(size_t j=0;j<m;j++) {
-      bn = sb[j].t.bn(diter.getxp(),*xi);
-      temp*=bn->gettheta();
-    }
-    diter.sety(temp);
-  }
+  tree::cnpv tv(m);
+  for(size_t j=0;j<m;j++) tv[j]=&sb[j].t;
+  flatforest ff;
+  ff.set(tv,*xi);
+  dinfo& d=diter.getdi();
+  ff.predictprod(diter.getpos(),diter.until(),d.p,d.x,d.y);
 }
 void psbrt::local_savetree(size_t iter, int beg, int end, std::vector<int>& nn, std::vector<std::vector<int> >& id, 
      std::vector<std::vector<int> >& v, std::vector<std::vector<int> >& c, std::vector<std::vector<double> >& theta)
@@ -40,16 +40,10 @@ public:
 
    //--------------------
    //constructors/destructors
-   psbrt(): sbrt(),m(10),sb(m),notjsigmavs(m),divec(m) {}
-   psbrt(size_t im): sbrt(),m(im),sb(m),notjsigmavs(m),divec(m) {}
-   psbrt(size_t im, double itheta): sbrt(pow(itheta,1/im)),m(im),sb(m),notjsigmavs(m),divec(m) {}
-   virtual ~psbrt() {
-      if(!notjsigmavs.empty()) {
-         for(size_t j=0;j<m;j++) notjsigmavs[j].clear();
-         notjsigmavs.clear();
-         for(size_t j=0;j<m;j++) delete divec[j];
-      }
-   }
+   psbrt(): sbrt(),m(10),sb(m) {}
+   psbrt(size_t im): sbrt(),m(im),sb(m) {}
+   psbrt(size_t im, double itheta): sbrt(pow(itheta,1/im)),m(im),sb(m) {}
+   virtual ~psbrt() {}
 
    //--------------------
    //methods
@@ -57,6 +51,8 @@ public:
    void draw_mpislave(rn& gen);
    void adapt();
    void setmpirank(int rank) { this->rank = rank; for(size_t j=0;j<m;j++) sb[j].setmpirank(rank); }  //only needed for MPI
+   void setmpislaves(int nslaves) { this->nslaves = nslaves; for(size_t j=0;j<m;j++) sb[j].setmpislaves(nslaves); }  //only needed for MPI
+   void setmpirep(bool rep) { this->mpirep = rep; for(size_t j=0;j<m;j++) sb[j].setmpirep(rep); }  //only needed for MPI
    void setmpicvrange(int* lwr, int* upr) { this->chv_lwr=lwr; this->chv_upr=upr; for(size_t j=0;j<m;j++) sb[j].setmpicvrange(lwr,upr); } //only needed for MPI
    void setci(double nu, double lambda) { ci.nu=nu; ci.lambda=lambda; for(size_t j=0;j<m;j++) sb[j].setci(nu,lambda); }
    void settc(int tc) { this->tc = tc; for(size_t j=0;j<m;j++) sb[j].settc(tc); }
@@ -70,6 +66,8 @@ public:
                for(size_t j=0;j<m;j++) sb[j].setmi(pbd,pb,minperbot,dopert,pertalpha,pchgv,chgv); }
    void setstats(bool dostats) { mi.dostats=dostats; for(size_t j=0;j<m;j++) sb[j].setstats(dostats); if(dostats) mi.varcount=new unsigned int[xi->size()]; }
    void pr();
+   void savestate(std::ostream& os);  //checkpoints: all m trees
+   void loadstate(std::istream& is);
    // drawnodetheta, lm, add_observation_to_suff and newsinfo/newsinfovec unused here.
 
    //--------------------
@@ -83,12 +81,14 @@ protected:
    std::vector<sbrt> sb;  // the vector of individual sigma trees for product representation
    //--------------------
    //data
-   std::vector<std::vector<double> > notjsigmavs;
-   std::vector<dinfo*> divec;
+   std::vector<double> notjsigmav;  //residual of the tree being drawn, one buffer for all m trees
+   dinfo dinotj;  //data of every sb[j]: di with y pointing at notjsigmav
    //--------------------
    //mcmc info
    //--------------------
    //methods
+   void dropfit(size_t j);  //divide tree j out of yhat and set its residual in notjsigmav
+   void addfit(size_t j);  //multiply tree j's new fit back into yhat
    virtual void local_setf(diterator& diter);  //set the vector of predicted values
    virtual void local_setr(diterator& diter);  //set the vector of residuals
    virtual void local_predict(diterator& diter); // predict y at the (npred x p) settings *di.x
@@ -25,6 +25,8 @@
 #ifndef GUARD_rn
 #define GUARD_rn
 
+#include <cstddef>
+
 //pure virtual base class for random numbers
 class rn
 {
@@ -35,6 +37,9 @@ public:
    virtual double gamma() = 0; //gamma(a,b)
    virtual void set_df(int df) = 0; //set df for chi-square
    virtual void set_gam(double alpha,double beta)=0;
+   //n draws at once, the same numbers as n calls to normal() or uniform()
+   virtual void fill_normal(double* z, size_t n) { for(size_t i=0;i<n;i++) z[i]=normal(); }
+   virtual void fill_uniform(double* u, size_t n) { for(size_t i=0;i<n;i++) u[i]=uniform(); }
    virtual ~rn() {}
 };
 
@@ -115,7 +115,7 @@ void sbrt::local_mpi_sr_suffs(sinfo& sil, sinfo& sir)
       char buffer[SIZE_UINT4];
       int position=0;
       unsigned int ln,rn;
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          position=0;
          MPI_Recv(buffer,SIZE_UINT4,MPI_PACKED,MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&status);
          MPI_Unpack(buffer,SIZE_UINT4,&position,&ln,1,MPI_UNSIGNED,MPI_COMM_WORLD);
@@ -156,7 +156,7 @@ void sbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
    unsigned int nvec[siv.size()];
    double sumy2vec[siv.size()];
 
-   for(size_t i=0;i<siv.size();i++) { // on root node, these should be 0 because of newsinfo().
+   for(size_t i=0;i<siv.size();i++) { // on root node, the suff stats of its own rows (0 if it holds none).
       ssinfo* ssi=static_cast<ssinfo*>(siv[i]);
       nvec[i]=(unsigned int)ssi->n;    // cast to int
       sumy2vec[i]=ssi->sumy2;
@@ -173,13 +173,13 @@ void sbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
       double tempsumy2vec[siv.size()];
 
       // receive nvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempnvec,siv.size(),MPI_UNSIGNED,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             nvec[j]+=tempnvec[j];
       }
-      MPI_Request *request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&nvec,siv.size(),MPI_UNSIGNED,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to ssi
@@ -187,17 +187,17 @@ void sbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          ssinfo* ssi=static_cast<ssinfo*>(siv[i]);
          ssi->n=(size_t)nvec[i];    // cast back to size_t
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 
       // receive sumwy2vec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempsumy2vec,siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             sumy2vec[j]+=tempsumy2vec[j];
       }
-      request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&sumy2vec,siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to ssi
@@ -205,7 +205,7 @@ void sbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          ssinfo* ssi=static_cast<ssinfo*>(siv[i]);
          ssi->sumy2=sumy2vec[i];
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
    }
    else {
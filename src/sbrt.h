@@ -91,6 +91,9 @@ public:
    virtual std::vector<sinfo*>& newsinfovec(size_t dim) { std::vector<sinfo*>* si = new std::vector<sinfo*>; si->resize(dim); for(size_t i=0;i<dim;i++) si->push_back(new ssinfo); return *si; }
    virtual void local_mpi_reduce_allsuff(std::vector<sinfo*>& siv);
    virtual void local_mpi_sr_suffs(sinfo& sil, sinfo& sir);
+   virtual size_t mpi_suffsize() { return 2; }
+   virtual void local_mpi_packsuff(sinfo& si, double* buf) { ssinfo& ssi=static_cast<ssinfo&>(si); buf[0]=(double)ssi.n; buf[1]=ssi.sumy2; }
+   virtual void local_mpi_unpacksuff(double* buf, sinfo& si) { ssinfo& ssi=static_cast<ssinfo&>(si); ssi.n=(size_t)buf[0]; ssi.sumy2=buf[1]; }
    void pr();
 
    //--------------------
@@ -118,7 +118,7 @@ void singlebinomialbrt::local_mpi_sr_suffs(sinfo& sil, sinfo& sir)
       char buffer[SIZE_UINT4];
       int position=0;
       unsigned int ln,rn;
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          position=0;
          MPI_Recv(buffer,SIZE_UINT4,MPI_PACKED,MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&status);
          MPI_Unpack(buffer,SIZE_UINT4,&position,&ln,1,MPI_UNSIGNED,MPI_COMM_WORLD);
@@ -158,7 +158,7 @@ void singlebinomialbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
    unsigned int nvec[siv.size()];
    double sumyvec[siv.size()];
 
-   for(size_t i=0;i<siv.size();i++) { // on root node, these should be 0 because of newsinfo().
+   for(size_t i=0;i<siv.size();i++) { // on root node, the suff stats of its own rows (0 if it holds none).
       singlebinomialsinfo* msi=static_cast<singlebinomialsinfo*>(siv[i]);
       nvec[i]=(unsigned int)msi->n;    // cast to int
       sumyvec[i]=msi->sumy;
@@ -176,13 +176,13 @@ void singlebinomialbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
       double tempsumyvec[siv.size()];
 
       // receive nvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempnvec,siv.size(),MPI_UNSIGNED,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             nvec[j]+=tempnvec[j];
       }
-      MPI_Request *request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      MPI_Request *request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&nvec,siv.size(),MPI_UNSIGNED,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to msi
@@ -190,17 +190,17 @@ void singlebinomialbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          singlebinomialsinfo* msi=static_cast<singlebinomialsinfo*>(siv[i]);
          msi->n=(size_t)nvec[i];    // cast back to size_t
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 
       // receive sumwvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempsumyvec,siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             sumyvec[j]+=tempsumyvec[j];
       }
-      request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&sumyvec,siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to msi
@@ -208,17 +208,17 @@ void singlebinomialbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          singlebinomialsinfo* msi=static_cast<singlebinomialsinfo*>(siv[i]);
          msi->sumy=sumyvec[i];
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
 
       // receive sumyvec, update and send back.
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Recv(&tempsumyvec,siv.size(),MPI_DOUBLE,MPI_ANY_SOURCE,MPI_ANY_TAG,MPI_COMM_WORLD,&status);
          for(size_t j=0;j<siv.size();j++)
             sumyvec[j]+=tempsumyvec[j];
       }
-      request=new MPI_Request[tc];
-      for(size_t i=1; i<=(size_t)tc; i++) {
+      request=new MPI_Request[nslaves];
+      for(size_t i=1; i<=(size_t)nslaves; i++) {
          MPI_Isend(&sumyvec,siv.size(),MPI_DOUBLE,i,0,MPI_COMM_WORLD,&request[i-1]);
       }
       // cast back to msi
@@ -226,7 +226,7 @@ void singlebinomialbrt::local_mpi_reduce_allsuff(std::vector<sinfo*>& siv)
          singlebinomialsinfo* msi=static_cast<singlebinomialsinfo*>(siv[i]);
          msi->sumy=sumyvec[i];
       }
-      MPI_Waitall(tc,request,MPI_STATUSES_IGNORE);
+      MPI_Waitall(nslaves,request,MPI_STATUSES_IGNORE);
       delete[] request;
    }
    else {
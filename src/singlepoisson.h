@@ -88,6 +88,9 @@ public:
    virtual std::vector<sinfo*>& newsinfovec(size_t dim) { std::vector<sinfo*>* si = new std::vector<sinfo*>; si->resize(dim); for(size_t i=0;i<dim;i++) si->push_back(new singlepoissonsinfo); return *si; }
    virtual void local_mpi_reduce_allsuff(std::vector<sinfo*>& siv);
    virtual void local_mpi_sr_suffs(sinfo& sil, sinfo& sir);
+   virtual size_t mpi_suffsize() { return 2; }
+   virtual void local_mpi_packsuff(sinfo& si, double* buf) { singlepoissonsinfo& msi=static_cast<singlepoissonsinfo&>(si); buf[0]=(double)msi.n; buf[1]=msi.sumy; }
+   virtual void local_mpi_unpacksuff(double* buf, sinfo& si) { singlepoissonsinfo& msi=static_cast<singlepoissonsinfo&>(si); msi.n=(size_t)buf[0]; msi.sumy=buf[1]; }
    void pr();
 
    //--------------------
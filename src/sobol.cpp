@@ -38,6 +38,7 @@
 #include "mbrt.h"
 #include "ambrt.h"
 #include "psbrt.h"
+#include "fitio.h"
 
 using std::cout;
 using std::endl;
@@ -180,10 +181,9 @@ int main(int argc, char* argv[])
    if(mpirank==0) cout << "Loading saved posterior tree draws" << endl;
 #endif
    size_t ind,im,imh;
-   std::ifstream imf(folder + modelname + ".fit");
-   imf >> ind;
-   imf >> im;
-   imf >> imh;
+   fitfile imf;
+   if(!imf.open(folder + modelname + ".fit")) ind=im=imh=0;
+   else { ind=imf.nd(); im=imf.m(); imh=imf.mh(); }
 #ifdef _OPENMPI
    if(nd!=ind) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
    if(m!=im) { cout << "Error loading posterior trees" << endl; MPI_Finalize(); return 0; }
@@ -194,62 +194,10 @@ int main(int argc, char* argv[])
    if(mh!=imh) { cout << "Error loading posterior trees" << endl; return 0; }
 #endif
 
-   size_t temp=0;
-   imf >> temp;
-   std::vector<int> e_ots(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ots.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_ovar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ovar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_otheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_otheta.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sts(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sts.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_svar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_svar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_stheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_stheta.at(i);
-
-   imf.close();
-
 
    // Calculate range of posterior samples to do Sobol on for MPI.
-   int startnd=0,endnd=nd-1;
-   size_t snd,end,rnd=nd;
+   int startnd=0,endnd=nd;
+   size_t snd=0,end=nd,rnd=nd;
 #ifdef _OPENMPI
    calcbegend(nd,mpirank,tc,&startnd,&endnd);
    snd=(size_t)startnd;
@@ -279,8 +227,6 @@ int main(int argc, char* argv[])
    std::vector<std::vector<double> > stheta(mh, std::vector<double>(1));
 
    // Draw realizations of the posterior predictive.
-   size_t curdx=0;
-   size_t cumdx=0;
 #ifdef _OPENMPI
    double tstart=0.0,tend=0.0;
    if(mpirank==0) tstart=MPI_Wtime();
@@ -290,31 +236,15 @@ int main(int argc, char* argv[])
    // Mean trees first
    if(mpirank==0) cout << "Calculating Sobol Indices for mean trees" << endl;
 
+   // Only the draws in this node's range are loaded
    size_t ii=0;
-   for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<m;j++) {
-         onn[j]=e_ots.at(i*m+j);
-         oid[j].resize(onn[j]);
-         ov[j].resize(onn[j]);
-         oc[j].resize(onn[j]);
-         otheta[j].resize(onn[j]);
-         for(size_t k=0;k< (size_t)onn[j];k++) {
-            oid[j][k]=e_oid.at(cumdx+curdx+k);
-            ov[j][k]=e_ovar.at(cumdx+curdx+k);
-            oc[j][k]=e_oc.at(cumdx+curdx+k);
-            otheta[j][k]=e_otheta.at(cumdx+curdx+k);
-         }
-         curdx+=(size_t)onn[j];
-      }
-      cumdx+=curdx;
+   for(size_t i=snd;i<end;i++) {
+      imf.getdraw(i,onn,oid,ov,oc,otheta);
       ambm.loadtree(0,m,onn,oid,ov,oc,otheta);
 
       // Calculate Sobol Indices
-      if(i>=snd && i<end) {
-         ambm.sobol(Sidraws[ii], Sijdraws[ii], TSidraws[ii], V[ii], minx, maxx, p);  //calculate Sobol indices (unnormalized)
-         ii++;
-      }
+      ambm.sobol(Sidraws[ii], Sijdraws[ii], TSidraws[ii], V[ii], minx, maxx, p);  //calculate Sobol indices (unnormalized)
+      ii++;
    }
 
 /* Variances trees Sobol indices currently not implemented.
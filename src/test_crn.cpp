@@ -29,6 +29,8 @@ using std::cout;
 using std::endl;
 
 #include "crn.h"
+#include "prn.h"
+#include <vector>
 
 #ifdef _OPENMPI
 #   include <mpi.h>
@@ -58,6 +60,35 @@ int main()
    std::ofstream df2("dgam.txt");
    for(int i=0;i<nd;i++) df2 << gen1.gamma() << endl;
 
+   //counter-based generator
+   uint32_t ctr[4]={0,0,0,0}, key[2]={0,0}, out[4];
+   prn::philox(ctr,key,out);
+   cout << "philox4x32-10 known answer: " << ((out[0]==0x6627e8d5 && out[1]==0xe169c58d &&
+        out[2]==0xbc57ac4c && out[3]==0x9b00dbd8) ? "ok" : "WRONG") << endl;
+
+   prn pgen(14);
+   cout << "a normal from pgen: " << pgen.normal() << endl;
+   pgen.set_gam(5,100);
+   cout << "a gamma from pgen: " << pgen.gamma() << endl;
+
+   //a stream gives the same draws whenever it is started, and fill_normal
+   //gives the same draws as calls to normal()
+   std::vector<double> z(nd);
+   prn s1=pgen.stream(7,3);
+   s1.fill_normal(&z[0],nd);
+   prn s2=pgen.stream(7,3);
+   bool same=true;
+   for(int i=0;i<nd;i++) same = same && (z[i]==s2.normal());
+   cout << "stream (7,3) repeats: " << (same ? "yes" : "no") << endl;
+
+   double m=0.0,v=0.0;
+   for(int i=0;i<nd;i++) { m+=z[i]; v+=z[i]*z[i]; }
+   m/=nd; v=v/nd-m*m;
+   cout << "mean, var of " << nd << " normals from stream (7,3): " << m << " " << v << endl;
+
+   std::ofstream df3("dpgam.txt");
+   for(int i=0;i<nd;i++) df3 << pgen.gamma() << endl;
+
 
    return 0;
    
@@ -119,6 +119,8 @@ public:
    bool xonpath(npv& path, size_t nodedx, double *x, xinfo& xi);  //true if x follows path down tree, false otherwise
    void swaplr();                  //swap the left and right branches of this node in a tree
    tree_p bn(double *x,xinfo& xi); //find Bottom Node
+   template<class T> tree_p bn(const T* xb) //find Bottom Node from binned x (see dinfo::xb8)
+      { tree_p n=this; while(n->l) n = ((size_t)xb[n->v] <= n->c) ? n->l : n->r; return n; }
    size_t nuse(size_t v);          // Number of nodes splitting on var v
    void rl(size_t v, int *L);      // find lower region
    void ru(size_t v, int *U);      // find upper region
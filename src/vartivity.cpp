@@ -37,6 +37,7 @@
 #include "mbrt.h"
 #include "ambrt.h"
 #include "psbrt.h"
+#include "fitio.h"
 
 using std::cout;
 using std::endl;
@@ -89,66 +90,13 @@ int main(int argc, char* argv[])
    cout << "Loading saved posterior tree draws" << endl;
 #endif
    size_t ind,im,imh;
-   std::ifstream imf(folder + modelname + ".fit");
-   imf >> ind;
-   imf >> im;
-   imf >> imh;
+   fitfile imf;
+   if(!imf.open(folder + modelname + ".fit")) ind=im=imh=0;
+   else { ind=imf.nd(); im=imf.m(); imh=imf.mh(); }
    if(nd!=ind) { cout << "Error loading posterior trees" << endl; return 0; }
    if(m!=im) { cout << "Error loading posterior trees" << endl; return 0; }
    if(mh!=imh) { cout << "Error loading posterior trees" << endl; return 0; }
 
-   size_t temp=0;
-   imf >> temp;
-   std::vector<int> e_ots(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ots.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_ovar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_ovar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_oc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_oc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_otheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_otheta.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sts(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sts.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sid(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sid.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_svar(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_svar.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<int> e_sc(temp);
-   for(size_t i=0;i<temp;i++) imf >> e_sc.at(i);
-
-   temp=0;
-   imf >> temp;
-   std::vector<double> e_stheta(temp);
-   for(size_t i=0;i<temp;i++) imf >> std::scientific >> e_stheta.at(i);
-
-   imf.close();
-
 
 
    //objects where we'll store the realizations
@@ -168,8 +116,6 @@ int main(int argc, char* argv[])
    std::vector<std::vector<double> > stheta(mh, std::vector<double>(1));
 
    // Draw realizations of the posterior predictive.
-   size_t curdx=0;
-   size_t cumdx=0;
    size_t cid=0;
    bool haschild=false;
 
@@ -177,22 +123,7 @@ int main(int argc, char* argv[])
    // Mean trees first
    cout << "Drawing variable activity for mean posterior predictive" << endl;
    for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<m;j++) {
-         onn[j]=e_ots.at(i*m+j);
-         oid[j].resize(onn[j]);
-         ov[j].resize(onn[j]);
-         oc[j].resize(onn[j]);
-         otheta[j].resize(onn[j]);
-         for(size_t k=0;k< (size_t)onn[j];k++) {
-            oid[j][k]=e_oid.at(cumdx+curdx+k);
-            ov[j][k]=e_ovar.at(cumdx+curdx+k);
-            oc[j][k]=e_oc.at(cumdx+curdx+k);
-            otheta[j][k]=e_otheta.at(cumdx+curdx+k);
-         }
-         curdx+=(size_t)onn[j];
-      }
-      cumdx+=curdx;
+      imf.getdraw(i,onn,oid,ov,oc,otheta);
 
       for(size_t j=0;j<m;j++)
          for(size_t k=0;k< (size_t)onn[j];k++) {
@@ -209,27 +140,10 @@ int main(int argc, char* argv[])
 
    // Variance trees second
    cout << "Drawing variable activity for sd posterior predictive" << endl;
-   cumdx=0;
-   curdx=0;
    cid=0;
    haschild=false;
    for(size_t i=0;i<nd;i++) {
-      curdx=0;
-      for(size_t j=0;j<mh;j++) {
-         snn[j]=e_sts.at(i*mh+j);
-         sid[j].resize(snn[j]);
-         sv[j].resize(snn[j]);
-         sc[j].resize(snn[j]);
-         stheta[j].resize(snn[j]);
-         for(size_t k=0;k< (size_t)snn[j];k++) {
-            sid[j][k]=e_sid.at(cumdx+curdx+k);
-            sv[j][k]=e_svar.at(cumdx+curdx+k);
-            sc[j][k]=e_sc.at(cumdx+curdx+k);
-            stheta[j][k]=e_stheta.at(cumdx+curdx+k);
-         }
-         curdx+=(size_t)snn[j];
-      }
-      cumdx+=curdx;
+      imf.getsdraw(i,snn,sid,sv,sc,stheta);
 
       for(size_t j=0;j<mh;j++)
          for(size_t k=0;k< (size_t)snn[j];k++) {